@@ -0,0 +1,116 @@
+#include "brush-tip.h"
+#include "draw-source.h"
+#include <math.h>
+
+/* hardness is rounded to steps of 10 percent so dragging the slider does not fill the cache */
+#define BRUSH_TIP_HARDNESS_STEPS 10
+
+struct brush_tip {
+	uint32_t style;
+	uint32_t hardness;
+	uint32_t size;
+	uint64_t used;
+	gs_texture_t *texture;
+};
+
+static struct brush_tip brush_tips[BRUSH_TIP_CACHE_MAX];
+static uint64_t brush_tip_clock;
+static long brush_tip_refs;
+
+static uint8_t brush_tip_grain(uint32_t x, uint32_t y)
+{
+	uint32_t h = x * 73856093u ^ y * 19349663u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	return (uint8_t)((h ^ (h >> 15)) & 0xFF);
+}
+
+/* alpha of the tip at distance r from the center in tip radii, soft tips are linear past the hard core like the old brush */
+static float brush_tip_alpha(uint32_t style, float hardness, float r, float radius)
+{
+	if (style == BRUSH_TIP_HARD) {
+		float a = (1.0f - r) * radius;
+		return a < 0.0f ? 0.0f : a > 1.0f ? 1.0f : a;
+	}
+	if (r >= 1.0f)
+		return 0.0f;
+	if (r <= hardness)
+		return 1.0f;
+	return (1.0f - r) / (1.0f - hardness);
+}
+
+static gs_texture_t *brush_tip_render(uint32_t style, uint32_t hardness, uint32_t size)
+{
+	uint8_t *data = bmalloc((size_t)size * size * 4);
+	float radius = (float)size / 2.0f;
+	float h = (float)hardness / (float)BRUSH_TIP_HARDNESS_STEPS;
+	uint8_t *p = data;
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++, p += 4) {
+			float dx = ((float)x + 0.5f - radius) / radius;
+			float dy = ((float)y + 0.5f - radius) / radius;
+			float a = brush_tip_alpha(style, h, sqrtf(dx * dx + dy * dy), radius);
+			if (style == BRUSH_TIP_TEXTURED)
+				a *= 0.55f + 0.45f * (float)brush_tip_grain(x, y) / 255.0f;
+			p[0] = 255;
+			p[1] = 255;
+			p[2] = 255;
+			p[3] = (uint8_t)(a * 255.0f + 0.5f);
+		}
+	}
+	const uint8_t *levels[1] = {data};
+	gs_texture_t *texture = gs_texture_create(size, size, GS_RGBA, 1, levels, 0);
+	bfree(data);
+	return texture;
+}
+
+gs_texture_t *brush_tip_texture(uint32_t style, float hardness, float tool_size)
+{
+	if (style == BRUSH_TIP_IMAGE)
+		return NULL;
+
+	/* size class, the smallest power of two covering the tip diameter so a tip texel maps to about one canvas pixel */
+	uint32_t size = BRUSH_TIP_SIZE_MIN;
+	while (size < BRUSH_TIP_SIZE_MAX && (float)size < tool_size * 2.0f)
+		size *= 2;
+	uint32_t step = 0;
+	if (style != BRUSH_TIP_HARD) {
+		float s = roundf(hardness * (float)BRUSH_TIP_HARDNESS_STEPS / 100.0f);
+		step = s <= 0.0f ? 0 : s >= (float)BRUSH_TIP_HARDNESS_STEPS ? BRUSH_TIP_HARDNESS_STEPS : (uint32_t)s;
+	}
+
+	struct brush_tip *oldest = &brush_tips[0];
+	for (size_t i = 0; i < BRUSH_TIP_CACHE_MAX; i++) {
+		struct brush_tip *tip = &brush_tips[i];
+		if (tip->texture && tip->style == style && tip->hardness == step && tip->size == size) {
+			tip->used = ++brush_tip_clock;
+			return tip->texture;
+		}
+		if (tip->used < oldest->used)
+			oldest = tip;
+	}
+
+	gs_texture_destroy(oldest->texture);
+	oldest->style = style;
+	oldest->hardness = step;
+	oldest->size = size;
+	oldest->used = ++brush_tip_clock;
+	oldest->texture = brush_tip_render(style, step, size);
+	return oldest->texture;
+}
+
+void brush_tip_addref(void)
+{
+	brush_tip_refs++;
+}
+
+void brush_tip_release(void)
+{
+	if (--brush_tip_refs > 0)
+		return;
+	for (size_t i = 0; i < BRUSH_TIP_CACHE_MAX; i++) {
+		gs_texture_destroy(brush_tips[i].texture);
+		brush_tips[i].texture = NULL;
+		brush_tips[i].used = 0;
+	}
+}
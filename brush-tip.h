@@ -0,0 +1,28 @@
+#pragma once
+
+#include <obs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Module wide cache of brush tip textures, small white RGBA textures with the tip falloff in alpha,
+ * rendered once per style, hardness step and size class and shared by all draw sources.
+ * Everything here runs with the graphics lock held.
+ */
+
+#define BRUSH_TIP_SIZE_MIN 16
+#define BRUSH_TIP_SIZE_MAX 256
+#define BRUSH_TIP_CACHE_MAX 16
+
+/* returns the tip texture for a brush of radius tool_size, hardness 0-100, NULL for image tips or when the upload failed */
+gs_texture_t *brush_tip_texture(uint32_t style, float hardness, float tool_size);
+
+/* counts draw sources using tips, the last release frees every cached tip */
+void brush_tip_addref(void);
+void brush_tip_release(void);
+
+#ifdef __cplusplus
+}
+#endif
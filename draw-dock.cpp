@@ -1,14 +1,17 @@
 #include "draw-dock.hpp"
 #include "draw-source.h"
+#include "image-cache.h"
 #include "name-dialog.hpp"
 #include "obs-websocket-api.h"
 #include "version.h"
 #include <graphics/matrix4.h>
 #include <obs-module.h>
+#include <QBuffer>
 #include <QColorDialog>
 #include <QDesktopServices>
 #include <QFileDialog>
 #include <QGuiApplication>
+#include <QImage>
 #include <QMainWindow>
 #include <QMenu>
 #include <QPainter>
@@ -16,6 +19,7 @@
 #include <QPushButton>
 #include <QVBoxLayout>
 #include <QWidgetAction>
+#include <set>
 #include <util/platform.h>
 #ifdef _WIN32
 #include <windows.h>
@@ -33,6 +37,7 @@ bool obs_module_load()
 {
 	blog(LOG_INFO, "[Draw Dock] loaded version %s", PROJECT_VERSION);
 	obs_register_source(&draw_source_info);
+	draw_shader_warm_up();
 	const auto main_window = static_cast<QMainWindow *>(obs_frontend_get_main_window());
 	obs_frontend_push_ui_translation(obs_module_get_string);
 	draw_dock = new DrawDock(main_window);
@@ -48,7 +53,34 @@ void obs_module_post_load(void)
 		draw_dock->PostLoad();
 }
 
-void obs_module_unload() {}
+void obs_module_unload()
+{
+	image_cache_shutdown();
+}
+
+bool draw_vendor_available(void)
+{
+	return draw_dock && draw_dock->GetVendor();
+}
+
+void draw_vendor_emit_event(const char *event_name, obs_data_t *event_data)
+{
+	if (draw_dock && draw_dock->GetVendor())
+		obs_websocket_vendor_emit_event(draw_dock->GetVendor(), event_name, event_data);
+}
+
+uint8_t *draw_encode_png(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t linesize, size_t *size)
+{
+	*size = 0;
+	QImage image(rgba, (int)width, (int)height, (int)linesize, QImage::Format_RGBA8888);
+	QByteArray png;
+	QBuffer buffer(&png);
+	buffer.open(QIODevice::WriteOnly);
+	if (!image.save(&buffer, "PNG"))
+		return nullptr;
+	*size = (size_t)png.size();
+	return (uint8_t *)bmemdup(png.constData(), *size);
+}
 
 MODULE_EXPORT const char *obs_module_description(void)
 {
@@ -145,6 +177,31 @@ static inline QColor color_from_int(long long val)
 	return QColor(val & 0xff, (val >> 8) & 0xff, (val >> 16) & 0xff, (val >> 24) & 0xff);
 }
 
+/* the draw source holding the canvas a draw source draws on, the owner of the shared canvas for a reference */
+static obs_source_t *draw_target(obs_source_t *source)
+{
+	obs_data_t *settings = obs_source_get_settings(source);
+	const char *name = obs_data_get_string(settings, "shared_canvas");
+	obs_source_t *owner = name && *name ? obs_get_source_by_name(name) : nullptr;
+	obs_data_release(settings);
+	if (owner && owner != source && strcmp(obs_source_get_unversioned_id(owner), "draw_source") == 0)
+		return owner;
+	obs_source_release(owner);
+	return obs_source_get_ref(source);
+}
+
+/* calls a proc once per canvas, a shared canvas shown by several draw sources must not be undone or cleared twice */
+static void call_draw_target(obs_source_t *source, const char *proc, calldata_t *cd, std::set<obs_source_t *> *called)
+{
+	obs_source_t *target = draw_target(source);
+	if (called->insert(target).second) {
+		proc_handler_t *ph = obs_source_get_proc_handler(target);
+		if (ph)
+			proc_handler_call(ph, proc, cd);
+	}
+	obs_source_release(target);
+}
+
 static inline long long color_to_int(QColor color)
 {
 	auto shift = [&](unsigned val, int shift) {
@@ -242,6 +299,8 @@ DrawDock::DrawDock(QWidget *_parent) : QFrame(_parent), eventFilter(BuildEventFi
 				obs_data_set_int(settings, "tool_color", obs_data_get_int(gdss, "tool_color"));
 				obs_data_set_double(settings, "tool_size", obs_data_get_double(gdss, "tool_size"));
 				obs_data_set_double(settings, "tool_alpha", obs_data_get_double(gdss, "tool_alpha"));
+				obs_data_set_int(settings, "brush_tip", obs_data_get_int(gdss, "brush_tip"));
+				obs_data_set_double(settings, "brush_hardness", obs_data_get_double(gdss, "brush_hardness"));
 				obs_data_release(settings);
 				obs_data_release(gdss);
 				auto action = toolbar->actions().at(i + 1);
@@ -295,6 +354,8 @@ DrawDock::DrawDock(QWidget *_parent) : QFrame(_parent), eventFilter(BuildEventFi
 			obs_data_set_int(settings, "tool_color", obs_data_get_int(gdss, "tool_color"));
 			obs_data_set_double(settings, "tool_size", obs_data_get_double(gdss, "tool_size"));
 			obs_data_set_double(settings, "tool_alpha", obs_data_get_double(gdss, "tool_alpha"));
+			obs_data_set_int(settings, "brush_tip", obs_data_get_int(gdss, "brush_tip"));
+			obs_data_set_double(settings, "brush_hardness", obs_data_get_double(gdss, "brush_hardness"));
 			obs_data_release(gdss);
 			obs_data_set_obj(tool, "settings", settings);
 			obs_data_release(settings);
@@ -425,15 +486,25 @@ DrawDock::DrawDock(QWidget *_parent) : QFrame(_parent), eventFilter(BuildEventFi
 			obs_data_release(settings);
 		});
 
+		a = menu.addAction(QString::fromUtf8(obs_module_text("VectorStrokes")));
+		a->setCheckable(true);
+		a->setChecked(obs_data_get_bool(settings, "vector"));
+		connect(a, &QAction::triggered, [this, a] {
+			if (!draw_source)
+				return;
+			obs_data_t *settings = obs_data_create();
+			obs_data_set_bool(settings, "vector", a->isChecked());
+			obs_source_update(draw_source, settings);
+			obs_data_release(settings);
+		});
+
 		menu.addSeparator();
 
 		menu.addAction(QString::fromUtf8(obs_module_text("Undo")), [this] {
+			std::set<obs_source_t *> called;
 			if (draw_source) {
-				proc_handler_t *ph = obs_source_get_proc_handler(draw_source);
-				if (!ph)
-					return;
 				calldata_t d = {};
-				proc_handler_call(ph, "undo", &d);
+				call_draw_target(draw_source, "undo", &d, &called);
 			}
 			obs_source_t *scene_source = obs_frontend_get_current_scene();
 			if (!scene_source)
@@ -444,16 +515,14 @@ DrawDock::DrawDock(QWidget *_parent) : QFrame(_parent), eventFilter(BuildEventFi
 			obs_source_release(scene_source);
 			if (!scene)
 				return;
-			obs_scene_enum_items(scene, scene_undo, nullptr);
+			obs_scene_enum_items(scene, scene_undo, &called);
 		});
 
 		menu.addAction(QString::fromUtf8(obs_module_text("Redo")), [this] {
+			std::set<obs_source_t *> called;
 			if (draw_source) {
-				proc_handler_t *ph = obs_source_get_proc_handler(draw_source);
-				if (!ph)
-					return;
 				calldata_t d = {};
-				proc_handler_call(ph, "redo", &d);
+				call_draw_target(draw_source, "redo", &d, &called);
 			}
 			obs_source_t *scene_source = obs_frontend_get_current_scene();
 			if (!scene_source)
@@ -464,7 +533,7 @@ DrawDock::DrawDock(QWidget *_parent) : QFrame(_parent), eventFilter(BuildEventFi
 			obs_source_release(scene_source);
 			if (!scene)
 				return;
-			obs_scene_enum_items(scene, scene_redo, nullptr);
+			obs_scene_enum_items(scene, scene_redo, &called);
 		});
 		auto undoMenu = menu.addMenu(QString::fromUtf8(obs_module_text("UndoMax")));
 		auto undowa = new QWidgetAction(undoMenu);
@@ -609,6 +678,25 @@ DrawDock::DrawDock(QWidget *_parent) : QFrame(_parent), eventFilter(BuildEventFi
 		obs_hotkey_load(clearHotkey, hotkeys);
 		obs_data_array_release(hotkeys);
 	}
+	snapshotHotkey = obs_hotkey_register_frontend("draw_snapshot", obs_module_text("DrawSnapshot"), snapshot_hotkey, this);
+	hotkeys = obs_data_get_array(config, "snapshot_hotkey");
+	if (hotkeys) {
+		obs_hotkey_load(snapshotHotkey, hotkeys);
+		obs_data_array_release(hotkeys);
+	}
+	pageNextHotkey = obs_hotkey_register_frontend("draw_page_next", obs_module_text("DrawPageNext"), page_hotkey, this);
+	hotkeys = obs_data_get_array(config, "page_next_hotkey");
+	if (hotkeys) {
+		obs_hotkey_load(pageNextHotkey, hotkeys);
+		obs_data_array_release(hotkeys);
+	}
+	pagePreviousHotkey =
+		obs_hotkey_register_frontend("draw_page_previous", obs_module_text("DrawPagePrevious"), page_hotkey, this);
+	hotkeys = obs_data_get_array(config, "page_previous_hotkey");
+	if (hotkeys) {
+		obs_hotkey_load(pagePreviousHotkey, hotkeys);
+		obs_data_array_release(hotkeys);
+	}
 	showHideHotkey = obs_hotkey_pair_register_frontend("draw_show", obs_module_text("DrawShow"), "draw_hide",
 							   obs_module_text("DrawHide"), show_hotkey, hide_hotkey, this, this);
 
@@ -650,6 +738,11 @@ DrawDock::DrawDock(QWidget *_parent) : QFrame(_parent), eventFilter(BuildEventFi
 			   QVariant(TOOL_SELECT_ELLIPSE));
 	toolCombo->addItem(CreateToolIcon(demoColor, TOOL_STAMP), obs_module_text("Stamp"), QVariant(TOOL_STAMP));
 	toolCombo->addItem(CreateToolIcon(demoColor, TOOL_IMAGE), obs_module_text("Image"), QVariant(TOOL_IMAGE));
+	toolCombo->addItem(CreateToolIcon(demoColor, TOOL_FILL), obs_module_text("Fill"), QVariant(TOOL_FILL));
+	toolCombo->addItem(CreateToolIcon(demoColor, TOOL_ERASE_STROKE), obs_module_text("EraseStroke"),
+			   QVariant(TOOL_ERASE_STROKE));
+	toolCombo->addItem(CreateToolIcon(demoColor, TOOL_SELECT_STROKE), obs_module_text("SelectStroke"),
+			   QVariant(TOOL_SELECT_STROKE));
 
 	connect(toolCombo, &QComboBox::currentIndexChanged, [this] {
 		int tool = toolCombo->currentData().toInt();
@@ -837,8 +930,16 @@ DrawDock::DrawDock(QWidget *_parent) : QFrame(_parent), eventFilter(BuildEventFi
 
 DrawDock::~DrawDock()
 {
+	if (draw_dock == this)
+		draw_dock = nullptr;
 	if (clearHotkey != OBS_INVALID_HOTKEY_ID)
 		obs_hotkey_unregister(clearHotkey);
+	if (snapshotHotkey != OBS_INVALID_HOTKEY_ID)
+		obs_hotkey_unregister(snapshotHotkey);
+	if (pageNextHotkey != OBS_INVALID_HOTKEY_ID)
+		obs_hotkey_unregister(pageNextHotkey);
+	if (pagePreviousHotkey != OBS_INVALID_HOTKEY_ID)
+		obs_hotkey_unregister(pagePreviousHotkey);
 	if (showHideHotkey != OBS_INVALID_HOTKEY_PAIR_ID)
 		obs_hotkey_pair_unregister(showHideHotkey);
 	for (auto i = favoriteToolHotkeys.begin(); i != favoriteToolHotkeys.end(); i++) {
@@ -1257,7 +1358,10 @@ bool DrawDock::HandleMouseMoveEvent(QMouseEvent *event)
 		return false;
 	if (tabletActive)
 		return false;
-	if (event->buttons() == Qt::LeftButton && event->modifiers().testFlag(Qt::ControlModifier)) {
+	if (event->buttons() == Qt::LeftButton && event->modifiers().testFlag(Qt::ControlModifier) && PanDraw(event->pos())) {
+		scrollingFromX = event->pos().x();
+		scrollingFromY = event->pos().y();
+	} else if (event->buttons() == Qt::LeftButton && event->modifiers().testFlag(Qt::ControlModifier)) {
 
 		QSize size = preview->size() * preview->devicePixelRatioF();
 		scrollX -= float(event->pos().x() - scrollingFromX) / size.width();
@@ -1717,6 +1821,21 @@ void DrawDock::SaveConfig()
 		obs_data_set_array(config, "clear_hotkey", clearHotkeyData);
 		obs_data_array_release(clearHotkeyData);
 	}
+	obs_data_array_t *snapshotHotkeyData = obs_hotkey_save(snapshotHotkey);
+	if (snapshotHotkeyData) {
+		obs_data_set_array(config, "snapshot_hotkey", snapshotHotkeyData);
+		obs_data_array_release(snapshotHotkeyData);
+	}
+	obs_data_array_t *pageNextHotkeyData = obs_hotkey_save(pageNextHotkey);
+	if (pageNextHotkeyData) {
+		obs_data_set_array(config, "page_next_hotkey", pageNextHotkeyData);
+		obs_data_array_release(pageNextHotkeyData);
+	}
+	obs_data_array_t *pagePreviousHotkeyData = obs_hotkey_save(pagePreviousHotkey);
+	if (pagePreviousHotkeyData) {
+		obs_data_set_array(config, "page_previous_hotkey", pagePreviousHotkeyData);
+		obs_data_array_release(pagePreviousHotkeyData);
+	}
 
 	obs_data_array_t *showHotkeyData = nullptr;
 	obs_data_array_t *hideHotkeyData = nullptr;
@@ -1931,6 +2050,27 @@ void DrawDock::clear_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey,
 	window->ClearDraw();
 }
 
+void DrawDock::snapshot_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	UNUSED_PARAMETER(hotkey);
+	UNUSED_PARAMETER(id);
+	if (!pressed)
+		return;
+
+	DrawDock *window = static_cast<DrawDock *>(data);
+	window->SaveSnapshot();
+}
+
+void DrawDock::page_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	UNUSED_PARAMETER(hotkey);
+	if (!pressed)
+		return;
+
+	DrawDock *window = static_cast<DrawDock *>(data);
+	window->StepPage(id == window->pagePreviousHotkey ? -1 : 1);
+}
+
 bool DrawDock::show_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed)
 {
 	UNUSED_PARAMETER(hotkey);
@@ -2061,6 +2201,41 @@ QIcon DrawDock::CreateToolIcon(QColor toolColor, uint32_t tool, double alpha, do
 		auto painter = QPainter(&pixmap);
 		painter.setPen(QPen(toolColor, toolSize, Qt::DotLine));
 		painter.drawEllipse(QRect(toolSize / 2.0, toolSize / 2.0, 256.0 - toolSize, 256.0 - toolSize));
+	} else if (tool == TOOL_FILL) {
+		auto painter = QPainter(&pixmap);
+		QPainterPath bucket;
+		bucket.moveTo(40, 96);
+		bucket.lineTo(152, 96);
+		bucket.lineTo(136, 236);
+		bucket.lineTo(56, 236);
+		bucket.closeSubpath();
+		painter.fillPath(bucket, toolColor);
+		painter.setPen(QPen(toolColor, 16, Qt::SolidLine, Qt::RoundCap));
+		painter.drawArc(QRect(52, 24, 88, 128), 0, 180 * 16);
+		QPainterPath drop;
+		drop.moveTo(208, 120);
+		drop.cubicTo(240, 176, 240, 212, 208, 212);
+		drop.cubicTo(176, 212, 176, 176, 208, 120);
+		painter.fillPath(drop, toolColor);
+	} else if (tool == TOOL_ERASE_STROKE) {
+		auto painter = QPainter(&pixmap);
+		painter.setPen(QPen(toolColor, 16, Qt::SolidLine, Qt::RoundCap));
+		QPainterPath path;
+		path.moveTo(24, 200);
+		path.cubicTo(88, 40, 168, 40, 232, 200);
+		painter.drawPath(path);
+		painter.setPen(QPen(toolColor, 24, Qt::SolidLine, Qt::RoundCap));
+		painter.drawLine(72, 72, 184, 184);
+		painter.drawLine(184, 72, 72, 184);
+	} else if (tool == TOOL_SELECT_STROKE) {
+		auto painter = QPainter(&pixmap);
+		painter.setPen(QPen(toolColor, 16, Qt::SolidLine, Qt::RoundCap));
+		QPainterPath path;
+		path.moveTo(48, 200);
+		path.cubicTo(96, 56, 160, 56, 208, 200);
+		painter.drawPath(path);
+		painter.setPen(QPen(toolColor, 8, Qt::DotLine));
+		painter.drawRect(QRect(8, 8, 240, 240));
 	} else if (tool == TOOL_STAMP || tool == TOOL_IMAGE) {
 		if (image && strlen(image)) {
 			pixmap = QPixmap(QString::fromUtf8(image));
@@ -2090,6 +2265,14 @@ void DrawDock::PostLoad()
 	obs_websocket_vendor_register_request(vendor, "version", vendor_request_version, nullptr);
 	obs_websocket_vendor_register_request(vendor, "clear", vendor_request_clear, nullptr);
 	obs_websocket_vendor_register_request(vendor, "draw", vendor_request_draw, nullptr);
+	obs_websocket_vendor_register_request(vendor, "begin_stroke", vendor_request_stroke, (void *)"begin_stroke");
+	obs_websocket_vendor_register_request(vendor, "append", vendor_request_stroke, (void *)"append_stroke");
+	obs_websocket_vendor_register_request(vendor, "end_stroke", vendor_request_stroke, (void *)"end_stroke");
+	obs_websocket_vendor_register_request(vendor, "ingest", vendor_request_ingest, nullptr);
+	obs_websocket_vendor_register_request(vendor, "snapshot", vendor_request_stroke, (void *)"snapshot");
+	obs_websocket_vendor_register_request(vendor, "page", vendor_request_stroke, (void *)"page");
+	obs_websocket_vendor_register_request(vendor, "pan", vendor_request_stroke, (void *)"pan");
+	obs_websocket_vendor_register_request(vendor, "erase_stroke", vendor_request_stroke, (void *)"erase_stroke");
 }
 
 void DrawDock::FinishedLoad()
@@ -2128,28 +2311,35 @@ void DrawDock::vendor_request_version(obs_data_t *request_data, obs_data_t *resp
 	obs_data_set_bool(response_data, "success", true);
 }
 
-void DrawDock::vendor_request_clear(obs_data_t *request_data, obs_data_t *response_data, void *)
+static obs_source_t *get_request_draw_source(obs_data_t *request_data, obs_data_t *response_data)
 {
 	auto source_name = obs_data_get_string(request_data, "source");
 	obs_source_t *source = nullptr;
 	if (!source_name || !strlen(source_name)) {
-		if (draw_dock && draw_dock->draw_source) {
-			source = obs_source_get_ref(draw_dock->draw_source);
-		}
+		if (draw_dock)
+			source = draw_dock->GetDrawSource();
 	} else {
 		source = obs_get_source_by_name(source_name);
 	}
 	if (!source) {
 		obs_data_set_string(response_data, "error", "'source' not found");
 		obs_data_set_bool(response_data, "success", false);
-		return;
+		return nullptr;
 	}
 	if (strcmp(obs_source_get_unversioned_id(source), "draw_source") != 0) {
 		obs_source_release(source);
 		obs_data_set_string(response_data, "error", "'source' not a draw source");
 		obs_data_set_bool(response_data, "success", false);
-		return;
+		return nullptr;
 	}
+	return source;
+}
+
+void DrawDock::vendor_request_clear(obs_data_t *request_data, obs_data_t *response_data, void *)
+{
+	obs_source_t *source = get_request_draw_source(request_data, response_data);
+	if (!source)
+		return;
 
 	proc_handler_t *ph = obs_source_get_proc_handler(source);
 	obs_source_release(source);
@@ -2163,26 +2353,49 @@ void DrawDock::vendor_request_clear(obs_data_t *request_data, obs_data_t *respon
 
 void DrawDock::vendor_request_draw(obs_data_t *request_data, obs_data_t *response_data, void *)
 {
-	auto source_name = obs_data_get_string(request_data, "source");
-	obs_source_t *source = nullptr;
-	if (!source_name || !strlen(source_name)) {
-		if (draw_dock && draw_dock->draw_source) {
-			source = obs_source_get_ref(draw_dock->draw_source);
-		}
-	} else {
-		source = obs_get_source_by_name(source_name);
-	}
-	if (!source) {
-		obs_data_set_string(response_data, "error", "'source' not found");
+	obs_source_t *source = get_request_draw_source(request_data, response_data);
+	if (!source)
+		return;
+
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	obs_source_release(source);
+	if (!ph) {
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
-	if (strcmp(obs_source_get_unversioned_id(source), "draw_source") != 0) {
-		obs_source_release(source);
-		obs_data_set_string(response_data, "error", "'source' not a draw source");
+	calldata_t d = {};
+	calldata_init(&d);
+	calldata_set_ptr(&d, "data", request_data);
+	obs_data_set_bool(response_data, "success", proc_handler_call(ph, "draw", &d));
+	calldata_free(&d);
+}
+
+void DrawDock::vendor_request_stroke(obs_data_t *request_data, obs_data_t *response_data, void *proc)
+{
+	obs_source_t *source = get_request_draw_source(request_data, response_data);
+	if (!source)
+		return;
+
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	obs_source_release(source);
+	if (!ph) {
 		obs_data_set_bool(response_data, "success", false);
 		return;
 	}
+	calldata_t d = {};
+	calldata_init(&d);
+	calldata_set_ptr(&d, "data", request_data);
+	calldata_set_ptr(&d, "response", response_data);
+	if (!proc_handler_call(ph, (const char *)proc, &d))
+		obs_data_set_bool(response_data, "success", false);
+	calldata_free(&d);
+}
+
+void DrawDock::vendor_request_ingest(obs_data_t *request_data, obs_data_t *response_data, void *)
+{
+	obs_source_t *source = get_request_draw_source(request_data, response_data);
+	if (!source)
+		return;
 
 	proc_handler_t *ph = obs_source_get_proc_handler(source);
 	obs_source_release(source);
@@ -2193,18 +2406,42 @@ void DrawDock::vendor_request_draw(obs_data_t *request_data, obs_data_t *respons
 	calldata_t d = {};
 	calldata_init(&d);
 	calldata_set_ptr(&d, "data", request_data);
-	obs_data_set_bool(response_data, "success", proc_handler_call(ph, "draw", &d));
+	obs_data_set_bool(response_data, "success", proc_handler_call(ph, "ingest", &d));
+	calldata_free(&d);
+}
+
+void DrawDock::SaveSnapshot()
+{
+	obs_source_t *source = GetDrawSource();
+	if (!source)
+		return;
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	obs_source_release(source);
+	if (!ph)
+		return;
+
+	char *dir = obs_frontend_get_current_record_output_path();
+	char *filename = os_generate_formatted_filename("png", true, "Draw %CCYY-%MM-%DD %hh-%mm-%ss");
+	std::string path = std::string(dir ? dir : ".") + "/" + filename;
+	bfree(filename);
+	bfree(dir);
+
+	obs_data_t *data = obs_data_create();
+	obs_data_set_string(data, "path", path.c_str());
+	calldata_t d = {};
+	calldata_init(&d);
+	calldata_set_ptr(&d, "data", data);
+	proc_handler_call(ph, "snapshot", &d);
 	calldata_free(&d);
+	obs_data_release(data);
 }
 
 void DrawDock::ClearDraw()
 {
+	std::set<obs_source_t *> called;
 	if (draw_source) {
-		proc_handler_t *ph = obs_source_get_proc_handler(draw_source);
-		if (!ph)
-			return;
 		calldata_t d = {};
-		proc_handler_call(ph, "clear", &d);
+		call_draw_target(draw_source, "clear", &d, &called);
 	}
 	obs_source_t *scene_source = obs_frontend_get_current_scene();
 	if (!scene_source)
@@ -2216,18 +2453,78 @@ void DrawDock::ClearDraw()
 
 	obs_scene_enum_items(
 		scene,
-		[](obs_scene_t *, obs_sceneitem_t *item, void *) {
+		[](obs_scene_t *, obs_sceneitem_t *item, void *data) {
 			auto source = obs_sceneitem_get_source(item);
 			if (!source || strcmp(obs_source_get_unversioned_id(source), "draw_source") != 0)
 				return true;
-			proc_handler_t *ph = obs_source_get_proc_handler(source);
-			if (!ph)
-				return true;
 			calldata_t cd = {};
-			proc_handler_call(ph, "clear", &cd);
+			call_draw_target(source, "clear", &cd, static_cast<std::set<obs_source_t *> *>(data));
 			return true;
 		},
-		nullptr);
+		&called);
+}
+
+/* ctrl dragging an infinite canvas pans it by the distance dragged in canvas pixels instead of scrolling the zoomed preview */
+bool DrawDock::PanDraw(QPoint pos)
+{
+	if (!draw_source)
+		return false;
+	obs_data_t *settings = obs_source_get_settings(draw_source);
+	bool infinite = obs_data_get_bool(settings, "infinite");
+	obs_data_release(settings);
+	if (!infinite)
+		return false;
+
+	int fromX, fromY, toX, toY;
+	GetSourceRelativeXY(scrollingFromX, scrollingFromY, fromX, fromY);
+	GetSourceRelativeXY(pos.x(), pos.y(), toX, toY);
+	if (fromX == toX && fromY == toY)
+		return true;
+	proc_handler_t *ph = obs_source_get_proc_handler(draw_source);
+	if (!ph)
+		return true;
+	obs_data_t *data = obs_data_create();
+	obs_data_set_int(data, "dx", fromX - toX);
+	obs_data_set_int(data, "dy", fromY - toY);
+	calldata_t d = {};
+	calldata_init(&d);
+	calldata_set_ptr(&d, "data", data);
+	proc_handler_call(ph, "pan", &d);
+	calldata_free(&d);
+	obs_data_release(data);
+	return true;
+}
+
+void DrawDock::StepPage(int step)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_set_int(data, "step", step);
+	calldata_t d = {};
+	calldata_init(&d);
+	calldata_set_ptr(&d, "data", data);
+	/* the dock source or a shared canvas may be in the scene too, stepping it twice would skip a page */
+	std::set<obs_source_t *> called;
+	if (draw_source)
+		call_draw_target(draw_source, "page", &d, &called);
+	obs_source_t *scene_source = obs_frontend_get_current_scene();
+	obs_scene_t *scene = obs_scene_from_source(scene_source);
+	obs_source_release(scene_source);
+	if (scene) {
+		std::pair<calldata_t *, std::set<obs_source_t *> *> param(&d, &called);
+		obs_scene_enum_items(
+			scene,
+			[](obs_scene_t *, obs_sceneitem_t *item, void *data) {
+				auto param = static_cast<std::pair<calldata_t *, std::set<obs_source_t *> *> *>(data);
+				auto source = obs_sceneitem_get_source(item);
+				if (!source || strcmp(obs_source_get_unversioned_id(source), "draw_source") != 0)
+					return true;
+				call_draw_target(source, "page", param->first, param->second);
+				return true;
+			},
+			&param);
+	}
+	calldata_free(&d);
+	obs_data_release(data);
 }
 
 void DrawDock::OpenFullScreenProjector()
@@ -2305,11 +2602,8 @@ bool DrawDock::scene_undo(obs_scene_t *, obs_sceneitem_t *item, void *data)
 	if (scene) {
 		obs_scene_enum_items(scene, scene_undo, data);
 	} else if (strcmp(obs_source_get_unversioned_id(source), "draw_source") == 0) {
-		proc_handler_t *ph = obs_source_get_proc_handler(source);
-		if (!ph)
-			return true;
 		calldata_t cd = {};
-		proc_handler_call(ph, "undo", &cd);
+		call_draw_target(source, "undo", &cd, static_cast<std::set<obs_source_t *> *>(data));
 	}
 	return true;
 }
@@ -2327,11 +2621,8 @@ bool DrawDock::scene_redo(obs_scene_t *, obs_sceneitem_t *item, void *data)
 	if (scene) {
 		obs_scene_enum_items(scene, scene_redo, data);
 	} else if (strcmp(obs_source_get_unversioned_id(source), "draw_source") == 0) {
-		proc_handler_t *ph = obs_source_get_proc_handler(source);
-		if (!ph)
-			return true;
 		calldata_t cd = {};
-		proc_handler_call(ph, "redo", &cd);
+		call_draw_target(source, "redo", &cd, static_cast<std::set<obs_source_t *> *>(data));
 	}
 	return true;
 }
@@ -2350,12 +2641,14 @@ bool DrawDock::scene_tool(obs_scene_t *, obs_sceneitem_t *item, void *data)
 		obs_scene_enum_items(scene, scene_tool, data);
 	} else if (strcmp(obs_source_get_unversioned_id(source), "draw_source") == 0) {
 		int tool = *((int *)data);
-		obs_data_t *ss = obs_source_get_settings(source);
+		obs_source_t *target = draw_target(source);
+		obs_data_t *ss = obs_source_get_settings(target);
 		if (obs_data_get_int(ss, "tool") != tool) {
 			obs_data_set_int(ss, "tool", tool);
-			obs_source_update(source, ss);
+			obs_source_update(target, ss);
 		}
 		obs_data_release(ss);
+		obs_source_release(target);
 	}
 	return true;
 }
@@ -2374,12 +2667,14 @@ bool DrawDock::scene_tool_color(obs_scene_t *, obs_sceneitem_t *item, void *data
 		obs_scene_enum_items(scene, scene_tool_color, data);
 	} else if (strcmp(obs_source_get_unversioned_id(source), "draw_source") == 0) {
 		long long longColor = *((long long *)data);
-		obs_data_t *ss = obs_source_get_settings(source);
+		obs_source_t *target = draw_target(source);
+		obs_data_t *ss = obs_source_get_settings(target);
 		if (obs_data_get_int(ss, "tool_color") != longColor) {
 			obs_data_set_int(ss, "tool_color", longColor);
-			obs_source_update(source, ss);
+			obs_source_update(target, ss);
 		}
 		obs_data_release(ss);
+		obs_source_release(target);
 	}
 	return true;
 }
@@ -2398,12 +2693,14 @@ bool DrawDock::scene_tool_image(obs_scene_t *, obs_sceneitem_t *item, void *data
 		obs_scene_enum_items(scene, scene_tool_image, data);
 	} else if (strcmp(obs_source_get_unversioned_id(source), "draw_source") == 0) {
 		const char *path = (const char *)data;
-		obs_data_t *ss = obs_source_get_settings(source);
+		obs_source_t *target = draw_target(source);
+		obs_data_t *ss = obs_source_get_settings(target);
 		if (strcmp(obs_data_get_string(ss, "tool_image_file"), path) != 0) {
 			obs_data_set_string(ss, "tool_image_file", path);
-			obs_source_update(source, ss);
+			obs_source_update(target, ss);
 		}
 		obs_data_release(ss);
+		obs_source_release(target);
 	}
 	return true;
 }
@@ -2422,12 +2719,14 @@ bool DrawDock::scene_tool_size(obs_scene_t *, obs_sceneitem_t *item, void *data)
 		obs_scene_enum_items(scene, scene_tool_size, data);
 	} else if (strcmp(obs_source_get_unversioned_id(source), "draw_source") == 0) {
 		double size = *((double *)data);
-		obs_data_t *ss = obs_source_get_settings(source);
+		obs_source_t *target = draw_target(source);
+		obs_data_t *ss = obs_source_get_settings(target);
 		if (abs(obs_data_get_double(ss, "tool_size") - size) > 0.1) {
 			obs_data_set_double(ss, "tool_size", size);
-			obs_source_update(source, ss);
+			obs_source_update(target, ss);
 		}
 		obs_data_release(ss);
+		obs_source_release(target);
 	}
 	return true;
 }
@@ -2446,12 +2745,14 @@ bool DrawDock::scene_tool_alpha(obs_scene_t *, obs_sceneitem_t *item, void *data
 		obs_scene_enum_items(scene, scene_tool_alpha, data);
 	} else if (strcmp(obs_source_get_unversioned_id(source), "draw_source") == 0) {
 		double alpha = *((double *)data);
-		obs_data_t *ss = obs_source_get_settings(source);
+		obs_source_t *target = draw_target(source);
+		obs_data_t *ss = obs_source_get_settings(target);
 		if (abs(obs_data_get_double(ss, "tool_alpha") - alpha) > 0.1) {
 			obs_data_set_double(ss, "tool_alpha", alpha);
-			obs_source_update(source, ss);
+			obs_source_update(target, ss);
 		}
 		obs_data_release(ss);
+		obs_source_release(target);
 	}
 	return true;
 }
@@ -2469,8 +2770,9 @@ bool DrawDock::scene_apply_tool(obs_scene_t *, obs_sceneitem_t *item, void *data
 	if (scene) {
 		obs_scene_enum_items(scene, scene_apply_tool, data);
 	} else if (strcmp(obs_source_get_unversioned_id(source), "draw_source") == 0) {
-		obs_data_t *settings = (obs_data_t *)data;
-		obs_source_update(source, settings);
+		obs_source_t *target = draw_target(source);
+		obs_source_update(target, (obs_data_t *)data);
+		obs_source_release(target);
 	}
 	return true;
 }
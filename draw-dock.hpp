@@ -46,6 +46,9 @@ private:
 	obs_data_t *config;
 	std::map<obs_hotkey_id, std::pair<QAction *, obs_data_t *>> favoriteToolHotkeys;
 	obs_hotkey_id clearHotkey = OBS_INVALID_HOTKEY_ID;
+	obs_hotkey_id snapshotHotkey = OBS_INVALID_HOTKEY_ID;
+	obs_hotkey_id pageNextHotkey = OBS_INVALID_HOTKEY_ID;
+	obs_hotkey_id pagePreviousHotkey = OBS_INVALID_HOTKEY_ID;
 	obs_hotkey_pair_id showHideHotkey = OBS_INVALID_HOTKEY_PAIR_ID;
 
 	float zoom = 1.0f;
@@ -80,6 +83,9 @@ private:
 	void SaveConfig();
 
 	void ClearDraw();
+	void SaveSnapshot();
+	void StepPage(int step);
+	bool PanDraw(QPoint pos);
 
 	QAction *AddFavoriteTool(obs_data_t *settings = nullptr);
 	void ApplyFavoriteTool(obs_data_t *settings = nullptr);
@@ -93,12 +99,16 @@ private:
 	static void draw_source_destroy(void *data, calldata_t *cd);
 	static void source_create(void *data, calldata_t *cd);
 	static void clear_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed);
+	static void snapshot_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed);
+	static void page_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed);
 	static bool show_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
 	static bool hide_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
 	static void favorite_tool_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed);
 	static void vendor_request_version(obs_data_t *request_data, obs_data_t *response_data, void *);
 	static void vendor_request_clear(obs_data_t *request_data, obs_data_t *response_data, void *);
 	static void vendor_request_draw(obs_data_t *request_data, obs_data_t *response_data, void *);
+	static void vendor_request_stroke(obs_data_t *request_data, obs_data_t *response_data, void *proc);
+	static void vendor_request_ingest(obs_data_t *request_data, obs_data_t *response_data, void *);
 
 	static bool scene_undo(obs_scene_t *, obs_sceneitem_t *item, void *);
 	static bool scene_redo(obs_scene_t *, obs_sceneitem_t *item, void *);
@@ -120,6 +130,8 @@ private slots:
 	void EscapeTriggered();
 
 public:
+	void *GetVendor() { return vendor; }
+	obs_source_t *GetDrawSource() { return draw_source ? obs_source_get_ref(draw_source) : nullptr; }
 	void PostLoad();
 	void FinishedLoad();
 	DrawDock(QWidget *parent = nullptr);
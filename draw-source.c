@@ -1,9 +1,182 @@
 #include "draw-source.h"
+#include "brush-tip.h"
+#include "image-cache.h"
+#include "qoi-codec.h"
+#include "stroke-codec.h"
+#include "stroke-index.h"
+#include "stroke-journal.h"
+#include "tile-store.h"
 #include "version.h"
-#include <graphics/image-file.h>
 #include <obs-frontend-api.h>
 #include <obs-module.h>
+#include <util/darray.h>
 #include <util/deque.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/task.h>
+#include <util/threading.h>
+#include <ctype.h>
+
+#define STROKE_QUEUE_CAPACITY 4096
+#define STROKE_POINTS_PER_TICK 64
+/* a stroke session without begin, append or end for this long is ended so a client that went away does not block others */
+#define STROKE_SESSION_TIMEOUT 5000000000ULL
+#define SNAPSHOT_MAP_DELAY_TICKS 2
+/* finished snapshots a client has not polled yet are dropped oldest first past this many */
+#define SNAPSHOT_RESULTS_MAX 16
+#define JOURNAL_COMPACT_PASSES 256
+#define STAMP_SET_MAX 16
+#define STAMP_CELL_MAX IMAGE_CACHE_RETAIN_SIZE
+#define STAMP_ATLAS_MAX_LEVELS 10
+#define DAB_BATCH 64
+#define DAB_PENDING_MAX 4096
+#define STROKE_LAYER_MARGIN 128.0f
+/* pixels a fill grows per pass in each direction, must match FILL_STEPS in draw.effect */
+#define FILL_STEPS 16
+/* a fill spreads FILL_STEPS * FILL_PASSES_PER_TICK pixels per frame, a pass cannot jump further without crossing one pixel
+ * walls, something that needs the canvas right away runs at most FILL_WAIT_PASSES more passes and keeps what is filled by then */
+#define FILL_PASSES_PER_TICK 8
+#define FILL_WAIT_PASSES 512
+/* while waiting the probe is mapped right away, so it is only staged once per this many passes */
+#define FILL_WAIT_PASSES_PER_PROBE 64
+#define FILL_PROBE_SIZE 64
+/* floating selection handles, grabbed at the corners to scale and at the middle of the top edge to rotate */
+#define FLOAT_HANDLE_SIZE 12.0f
+#define FLOAT_MOVE 0
+#define FLOAT_SCALE 1
+#define FLOAT_ROTATE 2
+#define LAYER_MAX 8
+#define PAGE_MAX 64
+/* tiles of an infinite canvas are kept on the GPU up to this many tiles from the viewport and prefetched as far ahead */
+#define TILE_PREFETCH 2
+/* packed tiles further away than this are paged out to the swap file */
+#define TILE_RAM_RADIUS 4
+/* what a snapshot reads besides a layer index, the current canvas or all visible layers flattened */
+#define SNAPSHOT_CANVAS -1
+#define SNAPSHOT_FLATTENED -2
+/* a reference looks up the source it shares the canvas of again at most this often while it is missing */
+#define SHARED_RESOLVE_INTERVAL 1000000000ULL
+/* the largest canvas width and height, saved images beyond it are not decoded */
+#define CANVAS_SIZE_MAX 10000
+/* segments an ellipse outline is indexed as, the chords cut inside the ring by at most 0.12% of its larger radius */
+#define VECTOR_ELLIPSE_SEGMENTS 64
+
+/* a stamp set packed on a worker thread, cells are a power of two so every mip level keeps stamps apart */
+struct stamp_atlas {
+	struct draw_source *ds;
+	struct image_cache_entry *stamps[STAMP_SET_MAX];
+	size_t count;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	uint8_t *data[STAMP_ATLAS_MAX_LEVELS];
+	struct vec4 rects[STAMP_SET_MAX];
+};
+
+struct draw_snapshot {
+	volatile long refs;
+	uint32_t id;
+	char *path;
+	bool qoi;
+	int layer;
+	bool premultiplied;
+	gs_stagesurf_t *stagesurf;
+	uint32_t ticks;
+	uint32_t width;
+	uint32_t height;
+	uint8_t *pixels;
+	char *image_b64;
+	/* keep the encoded image in memory instead of writing or base64 encoding it */
+	bool keep;
+	/* an image without a visible pixel is not written and the file at path is removed instead */
+	bool skip_empty;
+	/* set before encoding when no pixel was visible */
+	bool empty;
+	uint8_t *image;
+	size_t image_size;
+	bool success;
+	os_event_t *done;
+	void (*finished)(void *param, bool success);
+	void *finished_param;
+};
+
+struct undo_packed {
+	uint8_t *image;
+	size_t size;
+};
+
+/* a layer other than the current one, the current layer lives in the render_a and render_b pair */
+struct draw_layer {
+	gs_texrender_t *render;
+	bool visible;
+	float opacity;
+	bool unsaved;
+};
+
+/* a page that is not current, resident as texrenders or packed as QOI images in memory once it was evicted */
+struct draw_page {
+	gs_texrender_t *layers[LAYER_MAX];
+	uint8_t *packed[LAYER_MAX];
+	size_t packed_size[LAYER_MAX];
+	struct draw_snapshot *evicting[LAYER_MAX];
+	uint64_t used;
+	bool resident;
+	bool loaded;
+	bool unsaved;
+};
+
+/* draw.effect is compiled once and its parameter handles are shared by all draw sources */
+struct draw_shader {
+	gs_effect_t *effect;
+	gs_eparam_t *image_param;
+	gs_eparam_t *uv_size_param;
+	gs_eparam_t *uv_mouse_param;
+	gs_eparam_t *uv_mouse_previous_param;
+	gs_eparam_t *draw_cursor_param;
+	gs_eparam_t *cursor_color_param;
+	gs_eparam_t *cursor_size_param;
+	gs_eparam_t *cursor_image_param;
+	gs_eparam_t *cursor_frame_param;
+	gs_eparam_t *tool_param;
+	gs_eparam_t *tool_image_param;
+	gs_eparam_t *tool_image_size_param;
+	gs_eparam_t *brush_tip_param;
+	gs_eparam_t *brush_tip_size_param;
+	gs_eparam_t *stamp_rects_param;
+	gs_eparam_t *image_rect_param;
+	gs_eparam_t *dabs_param;
+	gs_eparam_t *dab_count_param;
+	gs_eparam_t *stroke_layer_param;
+	gs_eparam_t *stroke_rect_param;
+	gs_eparam_t *stroke_color_param;
+	gs_eparam_t *stroke_segment_param;
+	gs_eparam_t *fill_seed_param;
+	gs_eparam_t *fill_tolerance_param;
+	gs_eparam_t *fill_cell_param;
+	gs_eparam_t *float_image_param;
+	gs_eparam_t *float_rect_param;
+	gs_eparam_t *float_transform_param;
+	gs_eparam_t *float_angle_param;
+	gs_eparam_t *preview_rect_param;
+	gs_eparam_t *layer_opacity_param;
+	gs_eparam_t *tool_color_param;
+	gs_eparam_t *tool_size_param;
+	gs_eparam_t *tool_size_from_param;
+	gs_eparam_t *tool_mode_param;
+	gs_eparam_t *shift_down_param;
+	gs_eparam_t *select_from_param;
+	gs_eparam_t *select_to_param;
+};
+
+static struct draw_shader shader_cache;
+
+/* a stroke of the vector model, the settings of its stroke event with the points kept apart so parts can be joined */
+struct vector_object {
+	obs_data_t *stroke;
+	DARRAY(struct stroke_point) points;
+	struct vec4 bounds;
+	bool removed;
+};
 
 struct draw_source {
 	obs_source_t *source;
@@ -11,6 +184,11 @@ struct draw_source {
 
 	struct deque undo;
 	struct deque redo;
+	/* while the canvas is released the undo steps followed by the redo steps are packed as QOI images,
+	 * undo_packed_count of them are undo steps */
+	DARRAY(struct draw_snapshot *) undo_packing;
+	DARRAY(struct undo_packed) undo_packed;
+	size_t undo_packed_count;
 
 	uint32_t max_undo;
 	gs_texrender_t *render_a;
@@ -28,39 +206,217 @@ struct draw_source {
 	struct vec2 select_from;
 	struct vec2 select_to;
 
-	gs_effect_t *draw_effect;
-	gs_eparam_t *image_param;
-	gs_eparam_t *uv_size_param;
-	gs_eparam_t *uv_mouse_param;
-	gs_eparam_t *uv_mouse_previous_param;
-	gs_eparam_t *draw_cursor_param;
-	gs_eparam_t *cursor_color_param;
-	gs_eparam_t *cursor_size_param;
-	gs_eparam_t *cursor_image_param;
-	gs_eparam_t *tool_param;
-	gs_eparam_t *tool_image_param;
-	gs_eparam_t *tool_color_param;
-	gs_eparam_t *tool_size_param;
-	gs_eparam_t *tool_mode_param;
-	gs_eparam_t *shift_down_param;
-	gs_eparam_t *select_from_param;
-	gs_eparam_t *select_to_param;
+	const struct draw_shader *shader;
 
 	uint32_t tool;
 	char *tool_image_path;
-	gs_image_file4_t *tool_image;
+	struct image_cache_entry *tool_image;
+	struct image_cache_entry *tool_image_pending;
+	bool tool_image_swap;
 	struct vec4 tool_color;
 	float tool_size;
 	float tablet_factor;
+	uint32_t brush_tip;
+	float brush_hardness;
 
 	struct vec4 cursor_color;
 	float cursor_size;
 	float cursor_hide;
 	char *cursor_image_path;
-	gs_image_file4_t *cursor_image;
-	uint64_t last_tick;
+	struct image_cache_entry *cursor_image;
+	struct image_cache_entry *cursor_image_pending;
+	bool cursor_image_swap;
+	pthread_mutex_t image_mutex;
+
+	/* stamp set, packed into one mipmapped atlas with a uv rect per stamp */
+	size_t stamp_count;
+	struct image_cache_entry *stamps_pending[STAMP_SET_MAX];
+	size_t stamps_pending_count;
+	bool stamps_swap;
+	bool stamps_building;
+	struct stamp_atlas *stamps_built;
+	struct dstr stamp_files;
+	gs_texture_t *stamp_atlas;
+	struct vec4 stamp_rects[STAMP_SET_MAX];
+	uint32_t stamp_mode;
+	uint32_t stamp_next;
+	float stamp_spacing;
+
+	/* stamp dabs placed along the stroke, each x, y, half size and stamp index, drawn in batches once per frame */
+	DARRAY(struct vec4) dabs;
+	float dab_distance;
+	float dab_pressure;
+	struct vec4 dab_batch[DAB_BATCH];
+	int dab_batch_count;
+
+	/* active pencil or brush stroke, coverage accumulated with max blending in a texture covering stroke_rect */
+	gs_texrender_t *stroke_layer;
+	gs_texrender_t *stroke_layer_grow;
+	struct vec4 stroke_rect;
+	struct vec4 stroke_color;
+	float stroke_pressure;
+	bool stroke_layer_active;
+
+	/* flood fill running in the stroke layer, a few passes per frame until a probe read back finds no open edge */
+	float fill_tolerance;
+	bool fill_active;
+	struct vec2 fill_seed;
+	float fill_threshold;
+	uint32_t fill_passes;
+	struct vec4 fill_bounds;
+	uint32_t fill_bounds_pass;
+	gs_texrender_t *fill_probe;
+	gs_stagesurf_t *fill_probe_surf;
+	bool fill_probe_staged;
+	uint32_t fill_probe_ticks;
+	uint32_t fill_probe_pass;
+	struct vec4 fill_probe_rect;
+	struct vec4 fill_probe_cell;
+
+	/* selection lifted into its own texture while it is dragged, drawn as a transformed quad and composited on release */
+	gs_texrender_t *float_layer;
+	bool float_active;
+	uint32_t float_handle;
+	struct vec4 float_rect;
+
+	/* the shape of a line, rectangle, ellipse or image drag, rendered here and copied into the canvas on release */
+	gs_texrender_t *shape_layer;
+
+	/* visible layers below and above the current one are flattened premultiplied and only rebuilt when marked dirty */
+	struct draw_layer layers[LAYER_MAX];
+	uint32_t layer_count;
+	uint32_t layer_current;
+	gs_texrender_t *layers_below;
+	gs_texrender_t *layers_above;
+	gs_texrender_t *layers_flat;
+	bool layers_below_used;
+	bool layers_above_used;
+	bool layers_dirty;
+	uint8_t *layer_pixels[LAYER_MAX];
+	uint32_t layer_width[LAYER_MAX];
+	uint32_t layer_height[LAYER_MAX];
+
+	/* the current page lives in the layers above, only page_resident pages including it keep their textures */
+	struct draw_page pages[PAGE_MAX];
+	uint32_t page_count;
+	uint32_t page_current;
+	uint32_t page_resident;
+	uint64_t page_clock;
+	uint32_t pages_evicting;
+	/* a page switched to from the proc or a hotkey is decoded on the worker first and made current on the tick after,
+	 * the decoded layers are handed over under snapshot_mutex */
+	bool page_loading;
+	uint32_t page_target;
+	uint32_t page_decode_id;
+	bool page_decoded;
+	uint8_t *page_pixels[LAYER_MAX];
+	uint32_t page_width[LAYER_MAX];
+	uint32_t page_height[LAYER_MAX];
+
+	/* an infinite canvas, the layers are a viewport at view_x, view_y into tiles that are synced and composed on every pan */
+	bool infinite;
+	struct tile_store *tiles;
+	int32_t view_x;
+	int32_t view_y;
+	/* wheel and pan proc moves are collected here and applied once per tick */
+	bool view_pending;
+	int32_t view_target_x;
+	int32_t view_target_y;
+	uint64_t tile_clock;
+	uint32_t tiles_prefetching;
+	uint32_t tiles_evicting;
 	bool clear_on_transition;
 	float since_last_move;
+
+	pthread_mutex_t stroke_mutex;
+	DARRAY(struct stroke_point) stroke_queue;
+	uint32_t stroke_session;
+	uint32_t stroke_seq;
+	bool stroke_active;
+	bool stroke_ending;
+	uint64_t stroke_decimated;
+	uint64_t stroke_touched;
+	uint32_t stroke_tool;
+	struct vec4 stroke_tool_color;
+	float stroke_tool_size;
+	bool stroke_drawing;
+	struct vec2 stroke_first_pos;
+	struct vec2 stroke_previous_pos;
+
+	obs_data_array_t *events;
+	/* recorded pixels of a rect, staged and waiting to be queued as snapshots, the events are held until their images
+	 * are in so mirrors and the journal get them in order */
+	DARRAY(struct draw_snapshot *) patches;
+	volatile long patches_pending;
+	gs_texrender_t *patch_layer;
+	DARRAY(struct stroke_point) record_points;
+	uint32_t record_tool;
+	struct vec4 record_color;
+	float record_size;
+	uint32_t record_brush_tip;
+	float record_brush_hardness;
+	bool record_dot;
+	bool record_suspended;
+
+	/* strokes drawn onto vector_base since it was taken, one object per undo step on a grid index for the object eraser
+	 * and stroke select, whatever the model can not replay is baked into a new base at the next undo step */
+	bool vector;
+	DARRAY(struct vector_object) vector_objects;
+	struct stroke_index *vector_index;
+	gs_texrender_t *vector_base;
+	gs_texrender_t *vector_scratch_a;
+	gs_texrender_t *vector_scratch_b;
+	bool vector_open;
+	bool vector_stale;
+	bool vector_erased;
+	uint32_t vector_selected;
+	/* while an erase replays strokes only this rect of the canvas is drawn, zero sized otherwise */
+	struct vec4 replay_clip;
+
+	pthread_mutex_t snapshot_mutex;
+	DARRAY(struct draw_snapshot *) snapshots;
+	/* snapshots requested with a response, kept until the client polls them by id */
+	DARRAY(struct draw_snapshot *) snapshot_results;
+	uint32_t snapshot_next_id;
+	os_task_queue_t *snapshot_tasks;
+
+	char *canvas_path;
+	uint8_t *canvas_pixels;
+	uint32_t canvas_width;
+	uint32_t canvas_height;
+	volatile long canvas_version;
+	volatile long canvas_saved_version;
+	bool canvas_loading;
+	volatile bool canvas_loaded;
+	/* the source was deleted rather than unloaded with its scene collection, its files go with it */
+	bool removed;
+	bool collection_closing;
+
+	/* the canvas is packed off the GPU once the source was neither shown nor rendered for release_delay seconds */
+	bool canvas_released;
+	uint64_t rendered;
+	uint64_t release_delay;
+
+	/* a reference to the canvas of the draw source named shared_name only composites it with its own transform,
+	 * input and procs are handed to that source and the canvas of the reference itself stays released */
+	bool shared;
+	char *shared_name;
+	obs_weak_source_t *shared_canvas;
+	obs_weak_source_t *shared_shown;
+	uint64_t shared_resolved;
+	pthread_mutex_t shared_mutex;
+	struct vec2 shared_offset;
+	float shared_scale;
+	float shared_rotation;
+
+	char *journal_dir;
+	bool journal_recover;
+	struct stroke_journal *journal;
+	os_task_queue_t *journal_tasks;
+	obs_data_array_t *journal_replay;
+	uint64_t journal_generation;
+	uint32_t journal_passes;
+	bool journal_checkpoint_due;
 };
 
 const char *ds_get_name(void *data)
@@ -69,295 +425,3812 @@ const char *ds_get_name(void *data)
 	return obs_module_text("Draw");
 }
 
-static void draw_effect(struct draw_source *ds, gs_texture_t *tex, bool mouse)
+/* the selection as a canvas rect on whole pixels */
+static void float_selection(struct draw_source *ds, struct vec4 *rect)
 {
-	gs_effect_set_vec2(ds->uv_size_param, &ds->size);
-	gs_effect_set_vec2(ds->uv_mouse_param, &ds->mouse_pos);
-	gs_effect_set_vec2(ds->uv_mouse_previous_param, &ds->mouse_previous_pos);
-	gs_effect_set_vec2(ds->select_from_param, &ds->select_from);
-	gs_effect_set_vec2(ds->select_to_param, &ds->select_to);
-	gs_effect_set_int(ds->draw_cursor_param, (mouse && (ds->cursor_hide <= 0.0f || ds->since_last_move < ds->cursor_hide))
-							 ? (ds->cursor_image ? 2 : 1)
-							 : 0);
-	gs_effect_set_vec4(ds->cursor_color_param, &ds->cursor_color);
-	gs_effect_set_float(ds->cursor_size_param, ds->cursor_size);
-	gs_effect_set_texture(ds->cursor_image_param, ds->cursor_image ? ds->cursor_image->image3.image2.image.texture : NULL);
-	gs_effect_set_int(ds->tool_param, ds->tool);
-	gs_effect_set_texture(ds->tool_image_param, ds->tool_image ? ds->tool_image->image3.image2.image.texture : NULL);
-	gs_effect_set_vec4(ds->tool_color_param, &ds->tool_color);
-	gs_effect_set_float(ds->tool_size_param, ds->tool_size * ds->tablet_factor);
-	gs_effect_set_int(ds->tool_mode_param, ds->tool_mode);
-	gs_effect_set_bool(ds->shift_down_param, ds->shift_down);
-	gs_effect_set_texture(ds->image_param, tex);
-	while (gs_effect_loop(ds->draw_effect, "Draw"))
-		gs_draw_sprite(tex, 0, (uint32_t)ds->size.x, (uint32_t)ds->size.y);
+	float x0 = floorf(fminf(ds->select_from.x, ds->select_to.x));
+	float y0 = floorf(fminf(ds->select_from.y, ds->select_to.y));
+	float x1 = ceilf(fmaxf(ds->select_from.x, ds->select_to.x));
+	float y1 = ceilf(fmaxf(ds->select_from.y, ds->select_to.y));
+	vec4_set(rect, x0, y0, x1 - x0, y1 - y0);
 }
 
-static void copy_to_undo(struct draw_source *ds)
+static uint32_t float_handle_at(const struct vec4 *rect, const struct vec2 *pos)
 {
-	obs_enter_graphics();
-	while (ds->redo.size) {
-		gs_texrender_t *old;
-		deque_pop_front(&ds->redo, &old, sizeof(old));
-		gs_texrender_destroy(old);
-	}
-	gs_texrender_t *texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
-	if (gs_texrender_begin(texrender, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
-		gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
-		gs_blend_state_push();
-		gs_reset_blend_state();
-		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-
-		gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
-		if (tex)
-			draw_effect(ds, tex, false);
-		gs_blend_state_pop();
-		gs_texrender_end(texrender);
-		deque_push_back(&ds->undo, &texrender, sizeof(texrender));
-		if (ds->undo.size > sizeof(texrender) * ds->max_undo) {
-			deque_pop_front(&ds->undo, &texrender, sizeof(texrender));
-			gs_texrender_destroy(texrender);
-		}
-	}
-	obs_leave_graphics();
+	float h = fminf(FLOAT_HANDLE_SIZE, fminf(rect->z, rect->w) / 3.0f);
+	bool left = pos->x < rect->x + h;
+	bool right = pos->x > rect->x + rect->z - h;
+	bool top = pos->y < rect->y + h;
+	bool bottom = pos->y > rect->y + rect->w - h;
+	if ((left || right) && (top || bottom))
+		return FLOAT_SCALE;
+	if (top && fabsf(pos->x - (rect->x + rect->z / 2.0f)) < h)
+		return FLOAT_ROTATE;
+	return FLOAT_MOVE;
 }
 
-void draw_clear(struct draw_source *ds)
+/* offset, scale and rotation about the selection center from the drag start to the mouse, identity when not floating */
+static void float_transform(struct draw_source *ds, struct vec2 *offset, struct vec2 *scale, float *angle)
 {
-	copy_to_undo(ds);
-	obs_enter_graphics();
-	gs_texrender_reset(ds->render_a_active ? ds->render_b : ds->render_a);
-	if (gs_texrender_begin(ds->render_a_active ? ds->render_b : ds->render_a, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
-		struct vec4 clear_color;
-		vec4_zero(&clear_color);
-		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
-		gs_texrender_end(ds->render_a_active ? ds->render_b : ds->render_a);
-		ds->render_a_active = !ds->render_a_active;
+	vec2_zero(offset);
+	vec2_set(scale, 1.0f, 1.0f);
+	*angle = 0.0f;
+	if (!ds->float_active)
+		return;
+	const struct vec2 *start = &ds->mouse_previous_pos;
+	const struct vec2 *pos = &ds->mouse_pos;
+	float cx = ds->float_rect.x + ds->float_rect.z / 2.0f;
+	float cy = ds->float_rect.y + ds->float_rect.w / 2.0f;
+	if (ds->float_handle == FLOAT_SCALE) {
+		float sx = fabsf(start->x - cx) >= 1.0f ? fabsf(pos->x - cx) / fabsf(start->x - cx) : 1.0f;
+		float sy = fabsf(start->y - cy) >= 1.0f ? fabsf(pos->y - cy) / fabsf(start->y - cy) : 1.0f;
+		if (ds->shift_down)
+			sx = sy = fmaxf(sx, sy);
+		vec2_set(scale, fmaxf(sx, 0.01f), fmaxf(sy, 0.01f));
+	} else if (ds->float_handle == FLOAT_ROTATE) {
+		*angle = atan2f(pos->y - cy, pos->x - cx) - atan2f(start->y - cy, start->x - cx);
+	} else {
+		vec2_sub(offset, pos, start);
 	}
-	obs_leave_graphics();
 }
 
-void clear_proc_handler(void *data, calldata_t *cd)
+/* maps a point of rect, relative to its top left, through the floating transform onto the canvas */
+static void float_map(struct draw_source *ds, const struct vec4 *rect, float x, float y, struct vec2 *out)
 {
-	UNUSED_PARAMETER(cd);
-	struct draw_source *context = data;
-	draw_clear(context);
+	struct vec2 offset;
+	struct vec2 scale;
+	float angle;
+	float_transform(ds, &offset, &scale, &angle);
+	float px = (x - rect->z / 2.0f) * scale.x;
+	float py = (y - rect->w / 2.0f) * scale.y;
+	float c = cosf(angle);
+	float s = sinf(angle);
+	out->x = rect->x + rect->z / 2.0f + offset.x + px * c - py * s;
+	out->y = rect->y + rect->w / 2.0f + offset.y + px * s + py * c;
 }
 
-static void apply_tool(struct draw_source *ds);
-
-void draw_proc_handler(void *param, calldata_t *cd)
+static void draw_effect_params(struct draw_source *ds, gs_texture_t *tex, bool mouse)
 {
-	struct draw_source *context = param;
-	obs_data_t *data = calldata_ptr(cd, "data");
+	gs_effect_set_vec2(ds->shader->uv_size_param, &ds->size);
+	gs_effect_set_vec2(ds->shader->uv_mouse_param, &ds->mouse_pos);
+	gs_effect_set_vec2(ds->shader->uv_mouse_previous_param, &ds->mouse_previous_pos);
+	gs_effect_set_vec2(ds->shader->select_from_param, &ds->select_from);
+	gs_effect_set_vec2(ds->shader->select_to_param, &ds->select_to);
+	gs_effect_set_int(ds->shader->draw_cursor_param, (mouse && (ds->cursor_hide <= 0.0f || ds->since_last_move < ds->cursor_hide))
+							 ? (ds->cursor_image ? 2 : 1)
+							 : 0);
+	gs_effect_set_vec4(ds->shader->cursor_color_param, &ds->cursor_color);
+	gs_effect_set_float(ds->shader->cursor_size_param, ds->cursor_size);
+	gs_effect_set_texture(ds->shader->cursor_image_param, image_cache_texture(ds->cursor_image));
+	struct vec2 cursor_frame;
+	image_cache_frame(ds->cursor_image, &cursor_frame);
+	gs_effect_set_vec2(ds->shader->cursor_frame_param, &cursor_frame);
+	gs_effect_set_int(ds->shader->tool_param, ds->tool);
+	gs_texture_t *tool_image = ds->stamp_count ? ds->stamp_atlas : image_cache_texture(ds->tool_image);
+	struct vec2 tool_image_size;
+	vec2_set(&tool_image_size, tool_image ? (float)gs_texture_get_width(tool_image) : 1.0f,
+		 tool_image ? (float)gs_texture_get_height(tool_image) : 1.0f);
+	gs_effect_set_texture(ds->shader->tool_image_param, tool_image);
+	gs_effect_set_vec2(ds->shader->tool_image_size_param, &tool_image_size);
+	gs_texture_t *brush_tip = ds->brush_tip == BRUSH_TIP_IMAGE
+					  ? image_cache_texture(ds->tool_image)
+					  : brush_tip_texture(ds->brush_tip, ds->brush_hardness, ds->tool_size);
+	struct vec2 brush_tip_size;
+	vec2_set(&brush_tip_size, brush_tip ? (float)gs_texture_get_width(brush_tip) : 1.0f,
+		 brush_tip ? (float)gs_texture_get_height(brush_tip) : 1.0f);
+	gs_effect_set_texture(ds->shader->brush_tip_param, brush_tip);
+	gs_effect_set_vec2(ds->shader->brush_tip_size_param, &brush_tip_size);
+	gs_effect_set_val(ds->shader->stamp_rects_param, ds->stamp_rects, sizeof(ds->stamp_rects));
+	/* the image tool always places the first image of a stamp set, a dab picks its own stamp per placement */
+	gs_effect_set_vec4(ds->shader->image_rect_param, &ds->stamp_rects[0]);
+	gs_effect_set_val(ds->shader->dabs_param, ds->dab_batch, sizeof(ds->dab_batch));
+	gs_effect_set_int(ds->shader->dab_count_param, ds->dab_batch_count);
+	gs_effect_set_vec4(ds->shader->tool_color_param, &ds->tool_color);
+	gs_effect_set_float(ds->shader->tool_size_param, ds->tool_size * ds->tablet_factor);
+	gs_effect_set_float(ds->shader->tool_size_from_param, ds->tool_size * ds->tablet_factor);
+	gs_effect_set_int(ds->shader->tool_mode_param, ds->tool_mode);
+	gs_effect_set_bool(ds->shader->shift_down_param, ds->shift_down);
+	struct vec4 stroke_rect;
+	vec4_zero(&stroke_rect);
+	if (ds->stroke_layer_active)
+		stroke_rect = ds->stroke_rect;
+	gs_effect_set_texture(ds->shader->stroke_layer_param,
+			      ds->stroke_layer_active ? gs_texrender_get_texture(ds->stroke_layer) : NULL);
+	gs_effect_set_vec4(ds->shader->stroke_rect_param, &stroke_rect);
+	gs_effect_set_vec4(ds->shader->stroke_color_param, &ds->stroke_color);
+	struct vec2 float_offset;
+	struct vec2 float_scale;
+	float float_angle;
+	float_transform(ds, &float_offset, &float_scale, &float_angle);
+	struct vec4 float_transform_value;
+	vec4_set(&float_transform_value, float_offset.x, float_offset.y, float_scale.x, float_scale.y);
+	gs_effect_set_texture(ds->shader->float_image_param, ds->float_active ? gs_texrender_get_texture(ds->float_layer) : NULL);
+	gs_effect_set_vec4(ds->shader->float_rect_param, &ds->float_rect);
+	gs_effect_set_vec4(ds->shader->float_transform_param, &float_transform_value);
+	gs_effect_set_float(ds->shader->float_angle_param, float_angle);
+	struct vec4 preview_rect;
+	vec4_zero(&preview_rect);
+	gs_effect_set_vec4(ds->shader->preview_rect_param, &preview_rect);
+	gs_effect_set_float(ds->shader->layer_opacity_param, 1.0f);
+	gs_effect_set_texture(ds->shader->image_param, tex);
+}
 
-	if (obs_data_has_user_value(data, "tool"))
-		context->tool = (uint32_t)obs_data_get_int(data, "tool");
-	if (obs_data_has_user_value(data, "from_x"))
-		context->mouse_previous_pos.x = (float)obs_data_get_double(data, "from_x");
-	if (obs_data_has_user_value(data, "from_y"))
-		context->mouse_previous_pos.y = (float)obs_data_get_double(data, "from_y");
-	if (obs_data_has_user_value(data, "to_x"))
-		context->mouse_pos.x = (float)obs_data_get_double(data, "to_x");
-	if (obs_data_has_user_value(data, "to_y"))
-		context->mouse_pos.y = (float)obs_data_get_double(data, "to_y");
-	if (obs_data_has_user_value(data, "tool_color")) {
-		vec4_from_rgba(&context->tool_color, (uint32_t)obs_data_get_int(data, "tool_color"));
-		if (context->tool_color.w == 0.0f)
-			context->tool_color.w = 1.0f;
-	}
-	if (obs_data_has_user_value(data, "tool_alpha"))
-		context->tool_color.w = (float)obs_data_get_double(data, "tool_alpha") / 100.0f;
-	if (obs_data_has_user_value(data, "tool_size"))
-		context->tool_size = (float)obs_data_get_double(data, "tool_size");
-	context->tool_mode = TOOL_DOWN;
-	apply_tool(context);
-	context->tool_mode = TOOL_UP;
-	context->mouse_previous_pos = context->mouse_pos;
+/* bounds of the shape being dragged, on whole canvas pixels with room for the outline, false for tools without a shape */
+static bool shape_rect(struct draw_source *ds, struct vec4 *rect)
+{
+	if (ds->tool != TOOL_LINE && ds->tool != TOOL_RECTANGLE_OUTLINE && ds->tool != TOOL_RECTANGLE_FILL &&
+	    ds->tool != TOOL_ELLIPSE_OUTLINE && ds->tool != TOOL_ELLIPSE_FILL && ds->tool != TOOL_IMAGE)
+		return false;
+	if (ds->tool_mode != TOOL_DOWN || ds->mouse_previous_pos.x < 0.0f || ds->mouse_previous_pos.y < 0.0f)
+		return false;
+	float margin = ds->tool_size + 2.0f;
+	float x0 = fmaxf(floorf(fminf(ds->mouse_previous_pos.x, ds->mouse_pos.x) - margin), 0.0f);
+	float y0 = fmaxf(floorf(fminf(ds->mouse_previous_pos.y, ds->mouse_pos.y) - margin), 0.0f);
+	float x1 = fminf(ceilf(fmaxf(ds->mouse_previous_pos.x, ds->mouse_pos.x) + margin), ds->size.x);
+	float y1 = fminf(ceilf(fmaxf(ds->mouse_previous_pos.y, ds->mouse_pos.y) + margin), ds->size.y);
+	if (x1 <= x0 || y1 <= y0)
+		return false;
+	vec4_set(rect, x0, y0, x1 - x0, y1 - y0);
+	return true;
 }
 
-void undo(struct draw_source *ds)
+static void draw_effect(struct draw_source *ds, gs_texture_t *tex, bool mouse, const char *technique)
 {
-	if (!ds->undo.size)
-		return;
+	draw_effect_params(ds, tex, mouse);
+	while (gs_effect_loop(ds->shader->effect, technique))
+		gs_draw_sprite(tex, 0, (uint32_t)ds->size.x, (uint32_t)ds->size.y);
+}
 
-	gs_texrender_t *texrender;
-	deque_pop_back(&ds->undo, &texrender, sizeof(texrender));
+static bool draw_on_mouse_move(uint32_t tool)
+{
+	return tool == TOOL_PENCIL || tool == TOOL_BRUSH || tool == TOOL_STAMP;
+}
 
-	if (ds->render_a_active) {
-		gs_texrender_t *old = ds->render_a;
-		ds->render_a = texrender;
-		deque_push_back(&ds->redo, &old, sizeof(old));
-	} else {
-		gs_texrender_t *old = ds->render_b;
-		ds->render_b = texrender;
-		deque_push_back(&ds->redo, &old, sizeof(old));
-	}
+/* tools that pick strokes of the vector model instead of drawing */
+static bool picks_stroke(uint32_t tool)
+{
+	return tool == TOOL_ERASE_STROKE || tool == TOOL_SELECT_STROKE;
 }
 
-void undo_proc_handler(void *data, calldata_t *cd)
+static bool recording(struct draw_source *ds)
 {
-	UNUSED_PARAMETER(cd);
-	struct draw_source *ds = data;
-	undo(ds);
+	return !ds->record_suspended && (ds->vector || ds->journal || draw_vendor_available());
 }
 
-void redo(struct draw_source *ds)
+static void vector_select(struct draw_source *ds, uint32_t id)
 {
-	if (!ds->redo.size)
+	if (id == STROKE_INDEX_NONE || id >= ds->vector_objects.num) {
+		if (ds->vector_selected != STROKE_INDEX_NONE)
+			ds->select_to = ds->select_from;
+		ds->vector_selected = STROKE_INDEX_NONE;
 		return;
+	}
+	const struct vec4 *bounds = &ds->vector_objects.array[id].bounds;
+	vec2_set(&ds->select_from, bounds->x, bounds->y);
+	vec2_set(&ds->select_to, bounds->z, bounds->w);
+	ds->vector_selected = id;
+}
 
-	gs_texrender_t *texrender = NULL;
-	deque_pop_back(&ds->redo, &texrender, sizeof(texrender));
-
-	if (ds->render_a_active) {
-		gs_texrender_t *old = ds->render_a;
-		ds->render_a = texrender;
-		deque_push_back(&ds->undo, &old, sizeof(old));
-	} else {
-		gs_texrender_t *old = ds->render_b;
-		ds->render_b = texrender;
-		deque_push_back(&ds->undo, &old, sizeof(old));
+static void vector_clear_objects(struct draw_source *ds)
+{
+	vector_select(ds, STROKE_INDEX_NONE);
+	for (size_t i = 0; i < ds->vector_objects.num; i++) {
+		obs_data_release(ds->vector_objects.array[i].stroke);
+		da_free(ds->vector_objects.array[i].points);
 	}
+	ds->vector_objects.num = 0;
+	stroke_index_destroy(ds->vector_index);
+	ds->vector_index = NULL;
+	ds->vector_open = false;
 }
 
-void redo_proc_handler(void *data, calldata_t *cd)
+/* drops the model and its textures, called with the graphics lock held */
+static void vector_reset(struct draw_source *ds)
 {
-	UNUSED_PARAMETER(cd);
-	struct draw_source *ds = data;
-	redo(ds);
+	vector_clear_objects(ds);
+	gs_texrender_destroy(ds->vector_base);
+	gs_texrender_destroy(ds->vector_scratch_a);
+	gs_texrender_destroy(ds->vector_scratch_b);
+	ds->vector_base = NULL;
+	ds->vector_scratch_a = NULL;
+	ds->vector_scratch_b = NULL;
+	ds->vector_stale = true;
 }
 
-static bool draw_on_mouse_move(uint32_t tool)
+/* the canvas changed in a way the model can not replay, the next undo step takes it as the new base */
+static void vector_stale(struct draw_source *ds)
 {
-	return tool == TOOL_PENCIL || tool == TOOL_BRUSH || tool == TOOL_STAMP;
+	ds->vector_stale = true;
+	vector_select(ds, STROKE_INDEX_NONE);
 }
 
-void tablet_proc_handler(void *data, calldata_t *cd)
+static bool vector_same_tool(obs_data_t *a, obs_data_t *b)
 {
-	struct draw_source *ds = data;
-	bool draw = draw_on_mouse_move(ds->tool);
+	return obs_data_get_int(a, "tool") == obs_data_get_int(b, "tool") &&
+	       obs_data_get_int(a, "tool_color") == obs_data_get_int(b, "tool_color") &&
+	       obs_data_get_double(a, "tool_alpha") == obs_data_get_double(b, "tool_alpha") &&
+	       obs_data_get_double(a, "tool_size") == obs_data_get_double(b, "tool_size") &&
+	       obs_data_get_int(a, "brush_tip") == obs_data_get_int(b, "brush_tip") &&
+	       obs_data_get_double(a, "brush_hardness") == obs_data_get_double(b, "brush_hardness");
+}
 
-	double pressure = calldata_float(cd, "pressure");
-	if (pressure > 0.0 && draw) {
-		ds->mouse_previous_pos = ds->mouse_pos;
+/* a held shift snaps a line to its longer axis and squares a rectangle or ellipse on its shorter side, like draw.effect */
+static void vector_constrain(uint32_t tool, float x0, float y0, float *x1, float *y1)
+{
+	float dx = *x1 - x0;
+	float dy = *y1 - y0;
+	if (tool == TOOL_LINE) {
+		if (fabsf(dx) < fabsf(dy))
+			*x1 = x0;
+		else
+			*y1 = y0;
+	} else if (fabsf(dx) > fabsf(dy)) {
+		*x1 = x0 + copysignf(fabsf(dy), dx);
+	} else {
+		*y1 = y0 + copysignf(fabsf(dx), dy);
 	}
-	ds->mouse_pos.x = (float)calldata_int(cd, "posx");
-	ds->mouse_pos.y = (float)calldata_int(cd, "posy");
-	ds->mouse_active = pressure > 0.0;
-	ds->shift_down = false; //((event->modifiers & INTERACT_SHIFT_KEY) == INTERACT_SHIFT_KEY);
+}
 
-	ds->tablet_factor = draw ? (float)pressure : 1.0f;
-	if (ds->mouse_active && ds->tool_mode != TOOL_UP && draw) {
-		apply_tool(ds);
+/* indexes the segments of a pencil or brush line, a line, the edges of a rectangle outline or the ring of an ellipse
+ * outline as chords, filled shapes as their box, and grows bounds over the points */
+static void vector_index_add(struct draw_source *ds, uint32_t id, obs_data_t *stroke, const struct stroke_point *points,
+			     size_t count, struct vec4 *bounds)
+{
+	uint32_t tool = (uint32_t)obs_data_get_int(stroke, "tool");
+	float size = (float)obs_data_get_double(stroke, "tool_size");
+	float margin = size + 2.0f;
+	for (size_t i = 0; i < count; i++) {
+		bounds->x = fminf(bounds->x, points[i].x - margin);
+		bounds->y = fminf(bounds->y, points[i].y - margin);
+		bounds->z = fmaxf(bounds->z, points[i].x + margin);
+		bounds->w = fmaxf(bounds->w, points[i].y + margin);
+	}
+	struct stroke_index *index = ds->vector_index;
+	if (tool == TOOL_PENCIL || tool == TOOL_BRUSH) {
+		if (count == 1)
+			stroke_index_add_segment(index, id, points[0].x, points[0].y, points[0].x, points[0].y, size + 1.0f);
+		for (size_t i = 1; i < count; i++)
+			stroke_index_add_segment(index, id, points[i - 1].x, points[i - 1].y, points[i].x, points[i].y,
+						 size + 1.0f);
+		return;
 	}
 
-	if (pressure > 0.0) {
-		if (ds->tool_mode != TOOL_DOWN) {
-			ds->tool_mode = TOOL_DOWN;
-			if (!draw) {
-				ds->mouse_previous_pos = ds->mouse_pos;
-			}
-		}
-		if (ds->tool == TOOL_SELECT_RECTANGLE || ds->tool == TOOL_SELECT_ELLIPSE) {
-			if (ds->mouse_pos.x > fminf(ds->select_from.x, ds->select_to.x) &&
-			    ds->mouse_pos.x < fmaxf(ds->select_from.x, ds->select_to.x) &&
-			    ds->mouse_pos.y > fminf(ds->select_from.y, ds->select_to.y) &&
-			    ds->mouse_pos.y < fmaxf(ds->select_from.y, ds->select_to.y)) {
-				ds->tool_mode = TOOL_DRAG;
-			}
-		}
-		if (draw) {
-			apply_tool(ds);
-		}
-	} else if (ds->tool_mode == TOOL_DOWN) {
-		if (!draw) {
-			if (ds->tool == TOOL_SELECT_RECTANGLE || ds->tool == TOOL_SELECT_ELLIPSE) {
-				ds->select_from = ds->mouse_previous_pos;
-				ds->select_to = ds->mouse_pos;
-			} else {
-				copy_to_undo(ds);
-				apply_tool(ds);
-			}
-		} else {
-			copy_to_undo(ds);
+	float x0 = points[0].x;
+	float y0 = points[0].y;
+	float x1 = points[1].x;
+	float y1 = points[1].y;
+	if (obs_data_get_bool(stroke, "shift"))
+		vector_constrain(tool, x0, y0, &x1, &y1);
+	if (tool == TOOL_LINE) {
+		stroke_index_add_segment(index, id, x0, y0, x1, y1, size + 1.0f);
+	} else if (tool == TOOL_RECTANGLE_OUTLINE) {
+		stroke_index_add_segment(index, id, x0, y0, x0, y1, size + 1.0f);
+		stroke_index_add_segment(index, id, x0, y1, x1, y1, size + 1.0f);
+		stroke_index_add_segment(index, id, x1, y1, x1, y0, size + 1.0f);
+		stroke_index_add_segment(index, id, x1, y0, x0, y0, size + 1.0f);
+	} else if (tool == TOOL_ELLIPSE_OUTLINE) {
+		float cx = (x0 + x1) / 2.0f;
+		float cy = (y0 + y1) / 2.0f;
+		float rx = fabsf(x1 - x0) / 2.0f;
+		float ry = fabsf(y1 - y0) / 2.0f;
+		float radius = size + 1.0f + fmaxf(rx, ry) * 0.0012f;
+		float px = cx + rx;
+		float py = cy;
+		for (int i = 1; i <= VECTOR_ELLIPSE_SEGMENTS; i++) {
+			float angle = 6.28318531f * (float)i / (float)VECTOR_ELLIPSE_SEGMENTS;
+			float nx = cx + rx * cosf(angle);
+			float ny = cy + ry * sinf(angle);
+			stroke_index_add_segment(index, id, px, py, nx, ny, radius);
+			px = nx;
+			py = ny;
 		}
-		ds->tool_mode = TOOL_UP;
-		ds->tablet_factor = 1.0f;
-	} else if (ds->tool_mode == TOOL_DRAG) {
-		copy_to_undo(ds);
-		apply_tool(ds);
-		ds->select_from.x += ds->mouse_pos.x - ds->mouse_previous_pos.x;
-		ds->select_from.y += ds->mouse_pos.y - ds->mouse_previous_pos.y;
-		ds->select_to.x += ds->mouse_pos.x - ds->mouse_previous_pos.x;
-		ds->select_to.y += ds->mouse_pos.y - ds->mouse_previous_pos.y;
-		ds->tool_mode = TOOL_UP;
+	} else {
+		stroke_index_add_box(index, id, fminf(x0, x1) - 1.0f, fminf(y0, y1) - 1.0f, fmaxf(x0, x1) + 1.0f,
+				     fmaxf(y0, y1) + 1.0f);
 	}
 }
 
-static void *ds_create(obs_data_t *settings, obs_source_t *source)
+/* adds a recorded or ingested stroke to the model, the next part of a pencil or brush line continues its object */
+static void vector_add(struct draw_source *ds, obs_data_t *stroke, const struct stroke_point *points, size_t count)
 {
-	struct draw_source *context = bzalloc(sizeof(struct draw_source));
-	context->source = source;
+	if (!ds->vector || ds->vector_stale || !ds->vector_index || !count)
+		return;
+	uint32_t tool = (uint32_t)obs_data_get_int(stroke, "tool");
+	bool line = tool == TOOL_PENCIL || (tool == TOOL_BRUSH && obs_data_get_int(stroke, "brush_tip") != BRUSH_TIP_IMAGE);
+	bool shape = (tool == TOOL_LINE || (tool >= TOOL_RECTANGLE_OUTLINE && tool <= TOOL_ELLIPSE_FILL)) && count > 1 &&
+		     obs_data_get_int(stroke, "tool_mode") == TOOL_DOWN;
+	if (!line && !shape) {
+		/* fills, stamps, images, image tip brushes and moved selections are only pixels */
+		if (tool != TOOL_NONE)
+			vector_stale(ds);
+		return;
+	}
 
-	context->tablet_factor = 1.0f;
-	context->max_undo = 10;
-	context->size.x = (float)obs_data_get_int(settings, "width");
-	context->size.y = (float)obs_data_get_int(settings, "height");
-	vec4_from_rgba_srgb(&context->cursor_color, 0xFFFFFF00);
-	context->cursor_size = 10;
+	struct vector_object *last = ds->vector_open && ds->vector_objects.num ? da_end(ds->vector_objects) : NULL;
+	if (line && last && !obs_data_get_bool(stroke, "dot") && vector_same_tool(last->stroke, stroke) &&
+	    da_end(last->points)->x == points[0].x && da_end(last->points)->y == points[0].y) {
+		da_push_back_array(last->points, points + 1, count - 1);
+		vector_index_add(ds, (uint32_t)ds->vector_objects.num - 1, stroke, points, count, &last->bounds);
+		return;
+	}
 
-	context->show_mouse = true;
+	struct vector_object *object = da_push_back_new(ds->vector_objects);
+	object->stroke = obs_data_create();
+	obs_data_apply(object->stroke, stroke);
+	obs_data_erase(object->stroke, "points_b64");
+	da_push_back_array(object->points, points, count);
+	vec4_set(&object->bounds, points[0].x, points[0].y, points[0].x, points[0].y);
+	vector_index_add(ds, (uint32_t)ds->vector_objects.num - 1, stroke, points, count, &object->bounds);
+	ds->vector_open = true;
+}
 
-	char *effect_path = obs_module_file("effects/draw.effect");
-	obs_enter_graphics();
-	context->draw_effect = gs_effect_create_from_file(effect_path, NULL);
-	if (context->draw_effect) {
-		context->image_param = gs_effect_get_param_by_name(context->draw_effect, "image");
-		context->uv_size_param = gs_effect_get_param_by_name(context->draw_effect, "uv_size");
-		context->uv_mouse_param = gs_effect_get_param_by_name(context->draw_effect, "uv_mouse");
-		context->uv_mouse_previous_param = gs_effect_get_param_by_name(context->draw_effect, "uv_mouse_previous");
-		context->select_from_param = gs_effect_get_param_by_name(context->draw_effect, "select_from");
-		context->select_to_param = gs_effect_get_param_by_name(context->draw_effect, "select_to");
-		context->draw_cursor_param = gs_effect_get_param_by_name(context->draw_effect, "draw_cursor");
-		context->cursor_color_param = gs_effect_get_param_by_name(context->draw_effect, "cursor_color");
-		context->cursor_size_param = gs_effect_get_param_by_name(context->draw_effect, "cursor_size");
-		context->cursor_image_param = gs_effect_get_param_by_name(context->draw_effect, "cursor_image");
-		context->tool_param = gs_effect_get_param_by_name(context->draw_effect, "tool");
-		context->tool_image_param = gs_effect_get_param_by_name(context->draw_effect, "tool_image");
-		context->tool_color_param = gs_effect_get_param_by_name(context->draw_effect, "tool_color");
-		context->tool_size_param = gs_effect_get_param_by_name(context->draw_effect, "tool_size");
-		context->tool_mode_param = gs_effect_get_param_by_name(context->draw_effect, "tool_mode");
-		context->shift_down_param = gs_effect_get_param_by_name(context->draw_effect, "shift_down");
+static void record_flush(struct draw_source *ds)
+{
+	if (!ds->record_points.num)
+		return;
+
+	struct vec4 color = ds->record_color;
+	color.w = 1.0f;
+	size_t count = stroke_points_simplify(ds->record_points.array, ds->record_points.num, 0.5f);
+	/* a stroke longer than one packed part continues in the next event from the last point of the previous one */
+	for (size_t first = 0; first == 0 || first + 1 < count; first += STROKE_CODEC_MAX_POINTS - 1) {
+		size_t part = count - first > STROKE_CODEC_MAX_POINTS ? STROKE_CODEC_MAX_POINTS : count - first;
+		obs_data_t *stroke = obs_data_create();
+		obs_data_set_string(stroke, "action", "stroke");
+		obs_data_set_int(stroke, "tool", ds->record_tool);
+		obs_data_set_int(stroke, "tool_color", vec4_to_rgba(&color));
+		obs_data_set_double(stroke, "tool_alpha", ds->record_color.w * 100.0f);
+		obs_data_set_double(stroke, "tool_size", ds->record_size);
+		if (ds->record_tool == TOOL_BRUSH) {
+			obs_data_set_int(stroke, "brush_tip", ds->record_brush_tip);
+			obs_data_set_double(stroke, "brush_hardness", ds->record_brush_hardness);
+		}
+		obs_data_set_bool(stroke, "dot", ds->record_dot && !first);
+		/* the model keeps the simplified points mirrors and the journal get, so an erase there hits the same strokes */
+		vector_add(ds, stroke, ds->record_points.array + first, part);
+		char *points_b64 = stroke_points_encode_b64(ds->record_points.array + first, part);
+		obs_data_set_string(stroke, "points_b64", points_b64);
+		if (!ds->events)
+			ds->events = obs_data_array_create();
+		obs_data_array_push_back(ds->events, stroke);
+		obs_data_release(stroke);
+		bfree(points_b64);
 	}
+	ds->record_points.num = 0;
+}
+
+static void stroke_commit(struct draw_source *ds);
+
+static obs_data_t *record_action(struct draw_source *ds, const char *action)
+{
+	if (!recording(ds))
+		return NULL;
+	if (ds->fill_active) {
+		/* a fill still spreading is finished first, so its pixels are recorded before whatever comes after it */
+		obs_enter_graphics();
+		stroke_commit(ds);
+		obs_leave_graphics();
+	}
+	record_flush(ds);
+	ds->journal_passes++;
+	obs_data_t *event = obs_data_create();
+	obs_data_set_string(event, "action", action);
+	if (!ds->events)
+		ds->events = obs_data_array_create();
+	obs_data_array_push_back(ds->events, event);
+	obs_data_release(event);
+	return event;
+}
+
+static void record_tool(struct draw_source *ds)
+{
+	if (!recording(ds))
+		return;
+	if (!draw_on_mouse_move(ds->tool)) {
+		obs_data_t *event = record_action(ds, "stroke");
+		struct stroke_point points[2] = {{ds->mouse_previous_pos.x, ds->mouse_previous_pos.y, 1.0f},
+						 {ds->mouse_pos.x, ds->mouse_pos.y, 1.0f}};
+		char *points_b64 = stroke_points_encode_b64(points, 2);
+		struct vec4 color = ds->tool_color;
+		color.w = 1.0f;
+		obs_data_set_int(event, "tool", ds->tool);
+		obs_data_set_int(event, "tool_color", vec4_to_rgba(&color));
+		obs_data_set_double(event, "tool_alpha", ds->tool_color.w * 100.0f);
+		obs_data_set_double(event, "tool_size", ds->tool_size);
+		obs_data_set_int(event, "tool_mode", ds->tool_mode);
+		obs_data_set_bool(event, "shift", ds->shift_down);
+		if (ds->tool == TOOL_FILL)
+			obs_data_set_double(event, "fill_tolerance", ds->fill_tolerance);
+		if (ds->tool_mode == TOOL_DRAG) {
+			obs_data_set_double(event, "select_from_x", ds->select_from.x);
+			obs_data_set_double(event, "select_from_y", ds->select_from.y);
+			obs_data_set_double(event, "select_to_x", ds->select_to.x);
+			obs_data_set_double(event, "select_to_y", ds->select_to.y);
+		}
+		obs_data_set_string(event, "points_b64", points_b64);
+		bfree(points_b64);
+		vector_add(ds, event, points, 2);
+		return;
+	}
+
+	ds->journal_passes++;
+	bool continues = ds->record_points.num && ds->record_tool == ds->tool && ds->record_size == ds->tool_size &&
+			 ds->record_brush_tip == ds->brush_tip && ds->record_brush_hardness == ds->brush_hardness &&
+			 memcmp(&ds->record_color, &ds->tool_color, sizeof(struct vec4)) == 0 &&
+			 da_end(ds->record_points)->x == ds->mouse_previous_pos.x &&
+			 da_end(ds->record_points)->y == ds->mouse_previous_pos.y;
+	if (!continues) {
+		record_flush(ds);
+		ds->record_tool = ds->tool;
+		ds->record_color = ds->tool_color;
+		ds->record_size = ds->tool_size;
+		ds->record_brush_tip = ds->brush_tip;
+		ds->record_brush_hardness = ds->brush_hardness;
+		ds->record_dot = ds->mouse_previous_pos.x < 0.0f || ds->mouse_previous_pos.y < 0.0f;
+		if (!ds->record_dot) {
+			struct stroke_point *from = da_push_back_new(ds->record_points);
+			from->x = ds->mouse_previous_pos.x;
+			from->y = ds->mouse_previous_pos.y;
+			from->pressure = ds->tablet_factor;
+		}
+	}
+	struct stroke_point *to = da_push_back_new(ds->record_points);
+	to->x = ds->mouse_pos.x;
+	to->y = ds->mouse_pos.y;
+	to->pressure = ds->tablet_factor;
+}
+
+struct journal_task {
+	struct stroke_journal *journal;
+	obs_data_array_t *events;
+	uint64_t generation;
+};
+
+struct journal_checkpoint {
+	char *dir;
+	uint64_t generation;
+};
+
+static void journal_task(void *param)
+{
+	struct journal_task *task = param;
+	if (task->events) {
+		stroke_journal_write(task->journal, task->events);
+		obs_data_array_release(task->events);
+	} else {
+		stroke_journal_rotate(task->journal, task->generation);
+	}
+	bfree(task);
+}
+
+static void journal_queue(struct draw_source *ds, obs_data_array_t *events, uint64_t generation)
+{
+	struct journal_task *task = bzalloc(sizeof(struct journal_task));
+	task->journal = ds->journal;
+	task->events = events;
+	task->generation = generation;
+	os_task_queue_queue_task(ds->journal_tasks, journal_task, task);
+}
+
+static void journal_checkpoint_finished(void *param, bool success)
+{
+	struct journal_checkpoint *checkpoint = param;
+	if (success)
+		stroke_journal_remove_before(checkpoint->dir, checkpoint->generation);
+	bfree(checkpoint->dir);
+	bfree(checkpoint);
+}
+
+static struct draw_snapshot *snapshot_create(const char *path, bool qoi, bool wait);
+static void snapshot_stage(struct draw_source *ds, struct draw_snapshot *snapshot);
+static void snapshot_queue(struct draw_source *ds, struct draw_snapshot *snapshot);
+static void snapshot_finish(struct draw_snapshot *snapshot, bool success);
+static void snapshot_stage_texture(struct draw_snapshot *snapshot, gs_texture_t *tex);
+static void snapshot_read(struct draw_source *ds, struct draw_snapshot *snapshot);
+
+struct record_patch {
+	struct draw_source *ds;
+	obs_data_t *event;
+	struct draw_snapshot *snapshot;
+};
+
+static void record_patch_finished(void *param, bool success)
+{
+	struct record_patch *patch = param;
+	if (success && patch->snapshot->image_b64)
+		obs_data_set_string(patch->event, "image_b64", patch->snapshot->image_b64);
+	else
+		blog(LOG_WARNING, "[Draw] failed to read back a recorded rect, mirrors miss it");
+	obs_data_release(patch->event);
+	os_atomic_dec_long(&patch->ds->patches_pending);
+	bfree(patch);
+}
+
+/* records action with the pixels rect of the canvas holds now as "image_b64" at "x", "y", for what mirrors and the
+ * journal can not replay the same way, read back through the snapshot pipeline, called with the graphics lock held */
+static void record_patch(struct draw_source *ds, const char *action, const struct vec4 *rect)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	uint32_t cx = (uint32_t)rect->z;
+	uint32_t cy = (uint32_t)rect->w;
+	if (!recording(ds) || !tex || !cx || !cy)
+		return;
+	if (!ds->patch_layer)
+		ds->patch_layer = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	gs_texrender_reset(ds->patch_layer);
+	if (!gs_texrender_begin(ds->patch_layer, cx, cy))
+		return;
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), tex);
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite_subregion(tex, 0, (uint32_t)rect->x, (uint32_t)rect->y, cx, cy);
+	gs_blend_state_pop();
+	gs_texrender_end(ds->patch_layer);
+
+	obs_data_t *event = record_action(ds, action);
+	obs_data_set_int(event, "x", (long long)rect->x);
+	obs_data_set_int(event, "y", (long long)rect->y);
+	struct record_patch *patch = bzalloc(sizeof(struct record_patch));
+	patch->ds = ds;
+	patch->event = event;
+	obs_data_addref(event);
+	/* without a path or keep the encoder leaves the image base64 encoded */
+	struct draw_snapshot *snapshot = snapshot_create(NULL, true, false);
+	patch->snapshot = snapshot;
+	snapshot->finished = record_patch_finished;
+	snapshot->finished_param = patch;
+	os_atomic_inc_long(&ds->patches_pending);
+	snapshot_stage_texture(snapshot, gs_texrender_get_texture(ds->patch_layer));
+	if (snapshot->stagesurf)
+		da_push_back(ds->patches, &snapshot);
+	else
+		snapshot_finish(snapshot, false);
+}
+
+/* hands staged patches to the snapshot pipeline, kept apart until now as they are recorded while it holds its mutex */
+static void patches_queue(struct draw_source *ds)
+{
+	if (!os_atomic_load_long(&ds->patches_pending))
+		return;
+	obs_enter_graphics();
+	for (size_t i = 0; i < ds->patches.num; i++)
+		snapshot_queue(ds, ds->patches.array[i]);
+	ds->patches.num = 0;
+	obs_leave_graphics();
+}
+
+/* reads every pending patch back right away and waits for it, so the events held for them can still be taken */
+static void patches_flush(struct draw_source *ds)
+{
+	if (!os_atomic_load_long(&ds->patches_pending))
+		return;
+	patches_queue(ds);
+	obs_enter_graphics();
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	for (size_t i = 0; i < ds->snapshots.num; i++) {
+		struct draw_snapshot *snapshot = ds->snapshots.array[i];
+		if (snapshot->finished != record_patch_finished)
+			continue;
+		da_erase(ds->snapshots, i--);
+		snapshot_read(ds, snapshot);
+	}
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	obs_leave_graphics();
+	os_task_queue_wait(ds->snapshot_tasks);
+}
+
+/* starts a new journal generation from a raster checkpoint of the canvas, called with the graphics lock held */
+static void journal_compact(struct draw_source *ds)
+{
+	ds->journal_generation++;
+	ds->journal_passes = 0;
+	ds->journal_checkpoint_due = false;
+	journal_queue(ds, NULL, ds->journal_generation);
+
+	char *path = stroke_journal_checkpoint_path(ds->journal_dir, ds->journal_generation);
+	struct draw_snapshot *snapshot = snapshot_create(path, true, false);
+	bfree(path);
+	struct journal_checkpoint *checkpoint = bzalloc(sizeof(struct journal_checkpoint));
+	checkpoint->dir = bstrdup(ds->journal_dir);
+	checkpoint->generation = ds->journal_generation;
+	snapshot->finished = journal_checkpoint_finished;
+	snapshot->finished_param = checkpoint;
+	snapshot_stage(ds, snapshot);
+	snapshot_queue(ds, snapshot);
+}
+
+/* opens the log of the current generation right away so strokes before the first checkpoint are kept too */
+static void journal_start(struct draw_source *ds)
+{
+	struct stroke_journal *journal = stroke_journal_create(ds->journal_dir);
+	stroke_journal_rotate(journal, ds->journal_generation);
+	os_task_queue_t *tasks = os_task_queue_create();
+	obs_enter_graphics();
+	ds->journal = journal;
+	ds->journal_tasks = tasks;
+	ds->journal_checkpoint_due = true;
+	obs_leave_graphics();
+}
+
+static void journal_stop(struct draw_source *ds, bool remove)
+{
+	obs_enter_graphics();
+	struct stroke_journal *journal = ds->journal;
+	os_task_queue_t *tasks = ds->journal_tasks;
+	ds->journal = NULL;
+	ds->journal_tasks = NULL;
+	obs_leave_graphics();
+	if (!journal)
+		return;
+	os_task_queue_destroy(tasks);
+	stroke_journal_destroy(journal);
+	if (!remove)
+		return;
+
+	/* a checkpoint still on its way would write into the directory after it was cleared, queued ones are
+	 * dropped and the ones already encoding are waited for */
+	obs_enter_graphics();
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	for (size_t i = 0; i < ds->snapshots.num; i++) {
+		struct draw_snapshot *snapshot = ds->snapshots.array[i];
+		if (snapshot->finished != journal_checkpoint_finished)
+			continue;
+		da_erase(ds->snapshots, i--);
+		gs_stagesurface_destroy(snapshot->stagesurf);
+		snapshot->stagesurf = NULL;
+		snapshot_finish(snapshot, false);
+	}
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	obs_leave_graphics();
+	os_task_queue_wait(ds->snapshot_tasks);
+	stroke_journal_remove_before(ds->journal_dir, UINT64_MAX);
+}
+
+/* finishes the recorded events of this frame and hands them to the journal, returns them for broadcasting */
+static obs_data_array_t *take_events(struct draw_source *ds)
+{
+	if (os_atomic_load_long(&ds->patches_pending))
+		return NULL;
+	bool checkpoint = ds->journal && ds->journal_checkpoint_due && !ds->canvas_loading;
+	if (!ds->events && !ds->record_points.num && !checkpoint)
+		return NULL;
+
+	obs_enter_graphics();
+	record_flush(ds);
+	obs_data_array_t *events = ds->events;
+	ds->events = NULL;
+	if (ds->journal && events) {
+		obs_data_array_addref(events);
+		journal_queue(ds, events, 0);
+	}
+	if (ds->journal && (checkpoint || ds->journal_passes >= JOURNAL_COMPACT_PASSES))
+		journal_compact(ds);
+	obs_leave_graphics();
+	return events;
+}
+
+static void emit_events(struct draw_source *ds)
+{
+	obs_data_array_t *events = take_events(ds);
+	if (!events)
+		return;
+	if (draw_vendor_available()) {
+		obs_data_t *event_data = obs_data_create();
+		obs_data_set_string(event_data, "source", obs_source_get_name(ds->source));
+		obs_data_set_array(event_data, "strokes", events);
+		draw_vendor_emit_event("strokes", event_data);
+		obs_data_release(event_data);
+	}
+	obs_data_array_release(events);
+}
+
+/* the draw source whose canvas a reference shares, NULL when it is missing or references a canvas itself so there is no cycle */
+static obs_source_t *shared_owner(struct draw_source *ds)
+{
+	pthread_mutex_lock(&ds->shared_mutex);
+	obs_source_t *owner = obs_weak_source_get_source(ds->shared_canvas);
+	uint64_t now = os_gettime_ns();
+	if (!owner && ds->shared_name && now - ds->shared_resolved >= SHARED_RESOLVE_INTERVAL) {
+		ds->shared_resolved = now;
+		owner = obs_get_source_by_name(ds->shared_name);
+		if (owner && (owner == ds->source || strcmp(obs_source_get_unversioned_id(owner), "draw_source") != 0)) {
+			obs_source_release(owner);
+			owner = NULL;
+		}
+		obs_weak_source_release(ds->shared_canvas);
+		ds->shared_canvas = owner ? obs_source_get_weak_source(owner) : NULL;
+	}
+	pthread_mutex_unlock(&ds->shared_mutex);
+	if (owner) {
+		struct draw_source *owner_ds = obs_obj_get_data(owner);
+		if (!owner_ds || owner_ds->shared) {
+			obs_source_release(owner);
+			owner = NULL;
+		}
+	}
+	return owner;
+}
+
+static void shared_set(struct draw_source *ds, const char *name)
+{
+	if (name && !*name)
+		name = NULL;
+	pthread_mutex_lock(&ds->shared_mutex);
+	if (name ? !ds->shared_name || strcmp(name, ds->shared_name) != 0 : ds->shared_name != NULL) {
+		bfree(ds->shared_name);
+		ds->shared_name = name ? bstrdup(name) : NULL;
+		obs_weak_source_release(ds->shared_canvas);
+		ds->shared_canvas = NULL;
+		ds->shared_resolved = 0;
+	}
+	ds->shared = ds->shared_name != NULL;
+	pthread_mutex_unlock(&ds->shared_mutex);
+}
+
+/* maps a position on the reference into the shared canvas, the inverse of the transform shared_render draws with */
+static void shared_map(struct draw_source *ds, int32_t x, int32_t y, int32_t *out_x, int32_t *out_y)
+{
+	float px = (float)x - ds->shared_offset.x;
+	float py = (float)y - ds->shared_offset.y;
+	float c = cosf(ds->shared_rotation);
+	float s = sinf(ds->shared_rotation);
+	float scale = ds->shared_scale > 0.0f ? ds->shared_scale : 1.0f;
+	*out_x = (int32_t)floorf((px * c + py * s) / scale);
+	*out_y = (int32_t)floorf((py * c - px * s) / scale);
+}
+
+/* returns the owner to hand a pointer event to with the position mapped into mapped, NULL when the owner is missing */
+static obs_source_t *shared_input(struct draw_source *ds, const struct obs_mouse_event *event, struct obs_mouse_event *mapped)
+{
+	*mapped = *event;
+	shared_map(ds, event->x, event->y, &mapped->x, &mapped->y);
+	return shared_owner(ds);
+}
+
+/* calls a proc on the owner instead of a reference, false when the source is not a reference and handles it itself */
+static bool shared_forward(struct draw_source *ds, const char *proc, calldata_t *cd)
+{
+	if (!ds->shared)
+		return false;
+	obs_source_t *owner = shared_owner(ds);
+	if (owner) {
+		calldata_t empty = {0};
+		proc_handler_call(obs_source_get_proc_handler(owner), proc, cd ? cd : &empty);
+		calldata_free(&empty);
+		obs_source_release(owner);
+	}
+	return true;
+}
+
+static void dab_flush(struct draw_source *ds);
+static void stroke_commit(struct draw_source *ds);
+static void canvas_acquire(struct draw_source *ds);
+
+/* copies rect of a canvas sized texture into the same rect of target, a texrender begun again at the same size keeps
+ * its texture so the rest of target stays as it was, called with the graphics lock held */
+static void vector_copy_rect(struct draw_source *ds, gs_texrender_t *target, gs_texture_t *tex, const struct vec4 *rect)
+{
+	gs_texrender_reset(target);
+	if (!gs_texrender_begin(target, (uint32_t)ds->size.x, (uint32_t)ds->size.y))
+		return;
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
+	gs_matrix_push();
+	gs_matrix_translate3f(rect->x, rect->y, 0.0f);
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), tex);
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite_subregion(tex, 0, (uint32_t)rect->x, (uint32_t)rect->y, (uint32_t)rect->z, (uint32_t)rect->w);
+	gs_matrix_pop();
+	gs_blend_state_pop();
+	gs_texrender_end(target);
+}
+
+/* copies a texture into target as it is, called with the graphics lock held */
+static void vector_copy(struct draw_source *ds, gs_texrender_t *target, gs_texture_t *tex)
+{
+	struct vec4 rect;
+	vec4_set(&rect, 0.0f, 0.0f, ds->size.x, ds->size.y);
+	vector_copy_rect(ds, target, tex, &rect);
+}
+
+/* every undo step starts a new object, a stale model first takes the canvas as its new base and starts over */
+static void vector_checkpoint(struct draw_source *ds)
+{
+	if (!ds->vector)
+		return;
+	ds->vector_open = false;
+	if (!ds->vector_stale && ds->vector_base)
+		return;
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (!tex)
+		return;
+	if (!ds->vector_base)
+		ds->vector_base = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	vector_copy(ds, ds->vector_base, tex);
+	vector_clear_objects(ds);
+	ds->vector_index = stroke_index_create((uint32_t)ds->size.x, (uint32_t)ds->size.y);
+	ds->vector_stale = false;
+}
+
+static void push_undo(struct draw_source *ds)
+{
+	obs_enter_graphics();
+	canvas_acquire(ds);
+	dab_flush(ds);
+	stroke_commit(ds);
+	vector_checkpoint(ds);
+	while (ds->redo.size) {
+		gs_texrender_t *old;
+		deque_pop_front(&ds->redo, &old, sizeof(old));
+		gs_texrender_destroy(old);
+	}
+	/* the canvas is copied as it is, drawing it through the Draw technique would leave out a lifted selection
+	 * or a previewed shape */
+	gs_texrender_t *texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (tex) {
+		vector_copy(ds, texrender, tex);
+	} else if (gs_texrender_begin(texrender, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
+		struct vec4 clear_color;
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_texrender_end(texrender);
+	}
+	if (gs_texrender_get_texture(texrender)) {
+		deque_push_back(&ds->undo, &texrender, sizeof(texrender));
+		if (ds->undo.size > sizeof(texrender) * ds->max_undo) {
+			deque_pop_front(&ds->undo, &texrender, sizeof(texrender));
+			gs_texrender_destroy(texrender);
+		}
+	} else {
+		gs_texrender_destroy(texrender);
+	}
+	obs_leave_graphics();
+}
+
+static void copy_to_undo(struct draw_source *ds)
+{
+	obs_enter_graphics();
+	record_action(ds, "checkpoint");
+	push_undo(ds);
+	obs_leave_graphics();
+}
+
+void draw_clear(struct draw_source *ds)
+{
+	if (shared_forward(ds, "clear", NULL))
+		return;
+	obs_enter_graphics();
+	record_action(ds, "clear");
+	push_undo(ds);
+	gs_texrender_reset(ds->render_a_active ? ds->render_b : ds->render_a);
+	if (gs_texrender_begin(ds->render_a_active ? ds->render_b : ds->render_a, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
+		struct vec4 clear_color;
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_texrender_end(ds->render_a_active ? ds->render_b : ds->render_a);
+		ds->render_a_active = !ds->render_a_active;
+		os_atomic_inc_long(&ds->canvas_version);
+	}
+	vector_stale(ds);
+	obs_leave_graphics();
+}
+
+void clear_proc_handler(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct draw_source *context = data;
+	draw_clear(context);
+}
+
+static gs_texrender_t *layer_create(struct draw_source *ds)
+{
+	gs_texrender_t *texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	if (gs_texrender_begin(texrender, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
+		struct vec4 clear_color;
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_texrender_end(texrender);
+	}
+	return texrender;
+}
+
+static void undo_clear(struct draw_source *ds)
+{
+	while (ds->undo.size) {
+		gs_texrender_t *texrender;
+		deque_pop_front(&ds->undo, &texrender, sizeof(texrender));
+		gs_texrender_destroy(texrender);
+	}
+	while (ds->redo.size) {
+		gs_texrender_t *texrender;
+		deque_pop_front(&ds->redo, &texrender, sizeof(texrender));
+		gs_texrender_destroy(texrender);
+	}
+}
+
+/* makes another layer current by swapping texrenders, the undo history only covers the current layer so it is dropped */
+static void layer_select(struct draw_source *ds, uint32_t layer)
+{
+	if (layer >= LAYER_MAX || layer == ds->layer_current)
+		return;
+	canvas_acquire(ds);
+	dab_flush(ds);
+	stroke_commit(ds);
+	obs_data_t *event = record_action(ds, "layer");
+	if (event)
+		obs_data_set_int(event, "layer", layer + 1);
+	undo_clear(ds);
+
+	gs_texrender_t *spare = ds->render_a_active ? ds->render_b : ds->render_a;
+	ds->layers[ds->layer_current].render = ds->render_a_active ? ds->render_a : ds->render_b;
+	ds->layers[ds->layer_current].unsaved = true;
+	gs_texrender_t *next = ds->layers[layer].render;
+	ds->layers[layer].render = NULL;
+	ds->render_a = next ? next : layer_create(ds);
+	ds->render_b = spare;
+	ds->render_a_active = true;
+	ds->layer_current = layer;
+	ds->layers_dirty = true;
+	ds->journal_checkpoint_due = true;
+	vector_stale(ds);
+	os_atomic_inc_long(&ds->canvas_version);
+}
+
+/* clears a layer that is not current, the current layer is cleared with draw_clear so it can be undone */
+static void layer_clear(struct draw_source *ds, uint32_t layer)
+{
+	if (layer >= ds->layer_count)
+		return;
+	if (layer == ds->layer_current) {
+		draw_clear(ds);
+		return;
+	}
+	obs_enter_graphics();
+	canvas_acquire(ds);
+	obs_data_t *event = record_action(ds, "clear_layer");
+	if (event)
+		obs_data_set_int(event, "layer", layer + 1);
+	if (ds->layers[layer].render) {
+		gs_texrender_destroy(ds->layers[layer].render);
+		ds->layers[layer].render = NULL;
+		ds->layers[layer].unsaved = true;
+		ds->layers_dirty = true;
+		os_atomic_inc_long(&ds->canvas_version);
+	}
+	obs_leave_graphics();
+}
+
+void clear_layer_proc_handler(void *data, calldata_t *cd)
+{
+	struct draw_source *ds = data;
+	if (shared_forward(ds, "clear_layer", cd))
+		return;
+	long long layer = calldata_int(cd, "layer");
+	if (layer >= 1)
+		layer_clear(ds, (uint32_t)(layer - 1));
+}
+
+/* draws the visible layers of [from, to) premultiplied into texrender, returns false when none of them shows anything */
+static bool layers_flatten_range(struct draw_source *ds, gs_texrender_t *texrender, uint32_t from, uint32_t to)
+{
+	bool used = false;
+	for (uint32_t i = from; i < to; i++)
+		used = used || (ds->layers[i].visible && ds->layers[i].opacity > 0.0f && ds->layers[i].render);
+	if (!used)
+		return false;
+	gs_texrender_reset(texrender);
+	if (!gs_texrender_begin(texrender, (uint32_t)ds->size.x, (uint32_t)ds->size.y))
+		return false;
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+	gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
+	for (uint32_t i = from; i < to; i++) {
+		struct draw_layer *layer = &ds->layers[i];
+		gs_texture_t *tex = layer->render ? gs_texrender_get_texture(layer->render) : NULL;
+		if (!layer->visible || layer->opacity <= 0.0f || !tex)
+			continue;
+		gs_effect_set_texture(ds->shader->image_param, tex);
+		gs_effect_set_float(ds->shader->layer_opacity_param, layer->opacity);
+		while (gs_effect_loop(ds->shader->effect, "Layer"))
+			gs_draw_sprite(tex, 0, (uint32_t)ds->size.x, (uint32_t)ds->size.y);
+	}
+	gs_blend_state_pop();
+	gs_texrender_end(texrender);
+	return true;
+}
+
+/* rebuilds the flattened layers below and above the current one, called with the graphics lock held */
+static void layers_rebuild(struct draw_source *ds)
+{
+	ds->layers_dirty = false;
+	if (!ds->layers_below)
+		ds->layers_below = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	if (!ds->layers_above)
+		ds->layers_above = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	ds->layers_below_used = layers_flatten_range(ds, ds->layers_below, 0, ds->layer_current);
+	ds->layers_above_used = layers_flatten_range(ds, ds->layers_above, ds->layer_current + 1, ds->layer_count);
+}
+
+static void layers_draw_premultiplied(gs_texture_t *tex, const char *technique, uint32_t cx, uint32_t cy)
+{
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), tex);
+	while (gs_effect_loop(effect, technique))
+		gs_draw_sprite(tex, 0, cx, cy);
+}
+
+/* all visible layers flattened premultiplied, for snapshots of a canvas with more than one layer */
+static gs_texture_t *layers_flatten(struct draw_source *ds)
+{
+	if (ds->layers_dirty)
+		layers_rebuild(ds);
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (!ds->layers_flat)
+		ds->layers_flat = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	gs_texrender_reset(ds->layers_flat);
+	if (!gs_texrender_begin(ds->layers_flat, (uint32_t)ds->size.x, (uint32_t)ds->size.y))
+		return NULL;
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+	gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
+	if (ds->layers_below_used)
+		layers_draw_premultiplied(gs_texrender_get_texture(ds->layers_below), "Draw", (uint32_t)ds->size.x,
+					  (uint32_t)ds->size.y);
+	struct draw_layer *current = &ds->layers[ds->layer_current];
+	if (tex && current->visible) {
+		gs_effect_set_texture(ds->shader->image_param, tex);
+		gs_effect_set_float(ds->shader->layer_opacity_param, current->opacity);
+		while (gs_effect_loop(ds->shader->effect, "Layer"))
+			gs_draw_sprite(tex, 0, (uint32_t)ds->size.x, (uint32_t)ds->size.y);
+	}
+	if (ds->layers_above_used)
+		layers_draw_premultiplied(gs_texrender_get_texture(ds->layers_above), "Draw", (uint32_t)ds->size.x,
+					  (uint32_t)ds->size.y);
+	gs_blend_state_pop();
+	gs_texrender_end(ds->layers_flat);
+	return gs_texrender_get_texture(ds->layers_flat);
+}
+
+static void apply_tool(struct draw_source *ds);
+static void float_begin(struct draw_source *ds);
+static void float_render(struct draw_source *ds);
+
+static void draw_points_b64(struct draw_source *ds, const char *points_b64)
+{
+	struct stroke_point *points;
+	size_t count = stroke_points_decode_b64(points_b64, &points);
+	if (!count) {
+		blog(LOG_WARNING, "[Draw] invalid points_b64 in draw request");
+		return;
+	}
+
+	bool pressure = draw_on_mouse_move(ds->tool);
+	if (pressure) {
+		ds->mouse_previous_pos.x = -1.0f;
+		ds->mouse_previous_pos.y = -1.0f;
+	}
+	ds->tool_mode = TOOL_DOWN;
+	obs_enter_graphics();
+	for (size_t i = 0; i < count; i++) {
+		ds->mouse_pos.x = points[i].x;
+		ds->mouse_pos.y = points[i].y;
+		if (pressure) {
+			ds->tablet_factor = points[i].pressure;
+			apply_tool(ds);
+			ds->mouse_previous_pos = ds->mouse_pos;
+		} else if (i == 0) {
+			ds->mouse_previous_pos = ds->mouse_pos;
+		}
+	}
+	if (!pressure && count > 1)
+		apply_tool(ds);
+	stroke_commit(ds);
+	obs_leave_graphics();
+	ds->tool_mode = TOOL_UP;
+	ds->tablet_factor = 1.0f;
+	ds->mouse_previous_pos = ds->mouse_pos;
+	bfree(points);
+}
+
+void draw_proc_handler(void *param, calldata_t *cd)
+{
+	struct draw_source *context = param;
+	if (shared_forward(context, "draw", cd))
+		return;
+	obs_data_t *data = calldata_ptr(cd, "data");
+
+	if (obs_data_has_user_value(data, "tool"))
+		context->tool = (uint32_t)obs_data_get_int(data, "tool");
+	if (obs_data_has_user_value(data, "from_x"))
+		context->mouse_previous_pos.x = (float)obs_data_get_double(data, "from_x");
+	if (obs_data_has_user_value(data, "from_y"))
+		context->mouse_previous_pos.y = (float)obs_data_get_double(data, "from_y");
+	if (obs_data_has_user_value(data, "to_x"))
+		context->mouse_pos.x = (float)obs_data_get_double(data, "to_x");
+	if (obs_data_has_user_value(data, "to_y"))
+		context->mouse_pos.y = (float)obs_data_get_double(data, "to_y");
+	if (obs_data_has_user_value(data, "tool_color")) {
+		vec4_from_rgba(&context->tool_color, (uint32_t)obs_data_get_int(data, "tool_color"));
+		if (context->tool_color.w == 0.0f)
+			context->tool_color.w = 1.0f;
+	}
+	if (obs_data_has_user_value(data, "tool_alpha"))
+		context->tool_color.w = (float)obs_data_get_double(data, "tool_alpha") / 100.0f;
+	if (obs_data_has_user_value(data, "tool_size"))
+		context->tool_size = (float)obs_data_get_double(data, "tool_size");
+
+	const char *points_b64 = obs_data_get_string(data, "points_b64");
+	if (points_b64 && *points_b64) {
+		draw_points_b64(context, points_b64);
+		return;
+	}
+
+	context->tool_mode = TOOL_DOWN;
+	apply_tool(context);
+	context->tool_mode = TOOL_UP;
+	context->mouse_previous_pos = context->mouse_pos;
+}
+
+static void stroke_response(struct draw_source *ds, obs_data_t *response, bool success)
+{
+	if (!response)
+		return;
+	obs_data_set_bool(response, "success", success);
+	obs_data_set_int(response, "session", ds->stroke_session);
+	obs_data_set_int(response, "seq", ds->stroke_seq);
+	obs_data_set_int(response, "queue_depth", (long long)ds->stroke_queue.num);
+	obs_data_set_int(response, "queue_capacity", STROKE_QUEUE_CAPACITY);
+	obs_data_set_int(response, "decimated", (long long)ds->stroke_decimated);
+}
+
+void begin_stroke_proc_handler(void *param, calldata_t *cd)
+{
+	struct draw_source *ds = param;
+	if (shared_forward(ds, "begin_stroke", cd))
+		return;
+	obs_data_t *data = calldata_ptr(cd, "data");
+	obs_data_t *response = calldata_ptr(cd, "response");
+
+	pthread_mutex_lock(&ds->stroke_mutex);
+	if (ds->stroke_active || ds->stroke_queue.num) {
+		if (response)
+			obs_data_set_string(response, "error", "previous stroke still active");
+		stroke_response(ds, response, false);
+		pthread_mutex_unlock(&ds->stroke_mutex);
+		return;
+	}
+	ds->stroke_tool = ds->tool;
+	ds->stroke_tool_color = ds->tool_color;
+	ds->stroke_tool_size = ds->tool_size;
+	if (data) {
+		if (obs_data_has_user_value(data, "tool"))
+			ds->stroke_tool = (uint32_t)obs_data_get_int(data, "tool");
+		if (obs_data_has_user_value(data, "tool_color")) {
+			vec4_from_rgba(&ds->stroke_tool_color, (uint32_t)obs_data_get_int(data, "tool_color"));
+			if (ds->stroke_tool_color.w == 0.0f)
+				ds->stroke_tool_color.w = 1.0f;
+		}
+		if (obs_data_has_user_value(data, "tool_alpha"))
+			ds->stroke_tool_color.w = (float)obs_data_get_double(data, "tool_alpha") / 100.0f;
+		if (obs_data_has_user_value(data, "tool_size"))
+			ds->stroke_tool_size = (float)obs_data_get_double(data, "tool_size");
+	}
+	ds->stroke_session++;
+	ds->stroke_seq = 0;
+	ds->stroke_decimated = 0;
+	ds->stroke_active = true;
+	ds->stroke_ending = false;
+	ds->stroke_touched = os_gettime_ns();
+	stroke_response(ds, response, true);
+	pthread_mutex_unlock(&ds->stroke_mutex);
+}
+
+static size_t stroke_decimate(struct stroke_point *points, size_t num)
+{
+	/* keep the first and last point and every second point in between, so the stroke keeps its shape */
+	if (num < 3)
+		return num;
+	size_t kept = 1;
+	for (size_t i = 2; i < num - 1; i += 2) {
+		if (points[i - 1].pressure > points[i].pressure)
+			points[i].pressure = points[i - 1].pressure;
+		points[kept++] = points[i];
+	}
+	points[kept++] = points[num - 1];
+	return kept;
+}
+
+void append_stroke_proc_handler(void *param, calldata_t *cd)
+{
+	struct draw_source *ds = param;
+	if (shared_forward(ds, "append_stroke", cd))
+		return;
+	obs_data_t *data = calldata_ptr(cd, "data");
+	obs_data_t *response = calldata_ptr(cd, "response");
+	if (!data)
+		return;
+
+	struct stroke_point *points = NULL;
+	size_t count = 0;
+	struct stroke_point point;
+	const char *points_b64 = obs_data_get_string(data, "points_b64");
+	if (points_b64 && *points_b64) {
+		count = stroke_points_decode_b64(points_b64, &points);
+	} else if (obs_data_has_user_value(data, "x") && obs_data_has_user_value(data, "y")) {
+		point.x = (float)obs_data_get_double(data, "x");
+		point.y = (float)obs_data_get_double(data, "y");
+		point.pressure = obs_data_has_user_value(data, "pressure") ? (float)obs_data_get_double(data, "pressure") : 1.0f;
+		points = &point;
+		count = 1;
+	}
+
+	pthread_mutex_lock(&ds->stroke_mutex);
+	uint32_t session = (uint32_t)obs_data_get_int(data, "session");
+	uint32_t seq = (uint32_t)obs_data_get_int(data, "seq");
+	if (!ds->stroke_active || ds->stroke_ending || session != ds->stroke_session) {
+		if (response)
+			obs_data_set_string(response, "error", "'session' not active");
+		stroke_response(ds, response, false);
+	} else if (!count) {
+		if (response)
+			obs_data_set_string(response, "error", "no valid points");
+		stroke_response(ds, response, false);
+	} else if (seq < ds->stroke_seq) {
+		if (response)
+			obs_data_set_bool(response, "duplicate", true);
+		stroke_response(ds, response, true);
+	} else {
+		if (response && seq > ds->stroke_seq)
+			obs_data_set_int(response, "missing", seq - ds->stroke_seq);
+		ds->stroke_seq = seq + 1;
+		ds->stroke_touched = os_gettime_ns();
+		/* thin out whichever of the queue and the batch is longer until both fit, once both are down to their
+		 * end points they always do */
+		size_t before = ds->stroke_queue.num + count;
+		while (ds->stroke_queue.num + count > STROKE_QUEUE_CAPACITY) {
+			if (ds->stroke_queue.num >= count)
+				ds->stroke_queue.num = stroke_decimate(ds->stroke_queue.array, ds->stroke_queue.num);
+			else
+				count = stroke_decimate(points, count);
+		}
+		ds->stroke_decimated += before - ds->stroke_queue.num - count;
+		da_push_back_array(ds->stroke_queue, points, count);
+		stroke_response(ds, response, true);
+	}
+	pthread_mutex_unlock(&ds->stroke_mutex);
+
+	if (points != &point)
+		bfree(points);
+}
+
+void end_stroke_proc_handler(void *param, calldata_t *cd)
+{
+	struct draw_source *ds = param;
+	if (shared_forward(ds, "end_stroke", cd))
+		return;
+	obs_data_t *data = calldata_ptr(cd, "data");
+	obs_data_t *response = calldata_ptr(cd, "response");
+
+	pthread_mutex_lock(&ds->stroke_mutex);
+	uint32_t session = data ? (uint32_t)obs_data_get_int(data, "session") : 0;
+	if (!ds->stroke_active || session != ds->stroke_session) {
+		if (response)
+			obs_data_set_string(response, "error", "'session' not active");
+		stroke_response(ds, response, false);
+	} else {
+		ds->stroke_ending = true;
+		stroke_response(ds, response, true);
+	}
+	pthread_mutex_unlock(&ds->stroke_mutex);
+}
+
+static void stroke_queue_drain(struct draw_source *ds)
+{
+	struct stroke_point points[STROKE_POINTS_PER_TICK];
+
+	pthread_mutex_lock(&ds->stroke_mutex);
+	size_t count = ds->stroke_queue.num;
+	if (count > STROKE_POINTS_PER_TICK)
+		count = STROKE_POINTS_PER_TICK;
+	if (count) {
+		memcpy(points, ds->stroke_queue.array, count * sizeof(struct stroke_point));
+		da_erase_range(ds->stroke_queue, 0, count);
+	}
+	if (ds->stroke_active && !ds->stroke_ending && os_gettime_ns() - ds->stroke_touched > STROKE_SESSION_TIMEOUT)
+		ds->stroke_ending = true;
+	bool finish = ds->stroke_active && ds->stroke_ending && !ds->stroke_queue.num;
+	pthread_mutex_unlock(&ds->stroke_mutex);
+
+	if (!count && !finish)
+		return;
+
+	/* the input state is borrowed for the replay under the graphics lock, input handlers only touch it under that lock */
+	obs_enter_graphics();
+	uint32_t tool = ds->tool;
+	struct vec4 tool_color = ds->tool_color;
+	float tool_size = ds->tool_size;
+	uint32_t tool_mode = ds->tool_mode;
+	float tablet_factor = ds->tablet_factor;
+	struct vec2 mouse_pos = ds->mouse_pos;
+	struct vec2 mouse_previous_pos = ds->mouse_previous_pos;
+
+	ds->tool = ds->stroke_tool;
+	ds->tool_color = ds->stroke_tool_color;
+	ds->tool_size = ds->stroke_tool_size;
+	ds->tool_mode = TOOL_DOWN;
+	bool draw = draw_on_mouse_move(ds->tool);
+	for (size_t i = 0; i < count; i++) {
+		struct vec2 pos = {points[i].x, points[i].y};
+		if (!ds->stroke_drawing) {
+			copy_to_undo(ds);
+			ds->stroke_drawing = true;
+			ds->stroke_first_pos = pos;
+			vec2_set(&ds->stroke_previous_pos, -1.0f, -1.0f);
+		}
+		if (draw) {
+			ds->mouse_previous_pos = ds->stroke_previous_pos;
+			ds->mouse_pos = pos;
+			ds->tablet_factor = points[i].pressure;
+			apply_tool(ds);
+		}
+		ds->stroke_previous_pos = pos;
+	}
+	if (finish && ds->stroke_drawing) {
+		stroke_commit(ds);
+		if (!draw) {
+			ds->mouse_previous_pos = ds->stroke_first_pos;
+			ds->mouse_pos = ds->stroke_previous_pos;
+			ds->tablet_factor = 1.0f;
+			apply_tool(ds);
+		}
+		ds->stroke_drawing = false;
+	}
+
+	ds->tool = tool;
+	ds->tool_color = tool_color;
+	ds->tool_size = tool_size;
+	ds->tool_mode = tool_mode;
+	ds->tablet_factor = tablet_factor;
+	ds->mouse_pos = mouse_pos;
+	ds->mouse_previous_pos = mouse_previous_pos;
+	obs_leave_graphics();
+
+	if (finish) {
+		pthread_mutex_lock(&ds->stroke_mutex);
+		if (!ds->stroke_queue.num) {
+			ds->stroke_active = false;
+			ds->stroke_ending = false;
+		}
+		pthread_mutex_unlock(&ds->stroke_mutex);
+	}
+}
+
+void undo(struct draw_source *ds)
+{
+	/* the video tick packs or clears the history and parks the canvas under the graphics lock, so the history is
+	 * checked and swapped without letting go of it */
+	obs_enter_graphics();
+	canvas_acquire(ds);
+	if (!ds->undo.size) {
+		obs_leave_graphics();
+		return;
+	}
+	dab_flush(ds);
+	stroke_commit(ds);
+	record_action(ds, "undo");
+
+	gs_texrender_t *texrender;
+	deque_pop_back(&ds->undo, &texrender, sizeof(texrender));
+
+	if (ds->render_a_active) {
+		gs_texrender_t *old = ds->render_a;
+		ds->render_a = texrender;
+		deque_push_back(&ds->redo, &old, sizeof(old));
+	} else {
+		gs_texrender_t *old = ds->render_b;
+		ds->render_b = texrender;
+		deque_push_back(&ds->redo, &old, sizeof(old));
+	}
+	vector_stale(ds);
+	os_atomic_inc_long(&ds->canvas_version);
+	obs_leave_graphics();
+}
+
+void undo_proc_handler(void *data, calldata_t *cd)
+{
+	struct draw_source *ds = data;
+	if (shared_forward(ds, "undo", cd))
+		return;
+	undo(ds);
+}
+
+void redo(struct draw_source *ds)
+{
+	/* held throughout like in undo */
+	obs_enter_graphics();
+	canvas_acquire(ds);
+	if (!ds->redo.size) {
+		obs_leave_graphics();
+		return;
+	}
+	dab_flush(ds);
+	stroke_commit(ds);
+	record_action(ds, "redo");
+
+	gs_texrender_t *texrender = NULL;
+	deque_pop_back(&ds->redo, &texrender, sizeof(texrender));
+
+	if (ds->render_a_active) {
+		gs_texrender_t *old = ds->render_a;
+		ds->render_a = texrender;
+		deque_push_back(&ds->undo, &old, sizeof(old));
+	} else {
+		gs_texrender_t *old = ds->render_b;
+		ds->render_b = texrender;
+		deque_push_back(&ds->undo, &old, sizeof(old));
+	}
+	vector_stale(ds);
+	os_atomic_inc_long(&ds->canvas_version);
+	obs_leave_graphics();
+}
+
+void redo_proc_handler(void *data, calldata_t *cd)
+{
+	struct draw_source *ds = data;
+	if (shared_forward(ds, "redo", cd))
+		return;
+	redo(ds);
+}
+
+/* draws the points of a stroke event with the tool settings of the event, the current settings are kept */
+/* a pencil or brush segment that can not reach into the replay clip is skipped, only its pressure is carried on */
+static bool replay_clipped(const struct draw_source *ds)
+{
+	const struct vec4 *clip = &ds->replay_clip;
+	if (clip->z <= 0.0f)
+		return false;
+	bool dot = ds->mouse_previous_pos.x < 0.0f || ds->mouse_previous_pos.y < 0.0f;
+	const struct vec2 *from = dot ? &ds->mouse_pos : &ds->mouse_previous_pos;
+	float margin = ds->tool_size + 2.0f;
+	return fmaxf(from->x, ds->mouse_pos.x) + margin < clip->x || fminf(from->x, ds->mouse_pos.x) - margin > clip->x + clip->z ||
+	       fmaxf(from->y, ds->mouse_pos.y) + margin < clip->y || fminf(from->y, ds->mouse_pos.y) - margin > clip->y + clip->w;
+}
+
+static void stroke_replay(struct draw_source *ds, obs_data_t *stroke, const struct stroke_point *points, size_t count)
+{
+	uint32_t tool = ds->tool;
+	struct vec4 tool_color = ds->tool_color;
+	float tool_size = ds->tool_size;
+	uint32_t brush_tip = ds->brush_tip;
+	float brush_hardness = ds->brush_hardness;
+	float fill_tolerance = ds->fill_tolerance;
+	uint32_t tool_mode = ds->tool_mode;
+	bool shift_down = ds->shift_down;
+	struct vec2 select_from = ds->select_from;
+	struct vec2 select_to = ds->select_to;
+	struct vec2 mouse_pos = ds->mouse_pos;
+	struct vec2 mouse_previous_pos = ds->mouse_previous_pos;
+
+	ds->tool = (uint32_t)obs_data_get_int(stroke, "tool");
+	vec4_from_rgba(&ds->tool_color, (uint32_t)obs_data_get_int(stroke, "tool_color"));
+	ds->tool_color.w = (float)obs_data_get_double(stroke, "tool_alpha") / 100.0f;
+	ds->tool_size = (float)obs_data_get_double(stroke, "tool_size");
+	ds->brush_tip = (uint32_t)obs_data_get_int(stroke, "brush_tip");
+	ds->brush_hardness = (float)obs_data_get_double(stroke, "brush_hardness");
+	if (draw_on_mouse_move(ds->tool)) {
+		ds->tool_mode = TOOL_DOWN;
+		size_t i = 0;
+		if (obs_data_get_bool(stroke, "dot")) {
+			ds->mouse_previous_pos.x = -1.0f;
+			ds->mouse_previous_pos.y = -1.0f;
+		} else {
+			ds->mouse_previous_pos.x = points[0].x;
+			ds->mouse_previous_pos.y = points[0].y;
+			i = 1;
+		}
+		for (; i < count; i++) {
+			ds->mouse_pos.x = points[i].x;
+			ds->mouse_pos.y = points[i].y;
+			ds->tablet_factor = points[i].pressure;
+			if (replay_clipped(ds))
+				ds->stroke_pressure = ds->tablet_factor;
+			else
+				apply_tool(ds);
+			ds->mouse_previous_pos = ds->mouse_pos;
+		}
+		ds->tablet_factor = 1.0f;
+		obs_enter_graphics();
+		stroke_commit(ds);
+		obs_leave_graphics();
+	} else if (count > 1) {
+		ds->tool_mode = (uint32_t)obs_data_get_int(stroke, "tool_mode");
+		ds->shift_down = obs_data_get_bool(stroke, "shift");
+		ds->fill_tolerance = (float)obs_data_get_double(stroke, "fill_tolerance");
+		ds->select_from.x = (float)obs_data_get_double(stroke, "select_from_x");
+		ds->select_from.y = (float)obs_data_get_double(stroke, "select_from_y");
+		ds->select_to.x = (float)obs_data_get_double(stroke, "select_to_x");
+		ds->select_to.y = (float)obs_data_get_double(stroke, "select_to_y");
+		ds->mouse_previous_pos.x = points[0].x;
+		ds->mouse_previous_pos.y = points[0].y;
+		ds->mouse_pos.x = points[1].x;
+		ds->mouse_pos.y = points[1].y;
+		apply_tool(ds);
+	}
+
+	ds->tool = tool;
+	ds->tool_color = tool_color;
+	ds->tool_size = tool_size;
+	ds->brush_tip = brush_tip;
+	ds->brush_hardness = brush_hardness;
+	ds->fill_tolerance = fill_tolerance;
+	ds->tool_mode = tool_mode;
+	ds->shift_down = shift_down;
+	ds->select_from = select_from;
+	ds->select_to = select_to;
+	ds->mouse_pos = mouse_pos;
+	ds->mouse_previous_pos = mouse_previous_pos;
+}
+
+static void ingest_stroke(struct draw_source *ds, obs_data_t *stroke)
+{
+	struct stroke_point *points;
+	size_t count = stroke_points_decode_b64(obs_data_get_string(stroke, "points_b64"), &points);
+	if (!count)
+		return;
+	stroke_replay(ds, stroke, points, count);
+	vector_add(ds, stroke, points, count);
+	bfree(points);
+}
+
+/* removes a stroke from the model and draws its bounds again from the base with the strokes still overlapping them,
+ * called with the graphics lock held */
+static void vector_erase(struct draw_source *ds, uint32_t id)
+{
+	struct vector_object *object = &ds->vector_objects.array[id];
+	if (object->removed)
+		return;
+	object->removed = true;
+	struct vec4 bounds = object->bounds;
+	stroke_index_remove(ds->vector_index, id, bounds.x, bounds.y, bounds.z, bounds.w);
+	if (ds->vector_selected == id)
+		vector_select(ds, STROKE_INDEX_NONE);
+
+	float x0 = fmaxf(floorf(bounds.x), 0.0f);
+	float y0 = fmaxf(floorf(bounds.y), 0.0f);
+	float x1 = fminf(ceilf(bounds.z), ds->size.x);
+	float y1 = fminf(ceilf(bounds.w), ds->size.y);
+	gs_texrender_t *canvas = ds->render_a_active ? ds->render_a : ds->render_b;
+	gs_texture_t *base = gs_texrender_get_texture(ds->vector_base);
+	if (x1 <= x0 || y1 <= y0 || !base || !gs_texrender_get_texture(canvas))
+		return;
+
+	/* the overlapping strokes are replayed in order onto a copy of the base standing in for the canvas, only the erased
+	 * bounds are copied and drawn, the rest of the scratch pair is never read back */
+	if (!ds->vector_scratch_a) {
+		ds->vector_scratch_a = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		ds->vector_scratch_b = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	}
+	struct vec4 rect;
+	vec4_set(&rect, x0, y0, x1 - x0, y1 - y0);
+	vector_copy_rect(ds, ds->vector_scratch_a, base, &rect);
+	gs_texrender_t *render_a = ds->render_a;
+	gs_texrender_t *render_b = ds->render_b;
+	bool render_a_active = ds->render_a_active;
+	bool record_suspended = ds->record_suspended;
+	ds->render_a = ds->vector_scratch_a;
+	ds->render_b = ds->vector_scratch_b;
+	ds->render_a_active = true;
+	ds->record_suspended = true;
+	ds->replay_clip = rect;
+	size_t count;
+	uint32_t *ids = stroke_index_query(ds->vector_index, x0, y0, x1, y1, &count);
+	for (size_t i = 0; i < count; i++) {
+		const struct vector_object *replay = &ds->vector_objects.array[ids[i]];
+		stroke_replay(ds, replay->stroke, replay->points.array, replay->points.num);
+	}
+	bfree(ids);
+	stroke_commit(ds);
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	ds->render_a = render_a;
+	ds->render_b = render_b;
+	ds->render_a_active = render_a_active;
+	ds->record_suspended = record_suspended;
+	vec4_zero(&ds->replay_clip);
+
+	/* like shape_commit only the erased bounds of the canvas are overwritten */
+	if (tex)
+		vector_copy_rect(ds, canvas, tex, &rect);
+	os_atomic_inc_long(&ds->canvas_version);
+	record_patch(ds, "erase_stroke", &rect);
+}
+
+/* brings the model up to date with the canvas before it is hit tested, false without a model */
+static bool vector_prepare(struct draw_source *ds)
+{
+	if (!ds->vector)
+		return false;
+	canvas_acquire(ds);
+	record_flush(ds);
+	if (ds->vector_stale || !ds->vector_base) {
+		dab_flush(ds);
+		stroke_commit(ds);
+		vector_checkpoint(ds);
+	}
+	return ds->vector_index != NULL;
+}
+
+/* erases the last drawn stroke within distance of x, y, the caller pushed the undo step */
+static bool vector_erase_at(struct draw_source *ds, float x, float y, float distance)
+{
+	uint32_t id = stroke_index_hit(ds->vector_index, x, y, distance);
+	if (id == STROKE_INDEX_NONE)
+		return false;
+	vector_erase(ds, id);
+	return true;
+}
+
+/* the object eraser removes every stroke it touches in one undo step, stroke select picks the stroke under the pointer */
+static void vector_pick(struct draw_source *ds)
+{
+	if (!vector_prepare(ds))
+		return;
+	float distance = fmaxf(ds->tool_size, 1.0f);
+	uint32_t id = stroke_index_hit(ds->vector_index, ds->mouse_pos.x, ds->mouse_pos.y, distance);
+	if (ds->tool == TOOL_SELECT_STROKE) {
+		vector_select(ds, id);
+		return;
+	}
+	if (id == STROKE_INDEX_NONE)
+		return;
+	if (!ds->vector_erased) {
+		copy_to_undo(ds);
+		ds->vector_erased = true;
+	}
+	vector_erase_at(ds, ds->mouse_pos.x, ds->mouse_pos.y, distance);
+}
+
+static bool vector_erase_selected(struct draw_source *ds)
+{
+	obs_enter_graphics();
+	bool erased = false;
+	uint32_t id = ds->vector_selected;
+	if (vector_prepare(ds) && id != STROKE_INDEX_NONE && id == ds->vector_selected) {
+		copy_to_undo(ds);
+		vector_erase(ds, id);
+		erased = true;
+	}
+	obs_leave_graphics();
+	return erased;
+}
+
+/* puts back the pixels a recorded erase or fill left at "x", "y", the model never saw that change so it is rebuilt from
+ * the canvas at the next undo step, called with the graphics lock held */
+static void patch_ingest(struct draw_source *ds, obs_data_t *event)
+{
+	const char *image_b64 = obs_data_get_string(event, "image_b64");
+	size_t len = image_b64 ? strlen(image_b64) : 0;
+	uint8_t *data = len ? bmalloc(len / 4 * 3 + 3) : NULL;
+	size_t size = data ? stroke_base64_decode(image_b64, len, data, len / 4 * 3 + 3) : 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	/* the event may come from any client, so the image has to fit the canvas at its position before it is decoded */
+	long long x = obs_data_get_int(event, "x");
+	long long y = obs_data_get_int(event, "y");
+	bool fits = size && qoi_read_size(data, size, &width, &height) && x >= 0 && y >= 0 &&
+		    x + width <= (long long)ds->size.x && y + height <= (long long)ds->size.y;
+	uint8_t *pixels = fits ? qoi_decode(data, size, &width, &height) : NULL;
+	bfree(data);
+	gs_texture_t *patch = pixels ? gs_texture_create(width, height, GS_RGBA, 1, (const uint8_t **)&pixels, 0) : NULL;
+	bfree(pixels);
+	if (!patch) {
+		blog(LOG_WARNING, "[Draw] invalid image_b64 in %s event", obs_data_get_string(event, "action"));
+		return;
+	}
+
+	dab_flush(ds);
+	stroke_commit(ds);
+	gs_texrender_t *canvas = ds->render_a_active ? ds->render_a : ds->render_b;
+	gs_texrender_reset(canvas);
+	if (gs_texrender_begin(canvas, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
+		gs_blend_state_push();
+		gs_reset_blend_state();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+		gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
+		gs_matrix_push();
+		gs_matrix_translate3f((float)x, (float)y, 0.0f);
+		gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), patch);
+		while (gs_effect_loop(effect, "Draw"))
+			gs_draw_sprite(patch, 0, width, height);
+		gs_matrix_pop();
+		gs_blend_state_pop();
+		gs_texrender_end(canvas);
+	}
+	gs_texture_destroy(patch);
+	vector_stale(ds);
+	os_atomic_inc_long(&ds->canvas_version);
+}
+
+/* erases the stroke under "x", "y" within "size" pixels, or the selected stroke with "selected", in vector mode */
+void erase_stroke_proc_handler(void *param, calldata_t *cd)
+{
+	struct draw_source *ds = param;
+	if (shared_forward(ds, "erase_stroke", cd))
+		return;
+	obs_data_t *data = calldata_ptr(cd, "data");
+	obs_data_t *response = calldata_ptr(cd, "response");
+
+	bool erased = false;
+	if (data && obs_data_get_bool(data, "selected")) {
+		erased = vector_erase_selected(ds);
+	} else if (data) {
+		float x = (float)obs_data_get_double(data, "x");
+		float y = (float)obs_data_get_double(data, "y");
+		float distance = (float)obs_data_get_double(data, "size");
+		obs_enter_graphics();
+		if (vector_prepare(ds) && stroke_index_hit(ds->vector_index, x, y, distance) != STROKE_INDEX_NONE) {
+			copy_to_undo(ds);
+			erased = vector_erase_at(ds, x, y, distance);
+		}
+		obs_leave_graphics();
+	}
+	if (!response)
+		return;
+	obs_data_set_bool(response, "success", erased);
+	if (!ds->vector)
+		obs_data_set_string(response, "error", "vector strokes are off");
+	else if (!erased)
+		obs_data_set_string(response, "error", "no stroke there");
+}
+
+/* switches to a layer another source switched to, kept in the settings so the next update does not switch back */
+static void layer_ingest(struct draw_source *ds, uint32_t layer)
+{
+	if (layer < 1 || layer > ds->layer_count)
+		return;
+	layer_select(ds, layer - 1);
+	obs_data_t *settings = obs_source_get_settings(ds->source);
+	obs_data_set_int(settings, "layer", layer);
+	obs_data_release(settings);
+}
+
+static void page_select(struct draw_source *ds, uint32_t page);
+static void page_request(struct draw_source *ds, uint32_t page);
+static void view_ingest(struct draw_source *ds, int32_t x, int32_t y);
+
+static void page_remember(struct draw_source *ds)
+{
+	obs_data_t *settings = obs_source_get_settings(ds->source);
+	obs_data_set_int(settings, "page", ds->page_current + 1);
+	obs_data_release(settings);
+}
+
+/* switches pages like layer_ingest switches layers, replayed events wait for the page, the page proc only requests it */
+static void page_ingest(struct draw_source *ds, uint32_t page, bool wait)
+{
+	if (page < 1 || page > ds->page_count)
+		return;
+	obs_enter_graphics();
+	if (wait)
+		page_select(ds, page - 1);
+	else
+		page_request(ds, page - 1);
+	obs_leave_graphics();
+	page_remember(ds);
+}
+
+static void ingest_strokes(struct draw_source *ds, obs_data_array_t *strokes)
+{
+	/* ingested strokes are not recorded again so mirrored sources do not echo each other */
+	obs_enter_graphics();
+	canvas_acquire(ds);
+	ds->record_suspended = true;
+	size_t count = obs_data_array_count(strokes);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *stroke = obs_data_array_item(strokes, i);
+		const char *action = obs_data_get_string(stroke, "action");
+		if (strcmp(action, "stroke") == 0)
+			ingest_stroke(ds, stroke);
+		else if (strcmp(action, "checkpoint") == 0)
+			copy_to_undo(ds);
+		else if (strcmp(action, "clear") == 0)
+			draw_clear(ds);
+		else if (strcmp(action, "undo") == 0)
+			undo(ds);
+		else if (strcmp(action, "redo") == 0)
+			redo(ds);
+		else if (strcmp(action, "erase_stroke") == 0 || strcmp(action, "fill") == 0)
+			patch_ingest(ds, stroke);
+		else if (strcmp(action, "pan") == 0)
+			view_ingest(ds, (int32_t)obs_data_get_int(stroke, "x"), (int32_t)obs_data_get_int(stroke, "y"));
+		else if (strcmp(action, "page") == 0)
+			page_ingest(ds, (uint32_t)obs_data_get_int(stroke, "page"), true);
+		else if (strcmp(action, "layer") == 0)
+			layer_ingest(ds, (uint32_t)obs_data_get_int(stroke, "layer"));
+		else if (strcmp(action, "clear_layer") == 0 && obs_data_get_int(stroke, "layer") >= 1)
+			layer_clear(ds, (uint32_t)obs_data_get_int(stroke, "layer") - 1);
+		obs_data_release(stroke);
+	}
+	ds->record_suspended = false;
+	obs_leave_graphics();
+}
+
+/* replays the "strokes" array of a strokes event from another draw source */
+void ingest_proc_handler(void *param, calldata_t *cd)
+{
+	struct draw_source *ds = param;
+	if (shared_forward(ds, "ingest", cd))
+		return;
+	obs_data_t *data = calldata_ptr(cd, "data");
+	obs_data_array_t *strokes = data ? obs_data_get_array(data, "strokes") : NULL;
+	if (!strokes)
+		return;
+	ingest_strokes(ds, strokes);
+	obs_data_array_release(strokes);
+}
+
+void tablet_proc_handler(void *data, calldata_t *cd)
+{
+	struct draw_source *ds = data;
+	if (ds->shared) {
+		obs_source_t *owner = shared_owner(ds);
+		if (!owner)
+			return;
+		int32_t x, y;
+		shared_map(ds, (int32_t)calldata_int(cd, "posx"), (int32_t)calldata_int(cd, "posy"), &x, &y);
+		calldata_t d;
+		calldata_init(&d);
+		calldata_set_int(&d, "posx", x);
+		calldata_set_int(&d, "posy", y);
+		calldata_set_float(&d, "pressure", calldata_float(cd, "pressure"));
+		proc_handler_call(obs_source_get_proc_handler(owner), "tablet", &d);
+		calldata_free(&d);
+		obs_source_release(owner);
+		return;
+	}
+	obs_enter_graphics();
+	bool draw = draw_on_mouse_move(ds->tool);
+
+	double pressure = calldata_float(cd, "pressure");
+	if (pressure > 0.0 && draw) {
+		ds->mouse_previous_pos = ds->mouse_pos;
+	}
+	ds->mouse_pos.x = (float)calldata_int(cd, "posx");
+	ds->mouse_pos.y = (float)calldata_int(cd, "posy");
+	ds->mouse_active = pressure > 0.0;
+	ds->shift_down = false; //((event->modifiers & INTERACT_SHIFT_KEY) == INTERACT_SHIFT_KEY);
+
+	ds->tablet_factor = draw ? (float)pressure : 1.0f;
+	if (ds->mouse_active && ds->tool_mode != TOOL_UP && draw) {
+		apply_tool(ds);
+	}
+
+	if (pressure > 0.0) {
+		if (ds->tool_mode == TOOL_UP) {
+			ds->tool_mode = TOOL_DOWN;
+			if (!draw) {
+				ds->mouse_previous_pos = ds->mouse_pos;
+			}
+			if (ds->tool == TOOL_SELECT_RECTANGLE || ds->tool == TOOL_SELECT_ELLIPSE)
+				float_begin(ds);
+			ds->vector_erased = false;
+		}
+		if (draw || picks_stroke(ds->tool)) {
+			apply_tool(ds);
+		}
+	} else if (ds->tool_mode == TOOL_DOWN) {
+		if (!draw) {
+			if (ds->tool == TOOL_SELECT_RECTANGLE || ds->tool == TOOL_SELECT_ELLIPSE) {
+				ds->select_from = ds->mouse_previous_pos;
+				ds->select_to = ds->mouse_pos;
+			} else if (!picks_stroke(ds->tool)) {
+				copy_to_undo(ds);
+				apply_tool(ds);
+			}
+		} else {
+			copy_to_undo(ds);
+		}
+		ds->tool_mode = TOOL_UP;
+		ds->tablet_factor = 1.0f;
+	} else if (ds->tool_mode == TOOL_DRAG) {
+		copy_to_undo(ds);
+		apply_tool(ds);
+		ds->tool_mode = TOOL_UP;
+	}
+	obs_leave_graphics();
+}
+
+static void snapshot_release(struct draw_snapshot *snapshot)
+{
+	if (os_atomic_dec_long(&snapshot->refs) > 0)
+		return;
+	os_event_destroy(snapshot->done);
+	bfree(snapshot->path);
+	bfree(snapshot->pixels);
+	bfree(snapshot->image_b64);
+	bfree(snapshot->image);
+	bfree(snapshot);
+}
+
+static void snapshot_finish(struct draw_snapshot *snapshot, bool success)
+{
+	if (snapshot->finished)
+		snapshot->finished(snapshot->finished_param, success);
+	snapshot->success = success;
+	os_event_signal(snapshot->done);
+	snapshot_release(snapshot);
+}
+
+/* writes through a temporary file so a crash never leaves a truncated image behind */
+static bool snapshot_write(const char *path, const uint8_t *image, size_t size)
+{
+	struct dstr temp_path = {0};
+	dstr_printf(&temp_path, "%s.tmp", path);
+	bool success = false;
+	FILE *file = os_fopen(temp_path.array, "wb");
+	if (file) {
+		success = fwrite(image, 1, size, file) == size;
+		fclose(file);
+	}
+	success = success && os_safe_replace(path, temp_path.array, NULL) == 0;
+	dstr_free(&temp_path);
+	if (!success)
+		blog(LOG_WARNING, "[Draw] failed to write snapshot '%s'", path);
+	return success;
+}
+
+static void snapshot_encode_task(void *param)
+{
+	struct draw_snapshot *snapshot = param;
+	uint32_t linesize = snapshot->width * 4;
+	snapshot->empty = true;
+	for (size_t i = 3; snapshot->empty && i < (size_t)linesize * snapshot->height; i += 4)
+		snapshot->empty = snapshot->pixels[i] == 0;
+	if (snapshot->empty && snapshot->skip_empty && snapshot->path) {
+		bfree(snapshot->pixels);
+		snapshot->pixels = NULL;
+		if (os_file_exists(snapshot->path))
+			os_unlink(snapshot->path);
+		snapshot_finish(snapshot, true);
+		return;
+	}
+	if (snapshot->premultiplied) {
+		uint8_t *p = snapshot->pixels;
+		for (size_t i = (size_t)snapshot->width * snapshot->height; i > 0; i--, p += 4) {
+			if (!p[3] || p[3] == 255)
+				continue;
+			for (int c = 0; c < 3; c++) {
+				uint32_t v = ((uint32_t)p[c] * 255 + p[3] / 2) / p[3];
+				p[c] = (uint8_t)(v > 255 ? 255 : v);
+			}
+		}
+	}
+	size_t size = 0;
+	uint8_t *image = snapshot->qoi ? qoi_encode(snapshot->pixels, snapshot->width, snapshot->height, linesize, &size)
+				       : draw_encode_png(snapshot->pixels, snapshot->width, snapshot->height, linesize, &size);
+	bfree(snapshot->pixels);
+	snapshot->pixels = NULL;
+	bool success = false;
+	if (image && snapshot->keep) {
+		snapshot->image = image;
+		snapshot->image_size = size;
+		image = NULL;
+		success = true;
+	} else if (image && snapshot->path) {
+		success = snapshot_write(snapshot->path, image, size);
+	} else if (image) {
+		snapshot->image_b64 = stroke_base64_encode(image, size);
+		success = true;
+	}
+	bfree(image);
+	snapshot_finish(snapshot, success);
+}
+
+static void snapshot_stage_texture(struct draw_snapshot *snapshot, gs_texture_t *tex)
+{
+	snapshot->width = gs_texture_get_width(tex);
+	snapshot->height = gs_texture_get_height(tex);
+	snapshot->stagesurf = gs_stagesurface_create(snapshot->width, snapshot->height, GS_RGBA);
+	gs_stage_texture(snapshot->stagesurf, tex);
+}
+
+static void snapshot_stage(struct draw_source *ds, struct draw_snapshot *snapshot)
+{
+	canvas_acquire(ds);
+	dab_flush(ds);
+	stroke_commit(ds);
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (snapshot->layer == SNAPSHOT_FLATTENED && ds->layer_count > 1) {
+		tex = layers_flatten(ds);
+		snapshot->premultiplied = true;
+	} else if (snapshot->layer >= 0 && (uint32_t)snapshot->layer != ds->layer_current) {
+		gs_texrender_t *layer = (uint32_t)snapshot->layer < LAYER_MAX ? ds->layers[snapshot->layer].render : NULL;
+		tex = layer ? gs_texrender_get_texture(layer) : NULL;
+	}
+	if (tex)
+		snapshot_stage_texture(snapshot, tex);
+}
+
+/* maps the staged canvas and hands the pixels to the encoder, consumes the pipeline reference */
+static void snapshot_read(struct draw_source *ds, struct draw_snapshot *snapshot)
+{
+	uint8_t *data;
+	uint32_t linesize;
+	if (snapshot->stagesurf && gs_stagesurface_map(snapshot->stagesurf, &data, &linesize)) {
+		uint32_t row = snapshot->width * 4;
+		snapshot->pixels = bmalloc((size_t)row * snapshot->height);
+		for (uint32_t y = 0; y < snapshot->height; y++)
+			memcpy(snapshot->pixels + (size_t)y * row, data + (size_t)y * linesize, row);
+		gs_stagesurface_unmap(snapshot->stagesurf);
+	}
+	gs_stagesurface_destroy(snapshot->stagesurf);
+	snapshot->stagesurf = NULL;
+	if (!snapshot->pixels)
+		snapshot_finish(snapshot, false);
+	else
+		os_task_queue_queue_task(ds->snapshot_tasks, snapshot_encode_task, snapshot);
+}
+
+/* stages the canvas of new snapshot requests and maps staged ones a few ticks later so the readback never stalls */
+static void snapshot_tick(struct draw_source *ds)
+{
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	bool pending = ds->snapshots.num != 0;
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	if (!pending)
+		return;
+
+	obs_enter_graphics();
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	for (size_t i = 0; i < ds->snapshots.num; i++) {
+		struct draw_snapshot *snapshot = ds->snapshots.array[i];
+		if (!snapshot->stagesurf) {
+			snapshot_stage(ds, snapshot);
+			if (!snapshot->stagesurf) {
+				da_erase(ds->snapshots, i--);
+				snapshot_finish(snapshot, false);
+			}
+			continue;
+		}
+		if (++snapshot->ticks < SNAPSHOT_MAP_DELAY_TICKS)
+			continue;
+		da_erase(ds->snapshots, i--);
+		snapshot_read(ds, snapshot);
+	}
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	obs_leave_graphics();
+}
+
+static struct draw_snapshot *snapshot_create(const char *path, bool qoi, bool wait)
+{
+	struct draw_snapshot *snapshot = bzalloc(sizeof(struct draw_snapshot));
+	if (path && *path)
+		snapshot->path = bstrdup(path);
+	snapshot->qoi = qoi;
+	snapshot->layer = SNAPSHOT_CANVAS;
+	snapshot->refs = wait ? 2 : 1;
+	os_event_init(&snapshot->done, OS_EVENT_TYPE_MANUAL);
+	return snapshot;
+}
+
+static void snapshot_queue(struct draw_source *ds, struct draw_snapshot *snapshot)
+{
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	da_push_back(ds->snapshots, &snapshot);
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+}
+
+/* keeps a snapshot a client polls for, dropping the oldest finished one when too many were never polled */
+static uint32_t snapshot_keep_result(struct draw_source *ds, struct draw_snapshot *snapshot)
+{
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	if (!++ds->snapshot_next_id)
+		ds->snapshot_next_id = 1;
+	snapshot->id = ds->snapshot_next_id;
+	for (size_t i = 0; ds->snapshot_results.num >= SNAPSHOT_RESULTS_MAX && i < ds->snapshot_results.num; i++) {
+		struct draw_snapshot *old = ds->snapshot_results.array[i];
+		if (os_event_try(old->done) != 0)
+			continue;
+		da_erase(ds->snapshot_results, i--);
+		snapshot_release(old);
+	}
+	da_push_back(ds->snapshot_results, &snapshot);
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	return snapshot->id;
+}
+
+/* takes a kept snapshot out once it finished, NULL while it is still pending */
+static struct draw_snapshot *snapshot_take_result(struct draw_source *ds, uint32_t id, bool *found)
+{
+	struct draw_snapshot *snapshot = NULL;
+	*found = false;
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	for (size_t i = 0; i < ds->snapshot_results.num; i++) {
+		if (ds->snapshot_results.array[i]->id != id)
+			continue;
+		*found = true;
+		if (os_event_try(ds->snapshot_results.array[i]->done) == 0) {
+			snapshot = ds->snapshot_results.array[i];
+			da_erase(ds->snapshot_results, i);
+		}
+		break;
+	}
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	return snapshot;
+}
+
+/* queues a snapshot, when a response is passed it answers with an id right away and a later call with that id
+ * returns the encoded image once it is ready, so no caller ever blocks on the readback */
+void snapshot_proc_handler(void *param, calldata_t *cd)
+{
+	struct draw_source *ds = param;
+	if (shared_forward(ds, "snapshot", cd))
+		return;
+	obs_data_t *data = calldata_ptr(cd, "data");
+	obs_data_t *response = calldata_ptr(cd, "response");
+
+	if (response && data && obs_data_has_user_value(data, "id")) {
+		uint32_t id = (uint32_t)obs_data_get_int(data, "id");
+		bool found;
+		struct draw_snapshot *snapshot = snapshot_take_result(ds, id, &found);
+		obs_data_set_int(response, "id", id);
+		if (!found) {
+			obs_data_set_string(response, "error", "unknown snapshot id");
+			obs_data_set_bool(response, "success", false);
+			return;
+		}
+		if (!snapshot) {
+			obs_data_set_bool(response, "success", true);
+			obs_data_set_bool(response, "pending", true);
+			return;
+		}
+		obs_data_set_bool(response, "success", snapshot->success);
+		obs_data_set_bool(response, "pending", false);
+		obs_data_set_string(response, "format", snapshot->qoi ? "qoi" : "png");
+		obs_data_set_int(response, "width", snapshot->width);
+		obs_data_set_int(response, "height", snapshot->height);
+		if (snapshot->path)
+			obs_data_set_string(response, "path", snapshot->path);
+		if (snapshot->image_b64)
+			obs_data_set_string(response, "image_b64", snapshot->image_b64);
+		snapshot_release(snapshot);
+		return;
+	}
+
+	const char *path = data ? obs_data_get_string(data, "path") : NULL;
+	const char *format = data ? obs_data_get_string(data, "format") : NULL;
+	bool qoi = false;
+	if (format && *format) {
+		qoi = astrcmpi(format, "qoi") == 0;
+	} else if (path && *path) {
+		const char *ext = strrchr(path, '.');
+		qoi = ext && astrcmpi(ext, ".qoi") == 0;
+	}
+	struct draw_snapshot *snapshot = snapshot_create(path, qoi, response != NULL);
+	snapshot->layer = SNAPSHOT_FLATTENED;
+	uint32_t id = response ? snapshot_keep_result(ds, snapshot) : 0;
+	snapshot_queue(ds, snapshot);
+	if (!response)
+		return;
+	obs_data_set_bool(response, "success", true);
+	obs_data_set_bool(response, "pending", true);
+	obs_data_set_int(response, "id", id);
+}
+
+/* the file of a layer that is not current, next to the canvas file */
+static char *layer_path(const char *canvas_path, uint32_t layer)
+{
+	struct dstr path = {0};
+	dstr_copy(&path, canvas_path);
+	if (path.len > 4 && astrcmpi(path.array + path.len - 4, ".qoi") == 0)
+		dstr_resize(&path, path.len - 4);
+	dstr_catf(&path, "-layer%u.qoi", layer + 1);
+	return path.array;
+}
+
+/* the file of a layer of a page that is not current, every layer is named so the current layer can change meanwhile */
+static char *page_path(const char *canvas_path, uint32_t page, uint32_t layer)
+{
+	struct dstr path = {0};
+	dstr_copy(&path, canvas_path);
+	if (path.len > 4 && astrcmpi(path.array + path.len - 4, ".qoi") == 0)
+		dstr_resize(&path, path.len - 4);
+	dstr_catf(&path, "-page%u-layer%u.qoi", page + 1, layer + 1);
+	return path.array;
+}
+
+static uint8_t *canvas_read(const char *path, uint32_t *width, uint32_t *height)
+{
+	uint8_t *pixels = NULL;
+	FILE *file = os_fopen(path, "rb");
+	if (file) {
+		int64_t size = os_fgetsize(file);
+		uint8_t *data = size > 0 ? bmalloc((size_t)size) : NULL;
+		if (data && fread(data, 1, (size_t)size, file) == (size_t)size &&
+		    qoi_read_size(data, (size_t)size, width, height) && *width <= CANVAS_SIZE_MAX && *height <= CANVAS_SIZE_MAX)
+			pixels = qoi_decode(data, (size_t)size, width, height);
+		bfree(data);
+		fclose(file);
+	}
+	if (!pixels)
+		blog(LOG_WARNING, "[Draw] failed to load canvas '%s'", path);
+	return pixels;
+}
+
+/* reads the saved canvas and the crash recovery journal, the result is applied on the next render */
+static void canvas_load_task(void *param)
+{
+	struct draw_source *ds = param;
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	char *path = ds->canvas_path ? bstrdup(ds->canvas_path) : NULL;
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+
+	uint8_t *pixels = NULL;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t generation = 0;
+	obs_data_array_t *replay = NULL;
+	if (ds->journal_recover)
+		replay = stroke_journal_read(ds->journal_dir, &pixels, &width, &height, &generation);
+	if (!pixels && path)
+		pixels = canvas_read(path, &width, &height);
+	uint8_t *layer_pixels[LAYER_MAX] = {0};
+	uint32_t layer_width[LAYER_MAX] = {0};
+	uint32_t layer_height[LAYER_MAX] = {0};
+	for (uint32_t i = 0; path && i < ds->layer_count; i++) {
+		char *file = i != ds->layer_current ? layer_path(path, i) : NULL;
+		if (file && os_file_exists(file))
+			layer_pixels[i] = canvas_read(file, &layer_width[i], &layer_height[i]);
+		bfree(file);
+	}
+	bfree(path);
+	if (replay && obs_data_array_count(replay))
+		blog(LOG_INFO, "[Draw] recovering %d strokes from journal", (int)obs_data_array_count(replay));
+
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	ds->canvas_pixels = pixels;
+	ds->canvas_width = width;
+	ds->canvas_height = height;
+	ds->journal_replay = replay;
+	ds->journal_generation = generation;
+	memcpy(ds->layer_pixels, layer_pixels, sizeof(layer_pixels));
+	memcpy(ds->layer_width, layer_width, sizeof(layer_width));
+	memcpy(ds->layer_height, layer_height, sizeof(layer_height));
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	os_atomic_set_bool(&ds->canvas_loaded, true);
+}
+
+static void ingest_strokes(struct draw_source *ds, obs_data_array_t *strokes);
+
+/* draws pixels into the top left of a cx by cy target, the rest of the target is cleared */
+static void render_upload(gs_texrender_t *target, uint32_t cx, uint32_t cy, uint8_t *pixels, uint32_t width, uint32_t height)
+{
+	if (!pixels)
+		return;
+
+	gs_texture_t *tex = gs_texture_create(width, height, GS_RGBA, 1, (const uint8_t **)&pixels, 0);
+	gs_texrender_reset(target);
+	if (tex && gs_texrender_begin(target, cx, cy)) {
+		struct vec4 clear_color;
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_blend_state_push();
+		gs_reset_blend_state();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+		gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), tex);
+		while (gs_effect_loop(effect, "Draw"))
+			gs_draw_sprite(tex, 0, width, height);
+		gs_blend_state_pop();
+		gs_texrender_end(target);
+	}
+	gs_texture_destroy(tex);
+}
+
+static void canvas_upload(struct draw_source *ds, gs_texrender_t *target, uint8_t *pixels, uint32_t width, uint32_t height)
+{
+	render_upload(target, (uint32_t)ds->size.x, (uint32_t)ds->size.y, pixels, width, height);
+}
+
+/* uploads the canvas loaded by canvas_load_task into the active render target and replays the journal on top */
+static void canvas_restore(struct draw_source *ds)
+{
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	uint8_t *pixels = ds->canvas_pixels;
+	uint32_t width = ds->canvas_width;
+	uint32_t height = ds->canvas_height;
+	obs_data_array_t *replay = ds->journal_replay;
+	ds->canvas_pixels = NULL;
+	ds->journal_replay = NULL;
+	uint8_t *layer_pixels[LAYER_MAX];
+	memcpy(layer_pixels, ds->layer_pixels, sizeof(layer_pixels));
+	memset(ds->layer_pixels, 0, sizeof(ds->layer_pixels));
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	ds->canvas_loading = false;
+
+	/* whatever was drawn before the load finished is set aside and put back on top of the loaded canvas */
+	gs_texrender_t *early = NULL;
+	gs_texture_t *drawn = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (pixels && drawn && os_atomic_load_long(&ds->canvas_version)) {
+		early = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		vector_copy(ds, early, drawn);
+	}
+	canvas_upload(ds, ds->render_a_active ? ds->render_a : ds->render_b, pixels, width, height);
+	bfree(pixels);
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		if (!layer_pixels[i])
+			continue;
+		if (i < ds->layer_count && i != ds->layer_current) {
+			if (!ds->layers[i].render)
+				ds->layers[i].render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+			canvas_upload(ds, ds->layers[i].render, layer_pixels[i], ds->layer_width[i], ds->layer_height[i]);
+			ds->layers_dirty = true;
+		}
+		bfree(layer_pixels[i]);
+	}
+	if (replay) {
+		ingest_strokes(ds, replay);
+		obs_data_array_release(replay);
+	}
+	gs_texture_t *tex = early ? gs_texrender_get_texture(early) : NULL;
+	gs_texrender_t *target = ds->render_a_active ? ds->render_a : ds->render_b;
+	if (tex && gs_texrender_begin(target, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
+		gs_blend_state_push();
+		gs_reset_blend_state();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+		gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
+		layers_draw_premultiplied(tex, "Draw", (uint32_t)ds->size.x, (uint32_t)ds->size.y);
+		gs_blend_state_pop();
+		gs_texrender_end(target);
+	}
+	gs_texrender_destroy(early);
+	vector_stale(ds);
+}
+
+static void tile_sync_layers(struct draw_source *ds);
+static void tile_compose_layers(struct draw_source *ds);
+static void tile_evict(struct draw_source *ds);
+
+static bool page_evicting(const struct draw_page *page)
+{
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		if (page->evicting[i])
+			return true;
+	}
+	return false;
+}
+
+static bool page_textures(const struct draw_page *page)
+{
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		if (page->layers[i])
+			return true;
+	}
+	return false;
+}
+
+/* drops a running eviction, the encoder still holds its own reference to the snapshots */
+static void page_cancel(struct draw_source *ds, struct draw_page *page)
+{
+	if (!page_evicting(page))
+		return;
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		if (page->evicting[i])
+			snapshot_release(page->evicting[i]);
+		page->evicting[i] = NULL;
+	}
+	ds->pages_evicting--;
+}
+
+/* frees everything a page holds, for pages removed by lowering the page count */
+static void page_discard(struct draw_source *ds, struct draw_page *page)
+{
+	page_cancel(ds, page);
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		gs_texrender_destroy(page->layers[i]);
+		page->layers[i] = NULL;
+		bfree(page->packed[i]);
+		page->packed[i] = NULL;
+		page->packed_size[i] = 0;
+	}
+	page->resident = false;
+	page->loaded = true;
+	page->unsaved = true;
+}
+
+/* starts packing the least recently used pages until at most page_resident pages, the current one included, hold textures,
+ * a released canvas packs every page */
+static void page_evict(struct draw_source *ds)
+{
+	for (;;) {
+		uint32_t resident = ds->canvas_released ? 0 : 1;
+		struct draw_page *oldest = NULL;
+		for (uint32_t p = 0; p < ds->page_count; p++) {
+			struct draw_page *page = &ds->pages[p];
+			if ((p == ds->page_current && !ds->canvas_released) || page_evicting(page) || !page_textures(page))
+				continue;
+			resident++;
+			if (!oldest || page->used < oldest->used)
+				oldest = page;
+		}
+		if (!oldest || resident <= (ds->canvas_released ? 0 : ds->page_resident))
+			return;
+
+		/* read back with the snapshot pipeline, the textures are only dropped in page_tick once every layer is packed */
+		for (uint32_t i = 0; i < LAYER_MAX; i++) {
+			gs_texture_t *tex = oldest->layers[i] ? gs_texrender_get_texture(oldest->layers[i]) : NULL;
+			if (!tex)
+				continue;
+			struct draw_snapshot *snapshot = snapshot_create(NULL, true, true);
+			snapshot->keep = true;
+			snapshot_stage_texture(snapshot, tex);
+			snapshot_queue(ds, snapshot);
+			oldest->evicting[i] = snapshot;
+		}
+		ds->pages_evicting++;
+	}
+}
+
+/* finishes evictions whose readback and encode completed, a page that failed to pack keeps its textures */
+static void page_tick(struct draw_source *ds)
+{
+	for (uint32_t p = 0; p < PAGE_MAX; p++) {
+		struct draw_page *page = &ds->pages[p];
+		if (!page_evicting(page))
+			continue;
+		bool done = true;
+		bool success = true;
+		for (uint32_t i = 0; i < LAYER_MAX; i++) {
+			if (!page->evicting[i])
+				continue;
+			if (os_event_try(page->evicting[i]->done) != 0)
+				done = false;
+			else
+				success = success && page->evicting[i]->success;
+		}
+		if (!done)
+			continue;
+		for (uint32_t i = 0; i < LAYER_MAX; i++) {
+			struct draw_snapshot *snapshot = page->evicting[i];
+			if (!snapshot)
+				continue;
+			if (success) {
+				page->packed[i] = snapshot->image;
+				page->packed_size[i] = snapshot->image_size;
+				snapshot->image = NULL;
+				gs_texrender_destroy(page->layers[i]);
+				page->layers[i] = NULL;
+			}
+			snapshot_release(snapshot);
+			page->evicting[i] = NULL;
+		}
+		page->resident = !success;
+		ds->pages_evicting--;
+	}
+}
+
+/* brings a page back as textures, from the packed images or on first use from its files next to the canvas file */
+static void page_restore(struct draw_source *ds, struct draw_page *page, uint32_t index)
+{
+	page_cancel(ds, page);
+	if (!page->loaded) {
+		page->loaded = true;
+		for (uint32_t i = 0; ds->canvas_path && i < ds->layer_count; i++) {
+			char *path = page_path(ds->canvas_path, index, i);
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint8_t *pixels = os_file_exists(path) ? canvas_read(path, &width, &height) : NULL;
+			if (pixels) {
+				page->layers[i] = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+				canvas_upload(ds, page->layers[i], pixels, width, height);
+				bfree(pixels);
+			}
+			bfree(path);
+		}
+	} else if (!page->resident) {
+		for (uint32_t i = 0; i < LAYER_MAX; i++) {
+			if (!page->packed[i])
+				continue;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint8_t *pixels = qoi_decode(page->packed[i], page->packed_size[i], &width, &height);
+			if (pixels) {
+				page->layers[i] = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+				canvas_upload(ds, page->layers[i], pixels, width, height);
+				bfree(pixels);
+			}
+			bfree(page->packed[i]);
+			page->packed[i] = NULL;
+			page->packed_size[i] = 0;
+		}
+	}
+	page->resident = true;
+}
+
+/* moves the layers of the current page into its page slot, only the spare render target is left */
+static void page_park(struct draw_source *ds)
+{
+	struct draw_page *page = &ds->pages[ds->page_current];
+	gs_texrender_t *spare = ds->render_a_active ? ds->render_b : ds->render_a;
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		page->layers[i] = ds->layers[i].render;
+		ds->layers[i].render = NULL;
+	}
+	page->layers[ds->layer_current] = ds->render_a_active ? ds->render_a : ds->render_b;
+	page->resident = true;
+	page->loaded = true;
+	page->used = ++ds->page_clock;
+	ds->render_a = NULL;
+	ds->render_b = spare;
+}
+
+/* moves the layers of the page made current back out of its page slot, restoring them first when they were packed */
+static void page_unpark(struct draw_source *ds)
+{
+	struct draw_page *page = &ds->pages[ds->page_current];
+	page_restore(ds, page, ds->page_current);
+	ds->render_a = page->layers[ds->layer_current] ? page->layers[ds->layer_current] : layer_create(ds);
+	page->layers[ds->layer_current] = NULL;
+	if (!ds->render_b)
+		ds->render_b = layer_create(ds);
+	ds->render_a_active = true;
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		ds->layers[i].render = page->layers[i];
+		page->layers[i] = NULL;
+	}
+	page->resident = false;
+	ds->layers_dirty = true;
+}
+
+struct page_decode {
+	struct draw_source *ds;
+	uint32_t id;
+	char *paths[LAYER_MAX];
+	uint8_t *data[LAYER_MAX];
+	size_t size[LAYER_MAX];
+};
+
+/* decodes the layers of a page on the worker, dropped when another page was requested meanwhile */
+static void page_decode_task(void *param)
+{
+	struct page_decode *decode = param;
+	uint8_t *pixels[LAYER_MAX] = {0};
+	uint32_t width[LAYER_MAX] = {0};
+	uint32_t height[LAYER_MAX] = {0};
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		if (decode->data[i])
+			pixels[i] = qoi_decode(decode->data[i], decode->size[i], &width[i], &height[i]);
+		else if (decode->paths[i] && os_file_exists(decode->paths[i]))
+			pixels[i] = canvas_read(decode->paths[i], &width[i], &height[i]);
+		bfree(decode->data[i]);
+		bfree(decode->paths[i]);
+	}
+	struct draw_source *ds = decode->ds;
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	bool current = ds->page_decode_id == decode->id && !ds->page_decoded;
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		if (!current) {
+			bfree(pixels[i]);
+			continue;
+		}
+		ds->page_pixels[i] = pixels[i];
+		ds->page_width[i] = width[i];
+		ds->page_height[i] = height[i];
+	}
+	ds->page_decoded = ds->page_decoded || current;
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	bfree(decode);
+}
+
+/* forgets a requested page, a decode still running is dropped once it finishes */
+static void page_decode_cancel(struct draw_source *ds)
+{
+	if (!ds->page_loading)
+		return;
+	ds->page_loading = false;
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	ds->page_decode_id++;
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		bfree(ds->page_pixels[i]);
+		ds->page_pixels[i] = NULL;
+	}
+	ds->page_decoded = false;
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+}
+
+/* switches to a page right away when its layers are on the GPU, else decodes them on the worker first,
+ * called with the graphics lock held */
+static void page_request(struct draw_source *ds, uint32_t page)
+{
+	page_decode_cancel(ds);
+	if (page >= ds->page_count || page == ds->page_current)
+		return;
+	struct draw_page *slot = &ds->pages[page];
+	struct page_decode *decode = bzalloc(sizeof(struct page_decode));
+	bool needed = false;
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		if (!slot->loaded && ds->canvas_path && i < ds->layer_count) {
+			decode->paths[i] = page_path(ds->canvas_path, page, i);
+			needed = true;
+		} else if (slot->loaded && !slot->resident && slot->packed[i]) {
+			decode->data[i] = bmemdup(slot->packed[i], slot->packed_size[i]);
+			decode->size[i] = slot->packed_size[i];
+			needed = true;
+		}
+	}
+	if (!needed) {
+		bfree(decode);
+		page_select(ds, page);
+		return;
+	}
+	ds->page_loading = true;
+	ds->page_target = page;
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	decode->ds = ds;
+	decode->id = ds->page_decode_id;
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	os_task_queue_queue_task(ds->snapshot_tasks, page_decode_task, decode);
+}
+
+/* uploads the layers of a requested page once they are decoded and makes it current */
+static void page_decode_tick(struct draw_source *ds)
+{
+	uint8_t *pixels[LAYER_MAX];
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	bool decoded = ds->page_decoded;
+	memcpy(pixels, ds->page_pixels, sizeof(pixels));
+	if (decoded) {
+		memset(ds->page_pixels, 0, sizeof(ds->page_pixels));
+		ds->page_decoded = false;
+	}
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	if (!decoded)
+		return;
+
+	obs_enter_graphics();
+	ds->page_loading = false;
+	uint32_t index = ds->page_target;
+	struct draw_page *page = &ds->pages[index];
+	/* the slot may have been restored or discarded meanwhile, then the decoded layers are stale */
+	bool apply = index < ds->page_count && index != ds->page_current && !page->resident && !page_textures(page);
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		if (apply && pixels[i]) {
+			page->layers[i] = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+			canvas_upload(ds, page->layers[i], pixels[i], ds->page_width[i], ds->page_height[i]);
+		}
+		if (apply) {
+			bfree(page->packed[i]);
+			page->packed[i] = NULL;
+			page->packed_size[i] = 0;
+		}
+		bfree(pixels[i]);
+	}
+	if (apply) {
+		page->loaded = true;
+		page->resident = true;
+		page_select(ds, index);
+	}
+	obs_leave_graphics();
+	if (apply)
+		page_remember(ds);
+}
+
+/* makes another page current by swapping its layers in, like switching layers the undo history is dropped */
+static void page_select(struct draw_source *ds, uint32_t page)
+{
+	page_decode_cancel(ds);
+	if (page >= ds->page_count || page == ds->page_current)
+		return;
+	canvas_acquire(ds);
+	dab_flush(ds);
+	stroke_commit(ds);
+	obs_data_t *event = record_action(ds, "page");
+	if (event)
+		obs_data_set_int(event, "page", page + 1);
+	undo_clear(ds);
+
+	if (ds->infinite)
+		tile_sync_layers(ds);
+	page_park(ds);
+	ds->pages[ds->page_current].unsaved = true;
+	ds->page_current = page;
+	page_unpark(ds);
+	if (ds->infinite)
+		tile_compose_layers(ds);
+	for (uint32_t i = 0; i < LAYER_MAX; i++)
+		ds->layers[i].unsaved = true;
+	ds->journal_checkpoint_due = true;
+	vector_stale(ds);
+	os_atomic_inc_long(&ds->canvas_version);
+	page_evict(ds);
+}
+
+/* switches to page "page" or "step" pages away from the current one and reports the page now current */
+void page_proc_handler(void *param, calldata_t *cd)
+{
+	struct draw_source *ds = param;
+	if (shared_forward(ds, "page", cd))
+		return;
+	obs_data_t *data = calldata_ptr(cd, "data");
+	obs_data_t *response = calldata_ptr(cd, "response");
+
+	/* steps count from a page still being decoded so pressing a hotkey twice moves two pages */
+	obs_enter_graphics();
+	long long page = (long long)(ds->page_loading ? ds->page_target : ds->page_current) + 1;
+	if (data && obs_data_has_user_value(data, "page"))
+		page = obs_data_get_int(data, "page");
+	else if (data)
+		page += obs_data_get_int(data, "step");
+	if (page < 1)
+		page = 1;
+	else if (page > ds->page_count)
+		page = ds->page_count;
+	page_ingest(ds, (uint32_t)page, false);
+	if (response) {
+		obs_data_set_bool(response, "success", true);
+		obs_data_set_int(response, "page", (ds->page_loading ? ds->page_target : ds->page_current) + 1);
+		obs_data_set_bool(response, "pending", ds->page_loading);
+		obs_data_set_int(response, "page_count", ds->page_count);
+	}
+	obs_leave_graphics();
+}
+
+static void undo_pack_cancel(struct draw_source *ds)
+{
+	for (size_t i = 0; i < ds->undo_packing.num; i++)
+		snapshot_release(ds->undo_packing.array[i]);
+	ds->undo_packing.num = 0;
+	for (size_t i = 0; i < ds->undo_packed.num; i++)
+		bfree(ds->undo_packed.array[i].image);
+	ds->undo_packed.num = 0;
+	ds->undo_packed_count = 0;
+}
+
+/* starts packing the undo and redo steps of a released canvas with the snapshot pipeline, the textures stay until
+ * undo_pack_tick sees every step packed */
+static void undo_pack(struct draw_source *ds)
+{
+	undo_pack_cancel(ds);
+	size_t undo_count = ds->undo.size / sizeof(gs_texrender_t *);
+	size_t count = undo_count + ds->redo.size / sizeof(gs_texrender_t *);
+	for (size_t i = 0; i < count; i++) {
+		gs_texrender_t **step = i < undo_count ? deque_data(&ds->undo, i * sizeof(*step))
+						       : deque_data(&ds->redo, (i - undo_count) * sizeof(*step));
+		gs_texrender_t *texrender = *step;
+		gs_texture_t *tex = gs_texrender_get_texture(texrender);
+		if (!tex)
+			continue;
+		struct draw_snapshot *snapshot = snapshot_create(NULL, true, true);
+		snapshot->keep = true;
+		snapshot_stage_texture(snapshot, tex);
+		snapshot_queue(ds, snapshot);
+		da_push_back(ds->undo_packing, &snapshot);
+		if (i < undo_count)
+			ds->undo_packed_count++;
+	}
+}
+
+/* drops the undo textures of a released canvas once every step is packed, a step that failed to pack keeps them all */
+static void undo_pack_tick(struct draw_source *ds)
+{
+	bool success = true;
+	for (size_t i = 0; i < ds->undo_packing.num; i++) {
+		if (os_event_try(ds->undo_packing.array[i]->done) != 0)
+			return;
+		success = success && ds->undo_packing.array[i]->success;
+	}
+	for (size_t i = 0; success && i < ds->undo_packing.num; i++) {
+		struct draw_snapshot *snapshot = ds->undo_packing.array[i];
+		struct undo_packed packed = {snapshot->image, snapshot->image_size};
+		snapshot->image = NULL;
+		da_push_back(ds->undo_packed, &packed);
+	}
+	size_t undo_count = ds->undo_packed_count;
+	for (size_t i = 0; i < ds->undo_packing.num; i++)
+		snapshot_release(ds->undo_packing.array[i]);
+	ds->undo_packing.num = 0;
+	if (!success) {
+		ds->undo_packed_count = 0;
+		return;
+	}
+	undo_clear(ds);
+	ds->undo_packed_count = undo_count;
+}
+
+/* brings the packed undo and redo steps of a released canvas back as textures */
+static void undo_unpack(struct draw_source *ds)
+{
+	if (ds->undo_packing.num) {
+		/* still packing, the textures were kept */
+		undo_pack_cancel(ds);
+		return;
+	}
+	for (size_t i = 0; i < ds->undo_packed.num; i++) {
+		struct undo_packed *packed = &ds->undo_packed.array[i];
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint8_t *pixels = qoi_decode(packed->image, packed->size, &width, &height);
+		gs_texrender_t *texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		if (pixels)
+			canvas_upload(ds, texrender, pixels, width, height);
+		bfree(pixels);
+		if (i < ds->undo_packed_count)
+			deque_push_back(&ds->undo, &texrender, sizeof(texrender));
+		else
+			deque_push_back(&ds->redo, &texrender, sizeof(texrender));
+	}
+	undo_pack_cancel(ds);
+}
+
+/* moves the canvas of a source that was not shown or rendered for release_delay seconds off the GPU, packed like a page */
+static void canvas_release(struct draw_source *ds)
+{
+	dab_flush(ds);
+	stroke_commit(ds);
+	undo_pack(ds);
+	page_park(ds);
+	gs_texrender_destroy(ds->render_b);
+	ds->render_b = NULL;
+	gs_texrender_destroy(ds->stroke_layer);
+	gs_texrender_destroy(ds->stroke_layer_grow);
+	gs_texrender_destroy(ds->shape_layer);
+	gs_texrender_destroy(ds->layers_below);
+	gs_texrender_destroy(ds->layers_above);
+	gs_texrender_destroy(ds->layers_flat);
+	vector_reset(ds);
+	ds->stroke_layer = NULL;
+	ds->stroke_layer_grow = NULL;
+	ds->shape_layer = NULL;
+	ds->layers_below = NULL;
+	ds->layers_above = NULL;
+	ds->layers_flat = NULL;
+	ds->layers_dirty = true;
+	ds->canvas_released = true;
+	page_evict(ds);
+	tile_evict(ds);
+}
+
+/* brings a released canvas back, everything that touches the canvas calls this first with the graphics lock held */
+static void canvas_acquire(struct draw_source *ds)
+{
+	if (!ds->canvas_released)
+		return;
+	ds->canvas_released = false;
+	undo_unpack(ds);
+	page_unpark(ds);
+	page_evict(ds);
+}
+
+struct page_write {
+	char *path;
+	uint8_t *image;
+	size_t size;
+};
+
+static void page_write_task(void *param)
+{
+	struct page_write *write = param;
+	snapshot_write(write->path, write->image, write->size);
+	bfree(write->path);
+	bfree(write->image);
+	bfree(write);
+}
+
+/* saves the pages that were current since the last save, packed pages are written as they are without a readback */
+static void page_save(struct draw_source *ds)
+{
+	for (uint32_t p = 0; p < PAGE_MAX; p++) {
+		struct draw_page *page = &ds->pages[p];
+		if (p == ds->page_current || !page->unsaved)
+			continue;
+		page->unsaved = false;
+		for (uint32_t i = 0; i < LAYER_MAX; i++) {
+			char *path = page_path(ds->canvas_path, p, i);
+			bool used = p < ds->page_count && i < ds->layer_count;
+			gs_texture_t *tex = used && page->layers[i] ? gs_texrender_get_texture(page->layers[i]) : NULL;
+			if (tex) {
+				struct draw_snapshot *snapshot = snapshot_create(path, true, false);
+				snapshot_stage_texture(snapshot, tex);
+				snapshot_queue(ds, snapshot);
+			} else if (used && page->packed[i]) {
+				struct page_write *write = bzalloc(sizeof(struct page_write));
+				write->path = bstrdup(path);
+				write->image = bmemdup(page->packed[i], page->packed_size[i]);
+				write->size = page->packed_size[i];
+				os_task_queue_queue_task(ds->snapshot_tasks, page_write_task, write);
+			} else if (os_file_exists(path)) {
+				os_unlink(path);
+			}
+			bfree(path);
+		}
+	}
+}
+
+static inline int32_t tile_index(int32_t v)
+{
+	return v >= 0 ? v / TILE_SIZE : -((-v + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+/* the saved tiles of an infinite canvas live in a directory next to the canvas file */
+static char *tile_dir(const char *canvas_path)
+{
+	struct dstr path = {0};
+	dstr_copy(&path, canvas_path);
+	if (path.len > 4 && astrcmpi(path.array + path.len - 4, ".qoi") == 0)
+		dstr_resize(&path, path.len - 4);
+	dstr_cat(&path, "-tiles");
+	return path.array;
+}
+
+static char *tile_path(const char *canvas_path, const struct draw_tile *tile)
+{
+	struct dstr path = {0};
+	dstr_init_move_array(&path, tile_dir(canvas_path));
+	dstr_catf(&path, "/p%u-l%u-%d_%d.qoi", tile->page + 1, tile->layer + 1, tile->x, tile->y);
+	return path.array;
+}
+
+/* the render target holding a layer of the current page, NULL for an empty layer */
+static gs_texrender_t *layer_render(struct draw_source *ds, uint32_t layer)
+{
+	if (layer == ds->layer_current)
+		return ds->render_a_active ? ds->render_a : ds->render_b;
+	return ds->layers[layer].render;
+}
+
+/* true when the tile holds something anywhere, on the GPU, packed, swapped or saved */
+static inline bool tile_used(const struct draw_tile *tile)
+{
+	return tile->render || tile->packed || tile->swapped || tile->saved || tile->prefetching;
+}
+
+static uint8_t *tile_decode(struct draw_source *ds, struct draw_tile *tile, uint32_t *width, uint32_t *height)
+{
+	if (tile->packed)
+		return qoi_decode(tile->packed, tile->packed_size, width, height);
+	const uint8_t *swapped = tile_store_swapped(ds->tiles, tile);
+	if (swapped)
+		return qoi_decode(swapped, tile->slot.size, width, height);
+	if (!tile->saved || !ds->canvas_path)
+		return NULL;
+	char *path = tile_path(ds->canvas_path, tile);
+	uint8_t *pixels = os_file_exists(path) ? canvas_read(path, width, height) : NULL;
+	bfree(path);
+	return pixels;
+}
+
+/* brings a tile onto the GPU right away, taking over a finished prefetch and dropping a running eviction */
+static void tile_restore(struct draw_source *ds, struct draw_tile *tile)
+{
+	tile->used = ++ds->tile_clock;
+	if (tile->evicting) {
+		snapshot_release(tile->evicting);
+		tile->evicting = NULL;
+		ds->tiles_evicting--;
+	}
+	if (tile->render)
+		return;
+
+	uint8_t *pixels = NULL;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	pthread_mutex_lock(&ds->snapshot_mutex);
+	if (tile->prefetching) {
+		pixels = tile->pixels;
+		width = tile->pixels_width;
+		height = tile->pixels_height;
+		tile->pixels = NULL;
+		if (!tile->prefetch_done)
+			tile->prefetch_id++;
+		tile->prefetching = false;
+		tile->prefetch_done = false;
+		ds->tiles_prefetching--;
+	}
+	pthread_mutex_unlock(&ds->snapshot_mutex);
+	if (!pixels)
+		pixels = tile_decode(ds, tile, &width, &height);
+
+	tile->render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	if (pixels) {
+		render_upload(tile->render, TILE_SIZE, TILE_SIZE, pixels, width, height);
+		bfree(pixels);
+	} else if (gs_texrender_begin(tile->render, TILE_SIZE, TILE_SIZE)) {
+		struct vec4 clear_color;
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_texrender_end(tile->render);
+	}
+	bfree(tile->packed);
+	tile->packed = NULL;
+	tile->packed_size = 0;
+	tile->swapped = false;
+}
+
+/* writes the viewport of a layer into the tiles under it, a NULL texture clears them */
+static void tile_sync(struct draw_source *ds, uint32_t layer, gs_texture_t *tex)
+{
+	int32_t cx = (int32_t)ds->size.x;
+	int32_t cy = (int32_t)ds->size.y;
+	gs_effect_t *effect = obs_get_base_effect(tex ? OBS_EFFECT_DEFAULT : OBS_EFFECT_SOLID);
+	for (int32_t y = tile_index(ds->view_y); y <= tile_index(ds->view_y + cy - 1); y++) {
+		for (int32_t x = tile_index(ds->view_x); x <= tile_index(ds->view_x + cx - 1); x++) {
+			struct draw_tile *tile = tex ? tile_store_get(ds->tiles, ds->page_current, layer, x, y)
+						     : tile_store_find(ds->tiles, ds->page_current, layer, x, y);
+			if (!tile || (!tex && !tile_used(tile)))
+				continue;
+			tile_restore(ds, tile);
+			gs_texrender_reset(tile->render);
+			if (!gs_texrender_begin(tile->render, TILE_SIZE, TILE_SIZE))
+				continue;
+			gs_blend_state_push();
+			gs_reset_blend_state();
+			gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+			float x0 = (float)x * TILE_SIZE;
+			float y0 = (float)y * TILE_SIZE;
+			gs_ortho(x0, x0 + TILE_SIZE, y0, y0 + TILE_SIZE, -100.0f, 100.0f);
+			gs_matrix_push();
+			gs_matrix_translate3f((float)ds->view_x, (float)ds->view_y, 0.0f);
+			if (tex) {
+				gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), tex);
+				while (gs_effect_loop(effect, "Draw"))
+					gs_draw_sprite(tex, 0, (uint32_t)cx, (uint32_t)cy);
+			} else {
+				struct vec4 clear_color;
+				vec4_zero(&clear_color);
+				gs_effect_set_vec4(gs_effect_get_param_by_name(effect, "color"), &clear_color);
+				while (gs_effect_loop(effect, "Solid"))
+					gs_draw_sprite(NULL, 0, (uint32_t)cx, (uint32_t)cy);
+			}
+			gs_matrix_pop();
+			gs_blend_state_pop();
+			gs_texrender_end(tile->render);
+			tile->unsaved = true;
+		}
+	}
+}
+
+/* draws the tiles of a layer under the viewport into target, creating it when needed, false when no tile holds anything */
+static bool tile_compose(struct draw_source *ds, uint32_t layer, gs_texrender_t **target)
+{
+	int32_t cx = (int32_t)ds->size.x;
+	int32_t cy = (int32_t)ds->size.y;
+	int32_t x0 = tile_index(ds->view_x);
+	int32_t y0 = tile_index(ds->view_y);
+	int32_t x1 = tile_index(ds->view_x + cx - 1);
+	int32_t y1 = tile_index(ds->view_y + cy - 1);
+
+	/* every tile is restored before the target is bound so uploads never nest inside it */
+	bool used = false;
+	for (int32_t y = y0; y <= y1; y++) {
+		for (int32_t x = x0; x <= x1; x++) {
+			struct draw_tile *tile = tile_store_find(ds->tiles, ds->page_current, layer, x, y);
+			if (!tile || !tile_used(tile))
+				continue;
+			tile_restore(ds, tile);
+			used = true;
+		}
+	}
+	if (!used && !*target)
+		return false;
+	if (!*target)
+		*target = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	gs_texrender_reset(*target);
+	if (!gs_texrender_begin(*target, (uint32_t)cx, (uint32_t)cy))
+		return used;
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	gs_ortho((float)ds->view_x, (float)(ds->view_x + cx), (float)ds->view_y, (float)(ds->view_y + cy), -100.0f, 100.0f);
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	for (int32_t y = y0; used && y <= y1; y++) {
+		for (int32_t x = x0; x <= x1; x++) {
+			struct draw_tile *tile = tile_store_find(ds->tiles, ds->page_current, layer, x, y);
+			gs_texture_t *tex = tile && tile->render ? gs_texrender_get_texture(tile->render) : NULL;
+			if (!tex)
+				continue;
+			gs_matrix_push();
+			gs_matrix_translate3f((float)x * TILE_SIZE, (float)y * TILE_SIZE, 0.0f);
+			gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), tex);
+			while (gs_effect_loop(effect, "Draw"))
+				gs_draw_sprite(tex, 0, TILE_SIZE, TILE_SIZE);
+			gs_matrix_pop();
+		}
+	}
+	gs_blend_state_pop();
+	gs_texrender_end(*target);
+	return used;
+}
+
+/* writes every layer of the current page into the tiles, before the viewport moves or the page is parked */
+static void tile_sync_layers(struct draw_source *ds)
+{
+	for (uint32_t i = 0; i < ds->layer_count; i++) {
+		gs_texrender_t *render = layer_render(ds, i);
+		tile_sync(ds, i, render ? gs_texrender_get_texture(render) : NULL);
+	}
+}
+
+/* rebuilds every layer of the current page from the tiles under the viewport */
+static void tile_compose_layers(struct draw_source *ds)
+{
+	for (uint32_t i = 0; i < ds->layer_count; i++) {
+		if (i == ds->layer_current) {
+			tile_compose(ds, i, ds->render_a_active ? &ds->render_a : &ds->render_b);
+		} else if (!tile_compose(ds, i, &ds->layers[i].render)) {
+			gs_texrender_destroy(ds->layers[i].render);
+			ds->layers[i].render = NULL;
+		}
+	}
+	ds->layers_dirty = true;
+}
+
+/* tiles from the viewport, 0 for tiles under it, a tile of another page or of a released canvas is as far as can be */
+static int32_t tile_distance(struct draw_source *ds, const struct draw_tile *tile)
+{
+	if (tile->page != ds->page_current || ds->canvas_released || !ds->infinite)
+		return INT32_MAX;
+	int32_t x0 = tile_index(ds->view_x);
+	int32_t y0 = tile_index(ds->view_y);
+	int32_t x1 = tile_index(ds->view_x + (int32_t)ds->size.x - 1);
+	int32_t y1 = tile_index(ds->view_y + (int32_t)ds->size.y - 1);
+	int32_t dx = tile->x < x0 ? x0 - tile->x : tile->x > x1 ? tile->x - x1 : 0;
+	int32_t dy = tile->y < y0 ? y0 - tile->y : tile->y > y1 ? tile->y - y1 : 0;
+	return dx > dy ? dx : dy;
+}
+
+struct tile_prefetch {
+	struct draw_source *ds;
+	struct draw_tile *tile;
+	uint32_t id;
+	uint8_t *data;
+	size_t size;
+	char *path;
+};
+
+/* decodes a tile on the worker, dropped when the tile was restored or prefetched again meanwhile */
+static void tile_prefetch_task(void *param)
+{
+	struct tile_prefetch *prefetch = param;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint8_t *pixels = NULL;
+	if (prefetch->data)
+		pixels = qoi_decode(prefetch->data, prefetch->size, &width, &height);
+	else if (prefetch->path && os_file_exists(prefetch->path))
+		pixels = canvas_read(prefetch->path, &width, &height);
+	struct draw_tile *tile = prefetch->tile;
+	pthread_mutex_lock(&prefetch->ds->snapshot_mutex);
+	if (tile->prefetching && tile->prefetch_id == prefetch->id) {
+		tile->pixels = pixels;
+		tile->pixels_width = width;
+		tile->pixels_height = height;
+		tile->prefetch_done = true;
+		pixels = NULL;
+	}
+	pthread_mutex_unlock(&prefetch->ds->snapshot_mutex);
+	bfree(pixels);
+	bfree(prefetch->data);
+	bfree(prefetch->path);
+	bfree(prefetch);
+}
+
+/* decodes the tiles around the viewport and further ahead in the direction of travel so the next pans find them resident */
+static void tile_prefetch(struct draw_source *ds, int32_t dx, int32_t dy)
+{
+	int32_t x0 = tile_index(ds->view_x) - (dx < 0 ? TILE_PREFETCH : 1);
+	int32_t y0 = tile_index(ds->view_y) - (dy < 0 ? TILE_PREFETCH : 1);
+	int32_t x1 = tile_index(ds->view_x + (int32_t)ds->size.x - 1) + (dx > 0 ? TILE_PREFETCH : 1);
+	int32_t y1 = tile_index(ds->view_y + (int32_t)ds->size.y - 1) + (dy > 0 ? TILE_PREFETCH : 1);
+	for (uint32_t layer = 0; layer < ds->layer_count; layer++) {
+		for (int32_t y = y0; y <= y1; y++) {
+			for (int32_t x = x0; x <= x1; x++) {
+				struct draw_tile *tile = tile_store_find(ds->tiles, ds->page_current, layer, x, y);
+				if (!tile || tile->render || tile->prefetching || !tile_used(tile))
+					continue;
+				struct tile_prefetch *prefetch = bzalloc(sizeof(struct tile_prefetch));
+				prefetch->ds = ds;
+				prefetch->tile = tile;
+				const uint8_t *swapped = tile_store_swapped(ds->tiles, tile);
+				if (tile->packed) {
+					prefetch->data = bmemdup(tile->packed, tile->packed_size);
+					prefetch->size = tile->packed_size;
+				} else if (swapped) {
+					prefetch->data = bmemdup(swapped, tile->slot.size);
+					prefetch->size = tile->slot.size;
+				} else if (ds->canvas_path) {
+					prefetch->path = tile_path(ds->canvas_path, tile);
+				}
+				pthread_mutex_lock(&ds->snapshot_mutex);
+				prefetch->id = ++tile->prefetch_id;
+				tile->prefetching = true;
+				pthread_mutex_unlock(&ds->snapshot_mutex);
+				ds->tiles_prefetching++;
+				os_task_queue_queue_task(ds->snapshot_tasks, tile_prefetch_task, prefetch);
+			}
+		}
+	}
+}
+
+/* packs tiles that left the prefetch ring into memory and pages the packed ones that moved further away out to the swap file */
+static void tile_evict(struct draw_source *ds)
+{
+	if (!ds->tiles)
+		return;
+	for (size_t i = 0; i < tile_store_count(ds->tiles); i++) {
+		struct draw_tile *tile = tile_store_at(ds->tiles, i);
+		int32_t distance = tile_distance(ds, tile);
+		if (tile->render && !tile->evicting && distance > TILE_PREFETCH) {
+			gs_texture_t *tex = gs_texrender_get_texture(tile->render);
+			if (!tex)
+				continue;
+			tile->evicting = snapshot_create(NULL, true, true);
+			tile->evicting->keep = true;
+			snapshot_stage_texture(tile->evicting, tex);
+			snapshot_queue(ds, tile->evicting);
+			ds->tiles_evicting++;
+		} else if (!tile->render && tile->packed && distance > TILE_RAM_RADIUS) {
+			tile_store_swap_out(ds->tiles, tile);
+		}
+	}
+}
+
+/* uploads finished prefetches and finishes evictions whose readback and encode completed */
+static void tile_tick(struct draw_source *ds)
+{
+	for (size_t i = 0; i < tile_store_count(ds->tiles); i++) {
+		struct draw_tile *tile = tile_store_at(ds->tiles, i);
+		if (tile->prefetching) {
+			pthread_mutex_lock(&ds->snapshot_mutex);
+			bool done = tile->prefetch_done;
+			uint8_t *pixels = tile->pixels;
+			tile->pixels = NULL;
+			if (done) {
+				tile->prefetching = false;
+				tile->prefetch_done = false;
+			}
+			pthread_mutex_unlock(&ds->snapshot_mutex);
+			if (done) {
+				ds->tiles_prefetching--;
+				if (pixels && !tile->render) {
+					tile->render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+					render_upload(tile->render, TILE_SIZE, TILE_SIZE, pixels, tile->pixels_width,
+						      tile->pixels_height);
+					bfree(tile->packed);
+					tile->packed = NULL;
+					tile->packed_size = 0;
+					tile->swapped = false;
+					tile->used = ++ds->tile_clock;
+				}
+				bfree(pixels);
+			}
+		}
+		if (tile->evicting && os_event_try(tile->evicting->done) == 0) {
+			if (tile->evicting->success && tile->evicting->empty) {
+				/* a blank tile holds nothing, a file saved for it earlier is removed by the next save */
+				gs_texrender_destroy(tile->render);
+				tile->render = NULL;
+				tile->swapped = false;
+				tile->unsaved = tile->unsaved || tile->saved;
+				tile->saved = false;
+			} else if (tile->evicting->success) {
+				tile->packed = tile->evicting->image;
+				tile->packed_size = tile->evicting->image_size;
+				tile->evicting->image = NULL;
+				gs_texrender_destroy(tile->render);
+				tile->render = NULL;
+				if (tile_distance(ds, tile) > TILE_RAM_RADIUS)
+					tile_store_swap_out(ds->tiles, tile);
+			}
+			snapshot_release(tile->evicting);
+			tile->evicting = NULL;
+			ds->tiles_evicting--;
+		}
+	}
+}
+
+/* moves the viewport of an infinite canvas, the undo history covers the viewport so it is dropped like on a page switch */
+static void view_pan(struct draw_source *ds, int32_t x, int32_t y)
+{
+	if (!ds->infinite || !ds->tiles || (x == ds->view_x && y == ds->view_y))
+		return;
+	canvas_acquire(ds);
+	dab_flush(ds);
+	stroke_commit(ds);
+	obs_data_t *event = record_action(ds, "pan");
+	if (event) {
+		obs_data_set_int(event, "x", x);
+		obs_data_set_int(event, "y", y);
+	}
+	undo_clear(ds);
+
+	tile_sync_layers(ds);
+	int32_t dx = x - ds->view_x;
+	int32_t dy = y - ds->view_y;
+	ds->view_x = x;
+	ds->view_y = y;
+	tile_compose_layers(ds);
+	tile_prefetch(ds, dx, dy);
+	tile_evict(ds);
+	ds->journal_checkpoint_due = true;
+	vector_stale(ds);
+	os_atomic_inc_long(&ds->canvas_version);
+}
+
+static void view_remember(struct draw_source *ds)
+{
+	obs_data_t *settings = obs_source_get_settings(ds->source);
+	obs_data_set_int(settings, "view_x", ds->view_x);
+	obs_data_set_int(settings, "view_y", ds->view_y);
+	obs_data_release(settings);
+}
+
+/* pans like view_pan and keeps the settings in step so the next update does not pan back, replayed pans apply right away */
+static void view_ingest(struct draw_source *ds, int32_t x, int32_t y)
+{
+	if (!ds->infinite)
+		return;
+	obs_enter_graphics();
+	ds->view_pending = false;
+	view_pan(ds, x, y);
+	obs_leave_graphics();
+	view_remember(ds);
+}
+
+/* collects a pan from the wheel or the pan proc, every sync and compose of the tiles happens once in view_tick */
+static void view_request(struct draw_source *ds, int32_t x, int32_t y)
+{
+	if (!ds->infinite)
+		return;
+	obs_enter_graphics();
+	ds->view_target_x = x;
+	ds->view_target_y = y;
+	ds->view_pending = true;
+	obs_leave_graphics();
+}
+
+static void view_tick(struct draw_source *ds)
+{
+	obs_enter_graphics();
+	bool pending = ds->view_pending;
+	ds->view_pending = false;
+	if (pending)
+		view_pan(ds, ds->view_target_x, ds->view_target_y);
+	obs_leave_graphics();
+	if (pending)
+		view_remember(ds);
+}
+
+/* pans to "x" and "y" or by "dx" and "dy" and reports the viewport now shown */
+void pan_proc_handler(void *param, calldata_t *cd)
+{
+	struct draw_source *ds = param;
+	if (shared_forward(ds, "pan", cd))
+		return;
+	obs_data_t *data = calldata_ptr(cd, "data");
+	obs_data_t *response = calldata_ptr(cd, "response");
+
+	/* relative moves add up on a pan that is still waiting for the tick */
+	obs_enter_graphics();
+	int32_t x = ds->view_pending ? ds->view_target_x : ds->view_x;
+	int32_t y = ds->view_pending ? ds->view_target_y : ds->view_y;
+	if (data && obs_data_has_user_value(data, "x"))
+		x = (int32_t)obs_data_get_int(data, "x");
+	else if (data)
+		x += (int32_t)obs_data_get_int(data, "dx");
+	if (data && obs_data_has_user_value(data, "y"))
+		y = (int32_t)obs_data_get_int(data, "y");
+	else if (data)
+		y += (int32_t)obs_data_get_int(data, "dy");
+	view_request(ds, x, y);
+	obs_leave_graphics();
+	if (!response)
+		return;
+	obs_data_set_bool(response, "success", ds->infinite);
+	if (!ds->infinite)
+		obs_data_set_string(response, "error", "not an infinite canvas");
+	obs_data_set_int(response, "x", x);
+	obs_data_set_int(response, "y", y);
+}
+
+/* registers the tiles saved next to the canvas file, their images are only read when they come into view */
+static void tile_scan(struct draw_source *ds)
+{
+	if (!ds->canvas_path)
+		return;
+	char *dir = tile_dir(ds->canvas_path);
+	os_dir_t *d = os_opendir(dir);
+	bfree(dir);
+	if (!d)
+		return;
+	struct os_dirent *entry;
+	while ((entry = os_readdir(d)) != NULL) {
+		uint32_t page;
+		uint32_t layer;
+		int32_t x;
+		int32_t y;
+		if (entry->directory || sscanf(entry->d_name, "p%u-l%u-%d_%d.qoi", &page, &layer, &x, &y) != 4)
+			continue;
+		if (page < 1 || page > PAGE_MAX || layer < 1 || layer > LAYER_MAX)
+			continue;
+		tile_store_get(ds->tiles, page - 1, layer - 1, x, y)->saved = true;
+	}
+	os_closedir(d);
+}
+
+/* saves the tiles changed since the last save, packed and swapped tiles are written as they are without a readback */
+static void tile_save(struct draw_source *ds)
+{
+	if (!ds->tiles || !ds->canvas_path)
+		return;
+	char *dir = tile_dir(ds->canvas_path);
+	bool dir_made = false;
+	for (size_t i = 0; i < tile_store_count(ds->tiles); i++) {
+		struct draw_tile *tile = tile_store_at(ds->tiles, i);
+		if (!tile->unsaved)
+			continue;
+		if (!dir_made) {
+			os_mkdirs(dir);
+			dir_made = true;
+		}
+		tile->unsaved = false;
+		tile->saved = true;
+		char *path = tile_path(ds->canvas_path, tile);
+		const uint8_t *swapped = tile_store_swapped(ds->tiles, tile);
+		gs_texture_t *tex = tile->render ? gs_texrender_get_texture(tile->render) : NULL;
+		if (tex) {
+			/* most tiles a pan touched stay blank, those are not written */
+			struct draw_snapshot *snapshot = snapshot_create(path, true, false);
+			snapshot->skip_empty = true;
+			snapshot_stage_texture(snapshot, tex);
+			snapshot_queue(ds, snapshot);
+		} else if (tile->packed || swapped) {
+			struct page_write *write = bzalloc(sizeof(struct page_write));
+			write->path = bstrdup(path);
+			write->size = tile->packed ? tile->packed_size : tile->slot.size;
+			write->image = bmemdup(tile->packed ? tile->packed : swapped, write->size);
+			os_task_queue_queue_task(ds->snapshot_tasks, page_write_task, write);
+		} else {
+			tile->saved = false;
+			if (os_file_exists(path))
+				os_unlink(path);
+		}
+		bfree(path);
+	}
+	bfree(dir);
+}
+
+struct canvas_save {
+	struct draw_source *ds;
+	long version;
+};
+
+static void canvas_save_finished(void *param, bool success)
+{
+	struct canvas_save *save = param;
+	if (success)
+		os_atomic_set_long(&save->ds->canvas_saved_version, save->version);
+	bfree(save);
+}
+
+/* the canvas file of a new source, in a folder of the scene collection it belongs to */
+static char *canvas_default_path(struct draw_source *ds)
+{
+	char *collection = obs_frontend_get_current_scene_collection();
+	struct dstr name = {0};
+	dstr_copy(&name, "canvas/");
+	for (const char *c = collection ? collection : ""; *c; c++) {
+		bool safe = isalnum((unsigned char)*c) || *c == '-' || *c == '_' || *c == ' ';
+		dstr_cat_ch(&name, safe ? *c : '_');
+	}
+	bfree(collection);
+	dstr_catf(&name, "/%s.qoi", obs_source_get_uuid(ds->source));
+	char *path = obs_module_config_path(name.array);
+	dstr_free(&name);
+	return path;
+}
+
+/* deletes the canvas file and everything saved next to it, only for files this source named after itself */
+static void canvas_remove_files(struct draw_source *ds)
+{
+	if (!ds->canvas_path)
+		return;
+	const char *slash = strrchr(ds->canvas_path, '/');
+	const char *file = slash ? slash + 1 : ds->canvas_path;
+	const char *uuid = obs_source_get_uuid(ds->source);
+	size_t len = uuid ? strlen(uuid) : 0;
+	if (!len || strncmp(file, uuid, len) != 0 || astrcmpi(file + len, ".qoi") != 0)
+		return;
+	os_unlink(ds->canvas_path);
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		char *path = layer_path(ds->canvas_path, i);
+		os_unlink(path);
+		bfree(path);
+		for (uint32_t p = 0; p < PAGE_MAX; p++) {
+			path = page_path(ds->canvas_path, p, i);
+			os_unlink(path);
+			bfree(path);
+		}
+	}
+	char *dir = tile_dir(ds->canvas_path);
+	os_dir_t *d = os_opendir(dir);
+	if (d) {
+		struct dstr path = {0};
+		struct os_dirent *entry;
+		while ((entry = os_readdir(d)) != NULL) {
+			if (entry->directory)
+				continue;
+			dstr_printf(&path, "%s/%s", dir, entry->d_name);
+			os_unlink(path.array);
+		}
+		dstr_free(&path);
+		os_closedir(d);
+		os_rmdir(dir);
+	}
+	bfree(dir);
+}
+
+/* queues an asynchronous QOI save of the canvas when it changed since the last successful save */
+static void ds_save(void *data, obs_data_t *settings)
+{
+	struct draw_source *ds = data;
+	long version = os_atomic_load_long(&ds->canvas_version);
+	if (version == os_atomic_load_long(&ds->canvas_saved_version))
+		return;
+
+	if (!ds->canvas_path) {
+		char *path = canvas_default_path(ds);
+		if (!path)
+			return;
+		struct dstr dir = {0};
+		dstr_copy(&dir, path);
+		char *slash = strrchr(dir.array, '/');
+		if (slash)
+			*slash = 0;
+		os_mkdirs(dir.array);
+		dstr_free(&dir);
+		pthread_mutex_lock(&ds->snapshot_mutex);
+		ds->canvas_path = path;
+		pthread_mutex_unlock(&ds->snapshot_mutex);
+	}
+	struct draw_snapshot *snapshot = snapshot_create(ds->canvas_path, true, false);
+	struct canvas_save *save = bzalloc(sizeof(struct canvas_save));
+	save->ds = ds;
+	save->version = version;
+	snapshot->finished = canvas_save_finished;
+	snapshot->finished_param = save;
+	snapshot_queue(ds, snapshot);
+	obs_data_set_string(settings, "canvas_file", ds->canvas_path);
+
+	/* the other layers are saved next to the canvas file when they changed since they were last current,
+	 * a released canvas keeps them in its page slot so they wait until it is back */
+	obs_enter_graphics();
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		if (ds->canvas_released || i == ds->layer_current || !ds->layers[i].unsaved)
+			continue;
+		ds->layers[i].unsaved = false;
+		char *path = layer_path(ds->canvas_path, i);
+		if (ds->layers[i].render && i < ds->layer_count) {
+			struct draw_snapshot *snapshot = snapshot_create(path, true, false);
+			snapshot->layer = (int)i;
+			snapshot_queue(ds, snapshot);
+		} else if (os_file_exists(path)) {
+			os_unlink(path);
+		}
+		bfree(path);
+	}
+	page_save(ds);
+	tile_save(ds);
 	obs_leave_graphics();
+}
+
+/* loads the shared shader on first use, must be called with the graphics lock held which also guards it */
+static const struct draw_shader *draw_shader_load(void)
+{
+	if (shader_cache.effect)
+		return &shader_cache;
+
+	char *effect_path = obs_module_file("effects/draw.effect");
+	gs_effect_t *effect = gs_effect_create_from_file(effect_path, NULL);
 	bfree(effect_path);
+	if (!effect)
+		return &shader_cache;
+
+	shader_cache.image_param = gs_effect_get_param_by_name(effect, "image");
+	shader_cache.uv_size_param = gs_effect_get_param_by_name(effect, "uv_size");
+	shader_cache.uv_mouse_param = gs_effect_get_param_by_name(effect, "uv_mouse");
+	shader_cache.uv_mouse_previous_param = gs_effect_get_param_by_name(effect, "uv_mouse_previous");
+	shader_cache.draw_cursor_param = gs_effect_get_param_by_name(effect, "draw_cursor");
+	shader_cache.cursor_color_param = gs_effect_get_param_by_name(effect, "cursor_color");
+	shader_cache.cursor_size_param = gs_effect_get_param_by_name(effect, "cursor_size");
+	shader_cache.cursor_image_param = gs_effect_get_param_by_name(effect, "cursor_image");
+	shader_cache.cursor_frame_param = gs_effect_get_param_by_name(effect, "cursor_frame");
+	shader_cache.tool_param = gs_effect_get_param_by_name(effect, "tool");
+	shader_cache.tool_image_param = gs_effect_get_param_by_name(effect, "tool_image");
+	shader_cache.tool_image_size_param = gs_effect_get_param_by_name(effect, "tool_image_size");
+	shader_cache.brush_tip_param = gs_effect_get_param_by_name(effect, "brush_tip");
+	shader_cache.brush_tip_size_param = gs_effect_get_param_by_name(effect, "brush_tip_size");
+	shader_cache.stamp_rects_param = gs_effect_get_param_by_name(effect, "stamp_rects");
+	shader_cache.image_rect_param = gs_effect_get_param_by_name(effect, "image_rect");
+	shader_cache.dabs_param = gs_effect_get_param_by_name(effect, "dabs");
+	shader_cache.dab_count_param = gs_effect_get_param_by_name(effect, "dab_count");
+	shader_cache.stroke_layer_param = gs_effect_get_param_by_name(effect, "stroke_layer");
+	shader_cache.stroke_rect_param = gs_effect_get_param_by_name(effect, "stroke_rect");
+	shader_cache.stroke_color_param = gs_effect_get_param_by_name(effect, "stroke_color");
+	shader_cache.stroke_segment_param = gs_effect_get_param_by_name(effect, "stroke_segment");
+	shader_cache.fill_seed_param = gs_effect_get_param_by_name(effect, "fill_seed");
+	shader_cache.fill_tolerance_param = gs_effect_get_param_by_name(effect, "fill_tolerance");
+	shader_cache.fill_cell_param = gs_effect_get_param_by_name(effect, "fill_cell");
+	shader_cache.float_image_param = gs_effect_get_param_by_name(effect, "float_image");
+	shader_cache.float_rect_param = gs_effect_get_param_by_name(effect, "float_rect");
+	shader_cache.float_transform_param = gs_effect_get_param_by_name(effect, "float_transform");
+	shader_cache.float_angle_param = gs_effect_get_param_by_name(effect, "float_angle");
+	shader_cache.preview_rect_param = gs_effect_get_param_by_name(effect, "preview_rect");
+	shader_cache.layer_opacity_param = gs_effect_get_param_by_name(effect, "layer_opacity");
+	shader_cache.tool_color_param = gs_effect_get_param_by_name(effect, "tool_color");
+	shader_cache.tool_size_param = gs_effect_get_param_by_name(effect, "tool_size");
+	shader_cache.tool_size_from_param = gs_effect_get_param_by_name(effect, "tool_size_from");
+	shader_cache.tool_mode_param = gs_effect_get_param_by_name(effect, "tool_mode");
+	shader_cache.shift_down_param = gs_effect_get_param_by_name(effect, "shift_down");
+	shader_cache.select_from_param = gs_effect_get_param_by_name(effect, "select_from");
+	shader_cache.select_to_param = gs_effect_get_param_by_name(effect, "select_to");
+	shader_cache.effect = effect;
+	return &shader_cache;
+}
+
+static void draw_shader_warm_up_task(void *param)
+{
+	UNUSED_PARAMETER(param);
+	obs_enter_graphics();
+	draw_shader_load();
+	obs_leave_graphics();
+}
+
+void draw_shader_warm_up(void)
+{
+	obs_queue_task(OBS_TASK_GRAPHICS, draw_shader_warm_up_task, NULL, false);
+}
+
+static void ds_frontend_event(enum obs_frontend_event event, void *data)
+{
+	struct draw_source *context = data;
+	if (event == OBS_FRONTEND_EVENT_SCENE_CHANGED) {
+		if (context->clear_on_transition) {
+			draw_clear(context);
+		}
+	} else if (event == OBS_FRONTEND_EVENT_SCENE_COLLECTION_CHANGING || event == OBS_FRONTEND_EVENT_SCENE_COLLECTION_CLEANUP ||
+		   event == OBS_FRONTEND_EVENT_EXIT) {
+		context->collection_closing = true;
+	}
+}
+
+/* a source deleted by the user, unlike one whose scene collection is closed, does not keep its files */
+static void ds_source_remove(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct draw_source *context = data;
+	if (!context->collection_closing)
+		context->removed = true;
+}
+
+static void *ds_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct draw_source *context = bzalloc(sizeof(struct draw_source));
+	context->source = source;
+	context->rendered = obs_get_video_frame_time();
+
+	context->tablet_factor = 1.0f;
+	context->max_undo = 10;
+	context->size.x = (float)obs_data_get_int(settings, "width");
+	context->size.y = (float)obs_data_get_int(settings, "height");
+	vec4_from_rgba_srgb(&context->cursor_color, 0xFFFFFF00);
+	context->cursor_size = 10;
+
+	context->show_mouse = true;
+	context->vector_stale = true;
+	context->vector_selected = STROKE_INDEX_NONE;
+
+	pthread_mutex_init(&context->stroke_mutex, NULL);
+	pthread_mutex_init(&context->image_mutex, NULL);
+	vec4_set(&context->stamp_rects[0], 0.0f, 0.0f, 1.0f, 1.0f);
+	pthread_mutex_init(&context->snapshot_mutex, NULL);
+	context->snapshot_tasks = os_task_queue_create();
+	pthread_mutex_init(&context->shared_mutex, NULL);
+
+	obs_enter_graphics();
+	context->shader = draw_shader_load();
+	brush_tip_addref();
+	obs_leave_graphics();
 
 	proc_handler_t *ph = obs_source_get_proc_handler(source);
 	proc_handler_add(ph, "void clear()", clear_proc_handler, context);
+	proc_handler_add(ph, "void clear_layer(in int layer)", clear_layer_proc_handler, context);
 	proc_handler_add(ph, "void draw(in ptr data)", draw_proc_handler, context);
+	proc_handler_add(ph, "void ingest(in ptr data)", ingest_proc_handler, context);
 	proc_handler_add(ph, "void undo()", undo_proc_handler, context);
 	proc_handler_add(ph, "void redo()", redo_proc_handler, context);
 	proc_handler_add(ph, "void tablet(in int posx, in int posy, in float pressure)", tablet_proc_handler, context);
+	proc_handler_add(ph, "void begin_stroke(in ptr data, in ptr response)", begin_stroke_proc_handler, context);
+	proc_handler_add(ph, "void append_stroke(in ptr data, in ptr response)", append_stroke_proc_handler, context);
+	proc_handler_add(ph, "void end_stroke(in ptr data, in ptr response)", end_stroke_proc_handler, context);
+	proc_handler_add(ph, "void snapshot(in ptr data, in ptr response)", snapshot_proc_handler, context);
+	proc_handler_add(ph, "void page(in ptr data, in ptr response)", page_proc_handler, context);
+	proc_handler_add(ph, "void pan(in ptr data, in ptr response)", pan_proc_handler, context);
+	proc_handler_add(ph, "void erase_stroke(in ptr data, in ptr response)", erase_stroke_proc_handler, context);
+
+	struct dstr journal_dir = {0};
+	dstr_printf(&journal_dir, "journal/%s", obs_source_get_uuid(source));
+	context->journal_dir = obs_module_config_path(journal_dir.array);
+	dstr_free(&journal_dir);
+	context->journal_recover = obs_data_get_bool(settings, "journal");
+	const char *canvas_file = obs_data_get_string(settings, "canvas_file");
+	if (canvas_file && *canvas_file)
+		context->canvas_path = bstrdup(canvas_file);
+	context->canvas_loading = context->canvas_path || context->journal_recover;
+	obs_frontend_add_event_callback(ds_frontend_event, context);
+	signal_handler_connect(obs_source_get_signal_handler(source), "remove", ds_source_remove, context);
 
 	obs_source_update(source, NULL);
+
+	if (context->canvas_loading)
+		os_task_queue_queue_task(context->snapshot_tasks, canvas_load_task, context);
 	return context;
 }
 
-static void ds_frontend_event(enum obs_frontend_event event, void *data)
+static void stamp_atlas_free(struct stamp_atlas *atlas)
 {
-	struct draw_source *context = data;
-	if (event == OBS_FRONTEND_EVENT_SCENE_CHANGED) {
-		if (context->clear_on_transition) {
-			draw_clear(context);
-		}
-	}
+	if (!atlas)
+		return;
+	for (uint32_t i = 0; i < atlas->levels; i++)
+		bfree(atlas->data[i]);
+	bfree(atlas);
 }
 
 static void ds_destroy(void *data)
 {
 	struct draw_source *context = data;
 	obs_frontend_remove_event_callback(ds_frontend_event, data);
+	signal_handler_disconnect(obs_source_get_signal_handler(context->source), "remove", ds_source_remove, context);
+	patches_flush(context);
+	obs_data_array_release(take_events(context));
+	obs_source_t *shown = obs_weak_source_get_source(context->shared_shown);
+	if (shown)
+		obs_source_dec_showing(shown);
+	obs_source_release(shown);
+	obs_weak_source_release(context->shared_shown);
+	obs_weak_source_release(context->shared_canvas);
+	bfree(context->shared_name);
+	if (context->snapshots.num) {
+		/* read back pending snapshots right away so a canvas saved just before shutdown is not lost */
+		obs_enter_graphics();
+		for (size_t i = 0; i < context->snapshots.num; i++) {
+			if (!context->snapshots.array[i]->stagesurf)
+				snapshot_stage(context, context->snapshots.array[i]);
+			snapshot_read(context, context->snapshots.array[i]);
+		}
+		context->snapshots.num = 0;
+		obs_leave_graphics();
+	}
 	bool graphics = false;
 	if (context->undo.size) {
 		graphics = true;
@@ -374,91 +4247,855 @@ static void ds_destroy(void *data)
 		deque_pop_front(&context->redo, &texrender, sizeof(texrender));
 		gs_texrender_destroy(texrender);
 	}
-	deque_free(&context->redo);
-	if (context->render_a) {
-		if (!graphics) {
-			graphics = true;
-			obs_enter_graphics();
+	deque_free(&context->redo);
+	if (context->render_a) {
+		if (!graphics) {
+			graphics = true;
+			obs_enter_graphics();
+		}
+		gs_texrender_destroy(context->render_a);
+	}
+	if (context->render_b) {
+		if (!graphics) {
+			graphics = true;
+			obs_enter_graphics();
+		}
+		gs_texrender_destroy(context->render_b);
+	}
+	if (context->stamp_atlas) {
+		if (!graphics) {
+			graphics = true;
+			obs_enter_graphics();
+		}
+		gs_texture_destroy(context->stamp_atlas);
+	}
+	if (context->stroke_layer || context->stroke_layer_grow || context->fill_probe || context->float_layer ||
+	    context->shape_layer) {
+		if (!graphics) {
+			graphics = true;
+			obs_enter_graphics();
+		}
+		gs_texrender_destroy(context->stroke_layer);
+		gs_texrender_destroy(context->stroke_layer_grow);
+		gs_texrender_destroy(context->fill_probe);
+		gs_stagesurface_destroy(context->fill_probe_surf);
+		gs_texrender_destroy(context->float_layer);
+		gs_texrender_destroy(context->shape_layer);
+	}
+	if (!graphics) {
+		graphics = true;
+		obs_enter_graphics();
+	}
+	gs_texrender_destroy(context->patch_layer);
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		gs_texrender_destroy(context->layers[i].render);
+		bfree(context->layer_pixels[i]);
+	}
+	gs_texrender_destroy(context->layers_below);
+	gs_texrender_destroy(context->layers_above);
+	gs_texrender_destroy(context->layers_flat);
+	vector_reset(context);
+	for (uint32_t i = 0; i < PAGE_MAX; i++)
+		page_discard(context, &context->pages[i]);
+	for (size_t i = 0; context->tiles && i < tile_store_count(context->tiles); i++) {
+		struct draw_tile *tile = tile_store_at(context->tiles, i);
+		gs_texrender_destroy(tile->render);
+		tile->render = NULL;
+		snapshot_release(tile->evicting);
+		tile->evicting = NULL;
+	}
+	brush_tip_release();
+	obs_leave_graphics();
+	image_cache_release(context->tool_image);
+	image_cache_release(context->tool_image_pending);
+	image_cache_release(context->cursor_image);
+	image_cache_release(context->cursor_image_pending);
+	for (size_t i = 0; i < context->stamps_pending_count; i++)
+		image_cache_release(context->stamps_pending[i]);
+	dstr_free(&context->stamp_files);
+	journal_stop(context, context->removed);
+	os_task_queue_destroy(context->snapshot_tasks);
+	for (uint32_t i = 0; i < LAYER_MAX; i++)
+		bfree(context->page_pixels[i]);
+	undo_pack_cancel(context);
+	da_free(context->undo_packing);
+	da_free(context->undo_packed);
+	tile_store_destroy(context->tiles);
+	stamp_atlas_free(context->stamps_built);
+	if (context->removed)
+		canvas_remove_files(context);
+	bfree(context->journal_dir);
+	obs_data_array_release(context->journal_replay);
+	da_free(context->snapshots);
+	for (size_t i = 0; i < context->snapshot_results.num; i++)
+		snapshot_release(context->snapshot_results.array[i]);
+	da_free(context->snapshot_results);
+	bfree(context->canvas_path);
+	bfree(context->canvas_pixels);
+	pthread_mutex_destroy(&context->snapshot_mutex);
+	pthread_mutex_destroy(&context->shared_mutex);
+	if (context->tool_image_path)
+		bfree(context->tool_image_path);
+	if (context->cursor_image_path)
+		bfree(context->cursor_image_path);
+	da_free(context->stroke_queue);
+	da_free(context->record_points);
+	da_free(context->dabs);
+	da_free(context->vector_objects);
+	da_free(context->patches);
+	obs_data_array_release(context->events);
+	pthread_mutex_destroy(&context->stroke_mutex);
+	pthread_mutex_destroy(&context->image_mutex);
+	bfree(context);
+}
+
+static uint32_t ds_get_width(void *data)
+{
+	struct draw_source *context = data;
+	return (uint32_t)context->size.x;
+}
+
+static uint32_t ds_get_height(void *data)
+{
+	struct draw_source *context = data;
+	return (uint32_t)context->size.y;
+}
+
+/* the owner draws its composite once for every reference showing it, the canvas work is only done once */
+static void shared_render(struct draw_source *ds)
+{
+	obs_source_t *owner = shared_owner(ds);
+	if (!owner)
+		return;
+	gs_matrix_push();
+	gs_matrix_translate3f(ds->shared_offset.x, ds->shared_offset.y, 0.0f);
+	gs_matrix_rotaa4f(0.0f, 0.0f, 1.0f, ds->shared_rotation);
+	gs_matrix_scale3f(ds->shared_scale, ds->shared_scale, 1.0f);
+	obs_source_video_render(owner);
+	gs_matrix_pop();
+	obs_source_release(owner);
+}
+
+static void ds_video_render(void *data, gs_effect_t *effect)
+{
+	UNUSED_PARAMETER(effect);
+	struct draw_source *ds = data;
+	if (ds->shared) {
+		shared_render(ds);
+		return;
+	}
+	ds->rendered = obs_get_video_frame_time();
+	canvas_acquire(ds);
+	if (!ds->render_a && !ds->render_b)
+		return;
+	if (!ds->shader->effect)
+		return;
+
+	if (ds->canvas_loading && os_atomic_load_bool(&ds->canvas_loaded))
+		canvas_restore(ds);
+	dab_flush(ds);
+
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (ds->layers_dirty)
+		layers_rebuild(ds);
+	if (ds->layers_below_used)
+		layers_draw_premultiplied(gs_texrender_get_texture(ds->layers_below), "DrawAlphaDivide", (uint32_t)ds->size.x,
+					  (uint32_t)ds->size.y);
+
+	struct draw_layer *layer = &ds->layers[ds->layer_current];
+	struct vec4 preview;
+	if (!layer->visible || layer->opacity <= 0.0f) {
+		/* a hidden current layer is not drawn, not even the tool */
+	} else if (tex && shape_rect(ds, &preview)) {
+		/* the canvas leaves the shape bounds out and one quad draws them with the shape, the canvas is not written */
+		draw_effect_params(ds, tex, ds->mouse_active && ds->show_mouse);
+		gs_effect_set_vec4(ds->shader->preview_rect_param, &preview);
+		gs_effect_set_float(ds->shader->layer_opacity_param, layer->opacity);
+		while (gs_effect_loop(ds->shader->effect, "Draw"))
+			gs_draw_sprite(tex, 0, (uint32_t)ds->size.x, (uint32_t)ds->size.y);
+		gs_matrix_push();
+		gs_matrix_translate3f(preview.x, preview.y, 0.0f);
+		while (gs_effect_loop(ds->shader->effect, "Shape"))
+			gs_draw_sprite(tex, 0, (uint32_t)preview.z, (uint32_t)preview.w);
+		gs_matrix_pop();
+	} else if (tex) {
+		draw_effect_params(ds, tex, ds->mouse_active && ds->show_mouse);
+		gs_effect_set_float(ds->shader->layer_opacity_param, layer->opacity);
+		while (gs_effect_loop(ds->shader->effect, "Draw"))
+			gs_draw_sprite(tex, 0, (uint32_t)ds->size.x, (uint32_t)ds->size.y);
+		if ((ds->tool == TOOL_SELECT_RECTANGLE || ds->tool == TOOL_SELECT_ELLIPSE) && ds->tool_mode != TOOL_DOWN)
+			float_render(ds);
+	}
+
+	if (ds->layers_above_used)
+		layers_draw_premultiplied(gs_texrender_get_texture(ds->layers_above), "DrawAlphaDivide", (uint32_t)ds->size.x,
+					  (uint32_t)ds->size.y);
+}
+
+static uint32_t stamp_hash(float x, float y)
+{
+	uint32_t h = (uint32_t)(int32_t)x * 73856093u ^ (uint32_t)(int32_t)y * 19349663u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	return h ^ (h >> 15);
+}
+
+/* picks the stamp of the next placement, random picks hash the position so replayed strokes place the same stamps */
+static uint32_t stamp_select(struct draw_source *ds, float x, float y, float pressure)
+{
+	uint32_t count = (uint32_t)ds->stamp_count;
+	if (count < 2)
+		return 0;
+	uint32_t index;
+	if (ds->stamp_mode == STAMP_RANDOM) {
+		index = stamp_hash(x, y) % count;
+	} else if (ds->stamp_mode == STAMP_PRESSURE) {
+		index = pressure <= 0.0f ? 0 : (uint32_t)(pressure * (float)count);
+		if (index >= count)
+			index = count - 1;
+	} else {
+		index = ds->stamp_next++ % count;
+	}
+	return index;
+}
+
+static void dab_push(struct draw_source *ds, float x, float y, float pressure)
+{
+	struct vec4 *dab = da_push_back_new(ds->dabs);
+	vec4_set(dab, x, y, ds->tool_size * pressure, (float)stamp_select(ds, x, y, pressure));
+}
+
+/* places dabs every stamp_spacing percent of the tool size along the segment, the leftover distance carries to the next one */
+static void dab_queue(struct draw_source *ds)
+{
+	float pressure = ds->tablet_factor;
+	if (ds->mouse_previous_pos.x < 0.0f || ds->mouse_previous_pos.y < 0.0f) {
+		ds->stamp_next = 0;
+		dab_push(ds, ds->mouse_pos.x, ds->mouse_pos.y, pressure);
+		ds->dab_distance = 0.0f;
+		ds->dab_pressure = pressure;
+		return;
+	}
+
+	float spacing = ds->tool_size * ds->stamp_spacing / 100.0f;
+	if (spacing < 1.0f)
+		spacing = 1.0f;
+	float dx = ds->mouse_pos.x - ds->mouse_previous_pos.x;
+	float dy = ds->mouse_pos.y - ds->mouse_previous_pos.y;
+	float length = sqrtf(dx * dx + dy * dy);
+	float t = spacing - ds->dab_distance;
+	for (; t <= length; t += spacing) {
+		float f = length > 0.0f ? t / length : 1.0f;
+		dab_push(ds, ds->mouse_previous_pos.x + dx * f, ds->mouse_previous_pos.y + dy * f,
+			 ds->dab_pressure + (pressure - ds->dab_pressure) * f);
+	}
+	ds->dab_distance = length - (t - spacing);
+	ds->dab_pressure = pressure;
+}
+
+/* renders the tool into the inactive canvas and flips, called with the graphics lock held */
+static void canvas_pass(struct draw_source *ds, const char *technique)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (!tex)
+		return;
+	gs_texrender_reset(ds->render_a_active ? ds->render_b : ds->render_a);
+	if (gs_texrender_begin(ds->render_a_active ? ds->render_b : ds->render_a, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
+		gs_blend_state_push();
+		gs_reset_blend_state();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+		gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
+		const struct vec4 *clip = &ds->replay_clip;
+		if (clip->z > 0.0f) {
+			/* only the clip of the other half is drawn, the rest keeps what it held and is not read */
+			draw_effect_params(ds, tex, false);
+			gs_matrix_push();
+			gs_matrix_translate3f(clip->x, clip->y, 0.0f);
+			while (gs_effect_loop(ds->shader->effect, technique))
+				gs_draw_sprite_subregion(tex, 0, (uint32_t)clip->x, (uint32_t)clip->y, (uint32_t)clip->z,
+							 (uint32_t)clip->w);
+			gs_matrix_pop();
+		} else {
+			draw_effect(ds, tex, false, technique);
+		}
+		gs_blend_state_pop();
+		gs_texrender_end(ds->render_a_active ? ds->render_b : ds->render_a);
+	}
+	ds->render_a_active = !ds->render_a_active;
+	os_atomic_inc_long(&ds->canvas_version);
+}
+
+/* draws queued dabs in passes of DAB_BATCH, called with the graphics lock held before anything reads the canvas */
+/* each pass only draws the bounds of its batch, inside a replay clip only the part of them within the clip */
+static void dab_flush(struct draw_source *ds)
+{
+	if (!ds->dabs.num)
+		return;
+
+	uint32_t tool = ds->tool;
+	uint32_t tool_mode = ds->tool_mode;
+	struct vec4 clip = ds->replay_clip;
+	ds->tool = TOOL_STAMP;
+	ds->tool_mode = TOOL_DOWN;
+	for (size_t i = 0; i < ds->dabs.num; i += DAB_BATCH) {
+		size_t count = ds->dabs.num - i < DAB_BATCH ? ds->dabs.num - i : DAB_BATCH;
+		memcpy(ds->dab_batch, ds->dabs.array + i, count * sizeof(struct vec4));
+		ds->dab_batch_count = (int)count;
+		float x0 = ds->size.x, y0 = ds->size.y, x1 = 0.0f, y1 = 0.0f;
+		for (size_t j = 0; j < count; j++) {
+			const struct vec4 *dab = &ds->dab_batch[j];
+			x0 = fminf(x0, dab->x - dab->z - 1.0f);
+			y0 = fminf(y0, dab->y - dab->z - 1.0f);
+			x1 = fmaxf(x1, dab->x + dab->z + 1.0f);
+			y1 = fmaxf(y1, dab->y + dab->z + 1.0f);
+		}
+		x0 = fmaxf(floorf(x0), clip.z > 0.0f ? clip.x : 0.0f);
+		y0 = fmaxf(floorf(y0), clip.z > 0.0f ? clip.y : 0.0f);
+		x1 = fminf(ceilf(x1), clip.z > 0.0f ? clip.x + clip.z : ds->size.x);
+		y1 = fminf(ceilf(y1), clip.z > 0.0f ? clip.y + clip.w : ds->size.y);
+		if (x1 <= x0 || y1 <= y0)
+			continue;
+		vec4_set(&ds->replay_clip, x0, y0, x1 - x0, y1 - y0);
+		canvas_pass(ds, "Draw");
+		/* the other half only holds the batch bounds, so they are copied back and the complete half stays active */
+		gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+		if (tex) {
+			vector_copy_rect(ds, ds->render_a_active ? ds->render_b : ds->render_a, tex, &ds->replay_clip);
+			ds->render_a_active = !ds->render_a_active;
+		}
+	}
+	ds->replay_clip = clip;
+	ds->dab_batch_count = 0;
+	ds->dabs.num = 0;
+	ds->tool = tool;
+	ds->tool_mode = tool_mode;
+}
+
+static bool fill_tick(struct draw_source *ds, bool wait);
+static void fill_finish(struct draw_source *ds);
+
+/* composites the accumulated stroke onto the canvas once with the stroke color, called with the graphics lock held */
+static void stroke_commit(struct draw_source *ds)
+{
+	if (ds->fill_active) {
+		/* something needs the canvas now, so a running fill waits for its read backs, but only for so long */
+		uint32_t limit = ds->fill_passes + FILL_WAIT_PASSES;
+		while (!fill_tick(ds, true) && ds->fill_passes < limit)
+			;
+		fill_finish(ds);
+		return;
+	}
+	if (!ds->stroke_layer_active)
+		return;
+	canvas_pass(ds, "Composite");
+	ds->stroke_layer_active = false;
+}
+
+/* grows the stroke layer to cover x0, y0 - x1, y1 plus a margin, copying what the stroke drew so far */
+static bool stroke_layer_fit(struct draw_source *ds, float x0, float y0, float x1, float y1)
+{
+	struct vec4 *rect = &ds->stroke_rect;
+	if (ds->stroke_layer_active) {
+		if (x0 >= rect->x && y0 >= rect->y && x1 <= rect->x + rect->z && y1 <= rect->y + rect->w)
+			return true;
+		x0 = fminf(x0, rect->x);
+		y0 = fminf(y0, rect->y);
+		x1 = fmaxf(x1, rect->x + rect->z);
+		y1 = fmaxf(y1, rect->y + rect->w);
+	}
+	x0 = fmaxf(floorf(x0 - STROKE_LAYER_MARGIN), 0.0f);
+	y0 = fmaxf(floorf(y0 - STROKE_LAYER_MARGIN), 0.0f);
+	x1 = fminf(ceilf(x1 + STROKE_LAYER_MARGIN), ds->size.x);
+	y1 = fminf(ceilf(y1 + STROKE_LAYER_MARGIN), ds->size.y);
+	if (x1 <= x0 || y1 <= y0)
+		return false;
+
+	if (!ds->stroke_layer_grow)
+		ds->stroke_layer_grow = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	gs_texrender_reset(ds->stroke_layer_grow);
+	if (!gs_texrender_begin(ds->stroke_layer_grow, (uint32_t)(x1 - x0), (uint32_t)(y1 - y0)))
+		return false;
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_texture_t *old = ds->stroke_layer_active ? gs_texrender_get_texture(ds->stroke_layer) : NULL;
+	if (old) {
+		gs_blend_state_push();
+		gs_reset_blend_state();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+		gs_ortho(x0, x1, y0, y1, -100.0f, 100.0f);
+		gs_matrix_push();
+		gs_matrix_translate3f(rect->x, rect->y, 0.0f);
+		gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), old);
+		while (gs_effect_loop(effect, "Draw"))
+			gs_draw_sprite(old, 0, (uint32_t)rect->z, (uint32_t)rect->w);
+		gs_matrix_pop();
+		gs_blend_state_pop();
+	}
+	gs_texrender_end(ds->stroke_layer_grow);
+
+	gs_texrender_t *layer = ds->stroke_layer;
+	ds->stroke_layer = ds->stroke_layer_grow;
+	ds->stroke_layer_grow = layer;
+	vec4_set(rect, x0, y0, x1 - x0, y1 - y0);
+	ds->stroke_layer_active = true;
+	return true;
+}
+
+/* max blends the coverage of the current pencil or brush segment into the stroke layer, only its bounds are rasterized */
+static void stroke_layer_draw(struct draw_source *ds)
+{
+	bool dot = ds->mouse_previous_pos.x < 0.0f || ds->mouse_previous_pos.y < 0.0f;
+	if (dot || memcmp(&ds->stroke_color, &ds->tool_color, sizeof(struct vec4)) != 0)
+		stroke_commit(ds);
+	ds->stroke_color = ds->tool_color;
+
+	/* the width is interpolated from the pressure at the previous point, so pressure changes do not step between segments */
+	float pressure_from = dot ? ds->tablet_factor : ds->stroke_pressure;
+	ds->stroke_pressure = ds->tablet_factor;
+	float size = ds->tool_size * fmaxf(ds->tablet_factor, pressure_from) + 1.0f;
+	float x0 = dot ? ds->mouse_pos.x : fminf(ds->mouse_pos.x, ds->mouse_previous_pos.x);
+	float y0 = dot ? ds->mouse_pos.y : fminf(ds->mouse_pos.y, ds->mouse_previous_pos.y);
+	float x1 = dot ? ds->mouse_pos.x : fmaxf(ds->mouse_pos.x, ds->mouse_previous_pos.x);
+	float y1 = dot ? ds->mouse_pos.y : fmaxf(ds->mouse_pos.y, ds->mouse_previous_pos.y);
+	if (!stroke_layer_fit(ds, x0 - size, y0 - size, x1 + size, y1 + size))
+		return;
+
+	struct vec4 *rect = &ds->stroke_rect;
+	x0 = fmaxf(floorf(x0 - size), rect->x);
+	y0 = fmaxf(floorf(y0 - size), rect->y);
+	x1 = fminf(ceilf(x1 + size), rect->x + rect->z);
+	y1 = fminf(ceilf(y1 + size), rect->y + rect->w);
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (!tex || x1 <= x0 || y1 <= y0)
+		return;
+
+	gs_texrender_reset(ds->stroke_layer);
+	if (!gs_texrender_begin(ds->stroke_layer, (uint32_t)rect->z, (uint32_t)rect->w))
+		return;
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_enable_blending(true);
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ONE);
+	gs_blend_op(GS_BLEND_OP_MAX);
+	gs_ortho(rect->x, rect->x + rect->z, rect->y, rect->y + rect->w, -100.0f, 100.0f);
+	gs_matrix_push();
+	gs_matrix_translate3f(x0, y0, 0.0f);
+	struct vec4 segment;
+	vec4_set(&segment, x0, y0, x1 - x0, y1 - y0);
+	draw_effect_params(ds, tex, false);
+	gs_effect_set_float(ds->shader->tool_size_from_param, ds->tool_size * pressure_from);
+	gs_effect_set_vec4(ds->shader->stroke_segment_param, &segment);
+	while (gs_effect_loop(ds->shader->effect, "Stroke"))
+		gs_draw_sprite(tex, 0, (uint32_t)segment.z, (uint32_t)segment.w);
+	gs_matrix_pop();
+	gs_blend_state_pop();
+	gs_texrender_end(ds->stroke_layer);
+}
+
+/* the quad of the next fill pass, every pass grows the fill at most FILL_STEPS so the last known bounds plus that cover it */
+static void fill_quad(struct draw_source *ds, struct vec4 *quad)
+{
+	float grow = (float)(FILL_STEPS * (ds->fill_passes - ds->fill_bounds_pass + 1));
+	float x0 = fmaxf(ds->fill_bounds.x - grow, 0.0f);
+	float y0 = fmaxf(ds->fill_bounds.y - grow, 0.0f);
+	float x1 = fminf(ds->fill_bounds.x + ds->fill_bounds.z + grow, ds->size.x);
+	float y1 = fminf(ds->fill_bounds.y + ds->fill_bounds.w + grow, ds->size.y);
+	vec4_set(quad, x0, y0, x1 - x0, y1 - y0);
+}
+
+static void fill_params(struct draw_source *ds, gs_texture_t *tex, const struct vec4 *quad)
+{
+	draw_effect_params(ds, tex, false);
+	gs_effect_set_vec4(ds->shader->stroke_segment_param, quad);
+	gs_effect_set_vec2(ds->shader->fill_seed_param, &ds->fill_seed);
+	gs_effect_set_float(ds->shader->fill_tolerance_param, ds->fill_threshold);
+}
+
+/* grows the fill mask from the stroke layer into the other half of the pair, only inside the fill quad */
+static bool fill_pass(struct draw_source *ds)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (!tex)
+		return false;
+	struct vec4 quad;
+	fill_quad(ds, &quad);
+	gs_texrender_reset(ds->stroke_layer_grow);
+	if (!gs_texrender_begin(ds->stroke_layer_grow, (uint32_t)ds->size.x, (uint32_t)ds->size.y))
+		return false;
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
+	gs_matrix_push();
+	gs_matrix_translate3f(quad.x, quad.y, 0.0f);
+	fill_params(ds, tex, &quad);
+	while (gs_effect_loop(ds->shader->effect, "Fill"))
+		gs_draw_sprite(tex, 0, (uint32_t)quad.z, (uint32_t)quad.w);
+	gs_matrix_pop();
+	gs_blend_state_pop();
+	gs_texrender_end(ds->stroke_layer_grow);
+
+	gs_texrender_t *layer = ds->stroke_layer;
+	ds->stroke_layer = ds->stroke_layer_grow;
+	ds->stroke_layer_grow = layer;
+	ds->fill_passes++;
+	return true;
+}
+
+/* renders one texel per cell of the fill quad, red when the cell has an open edge, green when it is filled, and stages it */
+static bool fill_probe_stage(struct draw_source *ds)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (!tex)
+		return false;
+	struct vec4 quad;
+	fill_quad(ds, &quad);
+	uint32_t cx = quad.z < (float)FILL_PROBE_SIZE ? (uint32_t)quad.z : FILL_PROBE_SIZE;
+	uint32_t cy = quad.w < (float)FILL_PROBE_SIZE ? (uint32_t)quad.w : FILL_PROBE_SIZE;
+	vec4_set(&ds->fill_probe_cell, ceilf(quad.z / (float)cx), ceilf(quad.w / (float)cy), (float)cx, (float)cy);
+
+	if (!ds->fill_probe)
+		ds->fill_probe = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	gs_texrender_reset(ds->fill_probe);
+	if (!gs_texrender_begin(ds->fill_probe, cx, cy))
+		return false;
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+	fill_params(ds, tex, &quad);
+	gs_effect_set_vec4(ds->shader->fill_cell_param, &ds->fill_probe_cell);
+	while (gs_effect_loop(ds->shader->effect, "FillProbe"))
+		gs_draw_sprite(tex, 0, cx, cy);
+	gs_blend_state_pop();
+	gs_texrender_end(ds->fill_probe);
+
+	if (ds->fill_probe_surf && (gs_stagesurface_get_width(ds->fill_probe_surf) != cx ||
+				    gs_stagesurface_get_height(ds->fill_probe_surf) != cy)) {
+		gs_stagesurface_destroy(ds->fill_probe_surf);
+		ds->fill_probe_surf = NULL;
+	}
+	if (!ds->fill_probe_surf)
+		ds->fill_probe_surf = gs_stagesurface_create(cx, cy, GS_RGBA);
+	if (!ds->fill_probe_surf)
+		return false;
+	gs_stage_texture(ds->fill_probe_surf, gs_texrender_get_texture(ds->fill_probe));
+	ds->fill_probe_rect = quad;
+	ds->fill_probe_pass = ds->fill_passes;
+	ds->fill_probe_ticks = 0;
+	ds->fill_probe_staged = true;
+	return true;
+}
+
+/* reads a staged probe back and narrows the known fill bounds, open is false when the fill has no open edge left,
+ * returns false when the probe could not be mapped */
+static bool fill_probe_read(struct draw_source *ds, bool *open_edge)
+{
+	ds->fill_probe_staged = false;
+	uint8_t *data;
+	uint32_t linesize;
+	if (!gs_stagesurface_map(ds->fill_probe_surf, &data, &linesize))
+		return false;
+	uint32_t cx = (uint32_t)ds->fill_probe_cell.z;
+	uint32_t cy = (uint32_t)ds->fill_probe_cell.w;
+	bool open = false;
+	float x0 = ds->size.x;
+	float y0 = ds->size.y;
+	float x1 = 0.0f;
+	float y1 = 0.0f;
+	for (uint32_t y = 0; y < cy; y++) {
+		const uint8_t *px = data + (size_t)y * linesize;
+		for (uint32_t x = 0; x < cx; x++, px += 4) {
+			if (px[0] > 127)
+				open = true;
+			if (px[0] <= 127 && px[1] <= 127)
+				continue;
+			float left = ds->fill_probe_rect.x + (float)x * ds->fill_probe_cell.x;
+			float top = ds->fill_probe_rect.y + (float)y * ds->fill_probe_cell.y;
+			x0 = fminf(x0, left);
+			y0 = fminf(y0, top);
+			x1 = fmaxf(x1, fminf(left + ds->fill_probe_cell.x, ds->fill_probe_rect.x + ds->fill_probe_rect.z));
+			y1 = fmaxf(y1, fminf(top + ds->fill_probe_cell.y, ds->fill_probe_rect.y + ds->fill_probe_rect.w));
 		}
-		gs_texrender_destroy(context->render_a);
 	}
-	if (context->render_b) {
-		if (!graphics) {
-			graphics = true;
-			obs_enter_graphics();
-		}
-		gs_texrender_destroy(context->render_b);
+	gs_stagesurface_unmap(ds->fill_probe_surf);
+	*open_edge = open;
+	if (open && x1 > x0 && y1 > y0) {
+		vec4_set(&ds->fill_bounds, x0, y0, x1 - x0, y1 - y0);
+		ds->fill_bounds_pass = ds->fill_probe_pass;
 	}
-	if (context->tool_image) {
-		if (!graphics) {
-			graphics = true;
-			obs_enter_graphics();
+	return true;
+}
+
+/* advances a running fill, the probe is mapped a few ticks after staging unless waiting, returns true once it is done,
+ * a probe that cannot be mapped ends the fill with what it covers so far */
+static bool fill_tick(struct draw_source *ds, bool wait)
+{
+	if (ds->fill_probe_staged && (wait || ++ds->fill_probe_ticks >= SNAPSHOT_MAP_DELAY_TICKS)) {
+		bool open = false;
+		if (!fill_probe_read(ds, &open)) {
+			blog(LOG_WARNING, "[Draw] fill stopped, its probe could not be read back");
+			return true;
 		}
-		gs_image_file4_free(context->tool_image);
-		bfree(context->tool_image);
+		if (!open)
+			return true;
 	}
-	if (context->cursor_image) {
-		if (!graphics) {
-			graphics = true;
-			obs_enter_graphics();
-		}
-		gs_image_file4_free(context->cursor_image);
-		bfree(context->cursor_image);
+	for (int i = 0; i < (wait ? FILL_WAIT_PASSES_PER_PROBE : FILL_PASSES_PER_TICK); i++) {
+		if (!fill_pass(ds))
+			return true;
 	}
-	if (graphics)
-		obs_leave_graphics();
-	if (context->tool_image_path)
-		bfree(context->tool_image_path);
-	if (context->cursor_image_path)
-		bfree(context->cursor_image_path);
-	bfree(context);
+	return !ds->fill_probe_staged && !fill_probe_stage(ds);
 }
 
-static uint32_t ds_get_width(void *data)
+/* composites a fill that is done or was cut off and records the pixels it covered, mirrors and the journal would not
+ * cut it off at the same pass, called with the graphics lock held */
+static void fill_finish(struct draw_source *ds)
 {
-	struct draw_source *context = data;
-	return (uint32_t)context->size.x;
+	struct vec4 quad;
+	fill_quad(ds, &quad);
+	float x0 = floorf(quad.x);
+	float y0 = floorf(quad.y);
+	vec4_set(&quad, x0, y0, ceilf(quad.x + quad.z) - x0, ceilf(quad.y + quad.w) - y0);
+	ds->fill_active = false;
+	stroke_commit(ds);
+	record_patch(ds, "fill", &quad);
 }
 
-static uint32_t ds_get_height(void *data)
+/* starts a flood fill from the mouse position in the stroke layer, composited like a stroke once it is done */
+static void fill_start(struct draw_source *ds)
 {
-	struct draw_source *context = data;
-	return (uint32_t)context->size.y;
+	float x = floorf(ds->mouse_pos.x);
+	float y = floorf(ds->mouse_pos.y);
+	if (x < 0.0f || y < 0.0f || x >= ds->size.x || y >= ds->size.y)
+		return;
+	stroke_commit(ds);
+	ds->stroke_color = ds->tool_color;
+	if (!stroke_layer_fit(ds, 0.0f, 0.0f, ds->size.x, ds->size.y))
+		return;
+	/* the fill ping-pongs between both stroke layers, so the other one has to start empty too */
+	if (!ds->stroke_layer_grow)
+		ds->stroke_layer_grow = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	gs_texrender_reset(ds->stroke_layer_grow);
+	if (!gs_texrender_begin(ds->stroke_layer_grow, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
+		ds->stroke_layer_active = false;
+		return;
+	}
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_texrender_end(ds->stroke_layer_grow);
+
+	vec2_set(&ds->fill_seed, x, y);
+	ds->fill_threshold = ds->fill_tolerance / 100.0f;
+	ds->fill_passes = 0;
+	vec4_set(&ds->fill_bounds, x, y, 1.0f, 1.0f);
+	ds->fill_bounds_pass = 0;
+	ds->fill_probe_staged = false;
+	ds->fill_active = true;
+	if (fill_tick(ds, false))
+		fill_finish(ds);
 }
 
-static void ds_video_render(void *data, gs_effect_t *effect)
+/* copies the selected pixels into the float layer, the grabbed handle is decided by where the drag started */
+static bool float_lift(struct draw_source *ds, const struct vec2 *start)
 {
-	UNUSED_PARAMETER(effect);
-	struct draw_source *ds = data;
-	if (!ds->render_a && !ds->render_b)
+	ds->float_active = false;
+	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
+	if (!tex)
+		return false;
+	float_selection(ds, &ds->float_rect);
+	if (ds->float_rect.z < 1.0f || ds->float_rect.w < 1.0f)
+		return false;
+	ds->float_handle = float_handle_at(&ds->float_rect, start);
+	if (!ds->float_layer)
+		ds->float_layer = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	gs_texrender_reset(ds->float_layer);
+	if (!gs_texrender_begin(ds->float_layer, (uint32_t)ds->float_rect.z, (uint32_t)ds->float_rect.w))
+		return false;
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	gs_ortho(ds->float_rect.x, ds->float_rect.x + ds->float_rect.z, ds->float_rect.y, ds->float_rect.y + ds->float_rect.w,
+		 -100.0f, 100.0f);
+	draw_effect(ds, tex, false, "FloatLift");
+	gs_blend_state_pop();
+	gs_texrender_end(ds->float_layer);
+	ds->float_active = true;
+	return true;
+}
+
+/* composites the transformed selection back into the canvas and moves the selection onto its bounds */
+static void float_commit(struct draw_source *ds)
+{
+	/* lifted again from the canvas so replayed drags do not depend on a live drag having lifted it */
+	if (!float_lift(ds, &ds->mouse_previous_pos))
+		return;
+	canvas_pass(ds, "FloatCommit");
+
+	struct vec2 corners[4];
+	float_map(ds, &ds->float_rect, 0.0f, 0.0f, &corners[0]);
+	float_map(ds, &ds->float_rect, ds->float_rect.z, 0.0f, &corners[1]);
+	float_map(ds, &ds->float_rect, 0.0f, ds->float_rect.w, &corners[2]);
+	float_map(ds, &ds->float_rect, ds->float_rect.z, ds->float_rect.w, &corners[3]);
+	ds->select_from = corners[0];
+	ds->select_to = corners[0];
+	for (int i = 1; i < 4; i++) {
+		vec2_min(&ds->select_from, &ds->select_from, &corners[i]);
+		vec2_max(&ds->select_to, &ds->select_to, &corners[i]);
+	}
+	ds->float_active = false;
+}
+
+/* a press inside the selection starts dragging it, lifted right away so the drag only moves a quad */
+static void float_begin(struct draw_source *ds)
+{
+	if (ds->mouse_pos.x <= fminf(ds->select_from.x, ds->select_to.x) ||
+	    ds->mouse_pos.x >= fmaxf(ds->select_from.x, ds->select_to.x) ||
+	    ds->mouse_pos.y <= fminf(ds->select_from.y, ds->select_to.y) ||
+	    ds->mouse_pos.y >= fmaxf(ds->select_from.y, ds->select_to.y))
 		return;
-	if (!ds->draw_effect)
+	ds->tool_mode = TOOL_DRAG;
+	obs_enter_graphics();
+	dab_flush(ds);
+	stroke_commit(ds);
+	float_lift(ds, &ds->mouse_pos);
+	obs_leave_graphics();
+}
+
+static void float_quad(struct draw_source *ds, const struct vec4 *rect, float x, float y, float cx, float cy, bool uv)
+{
+	struct vec2 p;
+	gs_render_start(uv);
+	float_map(ds, rect, x, y, &p);
+	if (uv)
+		gs_texcoord(0.0f, 0.0f, 0);
+	gs_vertex2f(p.x, p.y);
+	float_map(ds, rect, x + cx, y, &p);
+	if (uv)
+		gs_texcoord(1.0f, 0.0f, 0);
+	gs_vertex2f(p.x, p.y);
+	float_map(ds, rect, x, y + cy, &p);
+	if (uv)
+		gs_texcoord(0.0f, 1.0f, 0);
+	gs_vertex2f(p.x, p.y);
+	float_map(ds, rect, x + cx, y + cy, &p);
+	if (uv)
+		gs_texcoord(1.0f, 1.0f, 0);
+	gs_vertex2f(p.x, p.y);
+	gs_render_stop(GS_TRISTRIP);
+}
+
+/* draws the floating selection as one quad over the canvas and the handles of the selection on top */
+static void float_render(struct draw_source *ds)
+{
+	struct vec4 rect;
+	if (ds->float_active) {
+		rect = ds->float_rect;
+		gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), gs_texrender_get_texture(ds->float_layer));
+		while (gs_effect_loop(effect, "Draw"))
+			float_quad(ds, &rect, 0.0f, 0.0f, rect.z, rect.w, true);
+	} else {
+		float_selection(ds, &rect);
+	}
+	if (rect.z < 1.0f || rect.w < 1.0f)
 		return;
 
-	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
-	if (tex) {
-		draw_effect(ds, tex, ds->mouse_active && ds->show_mouse);
+	float h = fminf(FLOAT_HANDLE_SIZE, fminf(rect.z, rect.w) / 3.0f);
+	float handles[5][2] = {
+		{0.0f, 0.0f}, {rect.z - h, 0.0f}, {0.0f, rect.w - h}, {rect.z - h, rect.w - h}, {(rect.z - h) / 2.0f, 0.0f},
+	};
+	gs_effect_t *solid = obs_get_base_effect(OBS_EFFECT_SOLID);
+	gs_eparam_t *color = gs_effect_get_param_by_name(solid, "color");
+	struct vec4 black;
+	struct vec4 white;
+	vec4_set(&black, 0.0f, 0.0f, 0.0f, 1.0f);
+	vec4_set(&white, 1.0f, 1.0f, 1.0f, 1.0f);
+	for (int i = 0; i < 5; i++) {
+		gs_effect_set_vec4(color, &black);
+		while (gs_effect_loop(solid, "Solid"))
+			float_quad(ds, &rect, handles[i][0], handles[i][1], h, h, false);
+		gs_effect_set_vec4(color, &white);
+		while (gs_effect_loop(solid, "Solid"))
+			float_quad(ds, &rect, handles[i][0] + 2.0f, handles[i][1] + 2.0f, h - 4.0f, h - 4.0f, false);
 	}
 }
 
+/* draws the shape over its bounds only and copies that into the current canvas, the rest of the canvas is left as is */
+static bool shape_commit(struct draw_source *ds)
+{
+	gs_texrender_t *canvas = ds->render_a_active ? ds->render_a : ds->render_b;
+	gs_texture_t *tex = gs_texrender_get_texture(canvas);
+	struct vec4 rect;
+	if (!tex || !shape_rect(ds, &rect))
+		return false;
+	if (!ds->shape_layer)
+		ds->shape_layer = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	gs_texrender_reset(ds->shape_layer);
+	if (!gs_texrender_begin(ds->shape_layer, (uint32_t)rect.z, (uint32_t)rect.w))
+		return false;
+	gs_blend_state_push();
+	gs_reset_blend_state();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	gs_ortho(0.0f, rect.z, 0.0f, rect.w, -100.0f, 100.0f);
+	draw_effect_params(ds, tex, false);
+	gs_effect_set_vec4(ds->shader->preview_rect_param, &rect);
+	while (gs_effect_loop(ds->shader->effect, "Shape"))
+		gs_draw_sprite(tex, 0, (uint32_t)rect.z, (uint32_t)rect.w);
+	gs_texrender_end(ds->shape_layer);
+
+	/* a texrender keeps its texture when begun again at the same size, so only the shape bounds are overwritten */
+	gs_texrender_reset(canvas);
+	if (gs_texrender_begin(canvas, (uint32_t)ds->size.x, (uint32_t)ds->size.y)) {
+		gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
+		gs_matrix_push();
+		gs_matrix_translate3f(rect.x, rect.y, 0.0f);
+		gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), gs_texrender_get_texture(ds->shape_layer));
+		while (gs_effect_loop(effect, "Draw"))
+			gs_draw_sprite(gs_texrender_get_texture(ds->shape_layer), 0, (uint32_t)rect.z, (uint32_t)rect.w);
+		gs_matrix_pop();
+		gs_texrender_end(canvas);
+	}
+	gs_blend_state_pop();
+	os_atomic_inc_long(&ds->canvas_version);
+	return true;
+}
+
 static void apply_tool(struct draw_source *ds)
 {
 	obs_enter_graphics();
-	gs_texture_t *tex = gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b);
-	if (tex) {
-		gs_texrender_reset(ds->render_a_active ? ds->render_b : ds->render_a);
-		if (gs_texrender_begin(ds->render_a_active ? ds->render_b : ds->render_a, (uint32_t)ds->size.x,
-				       (uint32_t)ds->size.y)) {
-			gs_blend_state_push();
-			gs_reset_blend_state();
-			gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-
-			gs_ortho(0.0f, ds->size.x, 0.0f, ds->size.y, -100.0f, 100.0f);
-			draw_effect(ds, tex, false);
-			gs_blend_state_pop();
-			gs_texrender_end(ds->render_a_active ? ds->render_b : ds->render_a);
+	canvas_acquire(ds);
+	if (picks_stroke(ds->tool)) {
+		vector_pick(ds);
+	} else if (gs_texrender_get_texture(ds->render_a_active ? ds->render_a : ds->render_b)) {
+		/* a fill is recorded as the pixels it covered once it is done */
+		if (ds->tool != TOOL_FILL)
+			record_tool(ds);
+		if (ds->tool == TOOL_STAMP && ds->tool_mode == TOOL_DOWN) {
+			dab_queue(ds);
+			if (ds->dabs.num >= DAB_PENDING_MAX)
+				dab_flush(ds);
+		} else if ((ds->tool == TOOL_PENCIL || ds->tool == TOOL_BRUSH) && ds->tool_mode == TOOL_DOWN) {
+			dab_flush(ds);
+			stroke_layer_draw(ds);
+		} else if (ds->tool == TOOL_FILL) {
+			dab_flush(ds);
+			vector_stale(ds);
+			fill_start(ds);
+		} else if ((ds->tool == TOOL_SELECT_RECTANGLE || ds->tool == TOOL_SELECT_ELLIPSE) && ds->tool_mode == TOOL_DRAG) {
+			dab_flush(ds);
+			stroke_commit(ds);
+			float_commit(ds);
+		} else {
+			dab_flush(ds);
+			stroke_commit(ds);
+			if (!shape_commit(ds))
+				canvas_pass(ds, "Draw");
 		}
-		ds->render_a_active = !ds->render_a_active;
 	}
 	obs_leave_graphics();
 }
@@ -466,9 +5103,17 @@ static void apply_tool(struct draw_source *ds)
 static void ds_mouse_move(void *data, const struct obs_mouse_event *event, bool mouse_leave)
 {
 	struct draw_source *ds = data;
+	if (ds->shared) {
+		struct obs_mouse_event mapped;
+		obs_source_t *owner = shared_input(ds, event, &mapped);
+		obs_source_send_mouse_move(owner, &mapped, mouse_leave);
+		obs_source_release(owner);
+		return;
+	}
 	ds->since_last_move = 0.0f;
 	//if (context->pen_down && (context->mouse_x != event->x || context->mouse_y != event->y)) {
 	//}
+	obs_enter_graphics();
 	if (!mouse_leave && draw_on_mouse_move(ds->tool)) {
 		ds->mouse_previous_pos = ds->mouse_pos;
 	}
@@ -477,9 +5122,10 @@ static void ds_mouse_move(void *data, const struct obs_mouse_event *event, bool
 	ds->mouse_active = !mouse_leave;
 	ds->shift_down = ((event->modifiers & INTERACT_SHIFT_KEY) == INTERACT_SHIFT_KEY);
 
-	if (ds->mouse_active && ds->tool_mode != TOOL_UP && draw_on_mouse_move(ds->tool)) {
+	if (ds->mouse_active && ds->tool_mode != TOOL_UP && (draw_on_mouse_move(ds->tool) || picks_stroke(ds->tool))) {
 		apply_tool(ds);
 	}
+	obs_leave_graphics();
 
 	//if (mouse_leave)
 	//    context->tool_down = false;
@@ -489,8 +5135,16 @@ void ds_mouse_click(void *data, const struct obs_mouse_event *event, int32_t typ
 {
 	UNUSED_PARAMETER(click_count);
 	struct draw_source *context = data;
+	if (context->shared) {
+		struct obs_mouse_event mapped;
+		obs_source_t *owner = shared_input(context, event, &mapped);
+		obs_source_send_mouse_click(owner, &mapped, type, mouse_up, click_count);
+		obs_source_release(owner);
+		return;
+	}
 	context->since_last_move = 0.0f;
 
+	obs_enter_graphics();
 	context->mouse_pos.x = (float)event->x;
 	context->mouse_pos.y = (float)event->y;
 	context->shift_down = ((event->modifiers & INTERACT_SHIFT_KEY) == INTERACT_SHIFT_KEY);
@@ -505,22 +5159,22 @@ void ds_mouse_click(void *data, const struct obs_mouse_event *event, int32_t typ
 
 	if (!mouse_up && type == 0) {
 		context->tool_mode = TOOL_DOWN;
-		if (context->tool == TOOL_SELECT_RECTANGLE || context->tool == TOOL_SELECT_ELLIPSE) {
-			if (context->mouse_pos.x > fminf(context->select_from.x, context->select_to.x) &&
-			    context->mouse_pos.x < fmaxf(context->select_from.x, context->select_to.x) &&
-			    context->mouse_pos.y > fminf(context->select_from.y, context->select_to.y) &&
-			    context->mouse_pos.y < fmaxf(context->select_from.y, context->select_to.y)) {
-				context->tool_mode = TOOL_DRAG;
-			}
-		}
-		if (draw)
+		if (context->tool == TOOL_SELECT_RECTANGLE || context->tool == TOOL_SELECT_ELLIPSE)
+			float_begin(context);
+		context->vector_erased = false;
+		if (draw || picks_stroke(context->tool))
 			apply_tool(context);
 	} else if (context->tool_mode == TOOL_DOWN) {
+		if (draw) {
+			obs_enter_graphics();
+			stroke_commit(context);
+			obs_leave_graphics();
+		}
 		if (!draw && type == 0) {
 			if (context->tool == TOOL_SELECT_RECTANGLE || context->tool == TOOL_SELECT_ELLIPSE) {
 				context->select_from = context->mouse_previous_pos;
 				context->select_to = context->mouse_pos;
-			} else {
+			} else if (!picks_stroke(context->tool)) {
 				copy_to_undo(context);
 				apply_tool(context);
 			}
@@ -529,22 +5183,27 @@ void ds_mouse_click(void *data, const struct obs_mouse_event *event, int32_t typ
 	} else if (context->tool_mode == TOOL_DRAG) {
 		copy_to_undo(context);
 		apply_tool(context);
-		context->select_from.x += context->mouse_pos.x - context->mouse_previous_pos.x;
-		context->select_from.y += context->mouse_pos.y - context->mouse_previous_pos.y;
-		context->select_to.x += context->mouse_pos.x - context->mouse_previous_pos.x;
-		context->select_to.y += context->mouse_pos.y - context->mouse_previous_pos.y;
 		context->tool_mode = TOOL_UP;
 	}
 	if (!draw) {
 		context->mouse_previous_pos = context->mouse_pos;
 	}
+	obs_leave_graphics();
 }
 
 void ds_key_click(void *data, const struct obs_key_event *event, bool key_up)
 {
 	UNUSED_PARAMETER(key_up);
 	struct draw_source *context = data;
+	if (context->shared) {
+		obs_source_t *owner = shared_owner(context);
+		obs_source_send_key_click(owner, event, key_up);
+		obs_source_release(owner);
+		return;
+	}
+	obs_enter_graphics();
 	context->shift_down = ((event->modifiers & INTERACT_SHIFT_KEY) == INTERACT_SHIFT_KEY);
+	obs_leave_graphics();
 
 	if (!key_up && ((event->modifiers & INTERACT_CONTROL_KEY) == INTERACT_CONTROL_KEY)) {
 		if (event->native_vkey == 'Z' || event->native_vkey == 'z') {
@@ -552,25 +5211,252 @@ void ds_key_click(void *data, const struct obs_key_event *event, bool key_up)
 		} else if (event->native_vkey == 'Y' || event->native_vkey == 'y') {
 			redo(context);
 		}
+	} else if (!key_up) {
+		/* the key itself, the text of Delete and Backspace differs between platforms and is empty on some */
+		obs_key_t key = obs_key_from_virtual_key((int)event->native_vkey);
+		if (key == OBS_KEY_DELETE || key == OBS_KEY_BACKSPACE)
+			vector_erase_selected(context);
+	}
+}
+
+/* starts loading an image, the current one keeps being drawn until image_swap finds it decoded */
+static void image_request(struct draw_source *ds, struct image_cache_entry **pending, bool *swap, const char *path)
+{
+	struct image_cache_entry *entry = image_cache_acquire(path);
+	pthread_mutex_lock(&ds->image_mutex);
+	struct image_cache_entry *previous = *pending;
+	*pending = entry;
+	*swap = true;
+	pthread_mutex_unlock(&ds->image_mutex);
+	image_cache_release(previous);
+}
+
+static void image_swap(struct draw_source *ds, struct image_cache_entry **current, struct image_cache_entry **pending, bool *swap)
+{
+	struct image_cache_entry *previous = NULL;
+	pthread_mutex_lock(&ds->image_mutex);
+	if (*swap && image_cache_ready(*pending)) {
+		previous = *current;
+		*current = *pending;
+		*pending = NULL;
+		*swap = false;
+	}
+	pthread_mutex_unlock(&ds->image_mutex);
+	image_cache_release(previous);
+}
+
+static void stamps_request(struct draw_source *ds, obs_data_array_t *files)
+{
+	struct dstr key = {0};
+	struct image_cache_entry *entries[STAMP_SET_MAX];
+	size_t count = 0;
+	size_t num = obs_data_array_count(files);
+	for (size_t i = 0; i < num && count < STAMP_SET_MAX; i++) {
+		obs_data_t *item = obs_data_array_item(files, i);
+		const char *path = obs_data_get_string(item, "value");
+		if (path && *path) {
+			dstr_cat(&key, path);
+			dstr_cat_ch(&key, '\n');
+			count++;
+		}
+		obs_data_release(item);
+	}
+	if (strcmp(key.array ? key.array : "", ds->stamp_files.array ? ds->stamp_files.array : "") == 0) {
+		dstr_free(&key);
+		return;
+	}
+	dstr_free(&ds->stamp_files);
+	ds->stamp_files = key;
+
+	count = 0;
+	for (size_t i = 0; i < num && count < STAMP_SET_MAX; i++) {
+		obs_data_t *item = obs_data_array_item(files, i);
+		const char *path = obs_data_get_string(item, "value");
+		if (path && *path)
+			entries[count++] = image_cache_acquire(path);
+		obs_data_release(item);
+	}
+
+	struct image_cache_entry *previous[STAMP_SET_MAX];
+	pthread_mutex_lock(&ds->image_mutex);
+	size_t previous_count = ds->stamps_pending_count;
+	memcpy(previous, ds->stamps_pending, previous_count * sizeof(struct image_cache_entry *));
+	memcpy(ds->stamps_pending, entries, count * sizeof(struct image_cache_entry *));
+	ds->stamps_pending_count = count;
+	ds->stamps_swap = true;
+	pthread_mutex_unlock(&ds->image_mutex);
+	for (size_t i = 0; i < previous_count; i++)
+		image_cache_release(previous[i]);
+}
+
+/* bilinear stretch of a 4 byte image into a square RGBA cell of the atlas */
+static void stamp_atlas_copy(struct stamp_atlas *atlas, uint32_t cell, uint32_t x0, uint32_t y0, const uint8_t *pixels,
+			     uint32_t width, uint32_t height, enum gs_color_format format)
+{
+	uint32_t r = format == GS_RGBA ? 0 : 2;
+	uint32_t b = format == GS_RGBA ? 2 : 0;
+	for (uint32_t y = 0; y < cell; y++) {
+		float sy = ((float)y + 0.5f) * (float)height / (float)cell - 0.5f;
+		if (sy < 0.0f)
+			sy = 0.0f;
+		uint32_t y1 = (uint32_t)sy;
+		uint32_t y2 = y1 + 1 < height ? y1 + 1 : y1;
+		float fy = sy - (float)y1;
+		uint8_t *dst = atlas->data[0] + ((size_t)(y0 + y) * atlas->width + x0) * 4;
+		for (uint32_t x = 0; x < cell; x++, dst += 4) {
+			float sx = ((float)x + 0.5f) * (float)width / (float)cell - 0.5f;
+			if (sx < 0.0f)
+				sx = 0.0f;
+			uint32_t x1 = (uint32_t)sx;
+			uint32_t x2 = x1 + 1 < width ? x1 + 1 : x1;
+			float fx = sx - (float)x1;
+			const uint8_t *p11 = pixels + ((size_t)y1 * width + x1) * 4;
+			const uint8_t *p21 = pixels + ((size_t)y1 * width + x2) * 4;
+			const uint8_t *p12 = pixels + ((size_t)y2 * width + x1) * 4;
+			const uint8_t *p22 = pixels + ((size_t)y2 * width + x2) * 4;
+			uint8_t texel[4];
+			for (uint32_t c = 0; c < 4; c++) {
+				float top = (float)p11[c] + ((float)p21[c] - (float)p11[c]) * fx;
+				float bottom = (float)p12[c] + ((float)p22[c] - (float)p12[c]) * fx;
+				texel[c] = (uint8_t)(top + (bottom - top) * fy + 0.5f);
+			}
+			dst[0] = texel[r];
+			dst[1] = texel[1];
+			dst[2] = texel[b];
+			dst[3] = format == GS_BGRX ? 255 : texel[3];
+		}
+	}
+}
+
+/* stretches every stamp into a square cell of a grid, the stamp tool stretches it to a square anyway, and box filters the mips */
+static void stamp_atlas_task(void *param)
+{
+	struct stamp_atlas *atlas = param;
+	const uint8_t *pixels[STAMP_SET_MAX];
+	uint32_t widths[STAMP_SET_MAX];
+	uint32_t heights[STAMP_SET_MAX];
+	enum gs_color_format formats[STAMP_SET_MAX];
+	uint32_t size = 1;
+	for (size_t i = 0; i < atlas->count; i++) {
+		pixels[i] = image_cache_pixels(atlas->stamps[i], &widths[i], &heights[i], &formats[i]);
+		if (pixels[i] && widths[i] > size)
+			size = widths[i];
+		if (pixels[i] && heights[i] > size)
+			size = heights[i];
+	}
+	uint32_t cell = 1;
+	atlas->levels = 1;
+	while (cell < size && cell < STAMP_CELL_MAX) {
+		cell *= 2;
+		atlas->levels++;
+	}
+	uint32_t columns = 1;
+	while (columns * columns < atlas->count)
+		columns++;
+	uint32_t rows = ((uint32_t)atlas->count + columns - 1) / columns;
+	atlas->width = columns * cell;
+	atlas->height = rows * cell;
+	atlas->data[0] = bzalloc((size_t)atlas->width * atlas->height * 4);
+
+	for (size_t i = 0; i < atlas->count; i++) {
+		uint32_t x = (uint32_t)i % columns * cell;
+		uint32_t y = (uint32_t)i / columns * cell;
+		/* inset by half a texel so linear filtering does not pick up the neighbouring cell */
+		vec4_set(&atlas->rects[i], ((float)x + 0.5f) / (float)atlas->width, ((float)y + 0.5f) / (float)atlas->height,
+			 ((float)cell - 1.0f) / (float)atlas->width, ((float)cell - 1.0f) / (float)atlas->height);
+		if (pixels[i])
+			stamp_atlas_copy(atlas, cell, x, y, pixels[i], widths[i], heights[i], formats[i]);
+		image_cache_release(atlas->stamps[i]);
+		atlas->stamps[i] = NULL;
+	}
+	for (uint32_t level = 1; level < atlas->levels; level++) {
+		uint32_t width = atlas->width >> (level - 1);
+		uint32_t height = atlas->height >> (level - 1);
+		atlas->data[level] = bmalloc((size_t)(width / 2) * (height / 2) * 4);
+		image_cache_half(atlas->data[level - 1], width, height, atlas->data[level]);
+	}
+
+	struct draw_source *ds = atlas->ds;
+	pthread_mutex_lock(&ds->image_mutex);
+	stamp_atlas_free(ds->stamps_built);
+	ds->stamps_built = atlas;
+	pthread_mutex_unlock(&ds->image_mutex);
+}
+
+/* packs a requested stamp set once all of its images are decoded and swaps the atlas in when it is packed */
+static void stamps_swap(struct draw_source *ds)
+{
+	struct stamp_atlas *atlas = NULL;
+	bool empty = false;
+	pthread_mutex_lock(&ds->image_mutex);
+	bool ready = ds->stamps_swap && !ds->stamps_building;
+	for (size_t i = 0; ready && i < ds->stamps_pending_count; i++)
+		ready = image_cache_ready(ds->stamps_pending[i]);
+	if (ready) {
+		if (ds->stamps_pending_count) {
+			struct stamp_atlas *task = bzalloc(sizeof(struct stamp_atlas));
+			task->ds = ds;
+			task->count = ds->stamps_pending_count;
+			memcpy(task->stamps, ds->stamps_pending, task->count * sizeof(struct image_cache_entry *));
+			ds->stamps_building = true;
+			os_task_queue_queue_task(ds->snapshot_tasks, stamp_atlas_task, task);
+		} else {
+			empty = true;
+		}
+		ds->stamps_pending_count = 0;
+		ds->stamps_swap = false;
 	}
+	if (ds->stamps_built) {
+		atlas = ds->stamps_built;
+		ds->stamps_built = NULL;
+		ds->stamps_building = false;
+	}
+	pthread_mutex_unlock(&ds->image_mutex);
+	if (!atlas && !empty)
+		return;
+
+	obs_enter_graphics();
+	dab_flush(ds);
+	gs_texture_destroy(ds->stamp_atlas);
+	ds->stamp_atlas = NULL;
+	ds->stamp_count = 0;
+	vec4_set(&ds->stamp_rects[0], 0.0f, 0.0f, 1.0f, 1.0f);
+	if (atlas) {
+		ds->stamp_atlas = gs_texture_create(atlas->width, atlas->height, GS_RGBA, atlas->levels,
+						    (const uint8_t **)atlas->data, 0);
+		if (ds->stamp_atlas) {
+			memcpy(ds->stamp_rects, atlas->rects, atlas->count * sizeof(struct vec4));
+			ds->stamp_count = atlas->count;
+		}
+	}
+	obs_leave_graphics();
+	stamp_atlas_free(atlas);
 }
 
 static void ds_update(void *data, obs_data_t *settings)
 {
 	struct draw_source *context = data;
 
-	bool clear_on_transition = obs_data_get_bool(settings, "clear_on_scene_transition");
-	if (clear_on_transition && !context->clear_on_transition) {
-		obs_frontend_add_event_callback(ds_frontend_event, data);
-		context->clear_on_transition = clear_on_transition;
-	} else if (!clear_on_transition && context->clear_on_transition) {
-		obs_frontend_remove_event_callback(ds_frontend_event, data);
-		context->clear_on_transition = clear_on_transition;
-	}
+	context->clear_on_transition = obs_data_get_bool(settings, "clear_on_scene_transition");
 	context->max_undo = (uint32_t)obs_data_get_int(settings, "max_undo");
+	context->release_delay = (uint64_t)obs_data_get_int(settings, "release_delay") * 1000000000ULL;
+	bool journal = obs_data_get_bool(settings, "journal");
+	if (journal && !context->journal)
+		journal_start(context);
+	else if (!journal && context->journal)
+		journal_stop(context, true);
 	context->size.x = (float)obs_data_get_int(settings, "width");
 	context->size.y = (float)obs_data_get_int(settings, "height");
-	context->tool = (uint32_t)obs_data_get_int(settings, "tool");
+	/* stroke sessions and ingested strokes borrow the tool under the graphics lock */
+	obs_enter_graphics();
+	uint32_t tool = (uint32_t)obs_data_get_int(settings, "tool");
+	if (tool != context->tool)
+		vector_select(context, STROKE_INDEX_NONE);
+	context->tool = tool;
+	bool vector = obs_data_get_bool(settings, "vector");
+	if (!vector && context->vector)
+		vector_reset(context);
+	context->vector = vector;
 	context->show_mouse = obs_data_get_bool(settings, "show_cursor");
 	context->cursor_size =
 		obs_data_get_bool(settings, "cursor_custom_size") ? (float)obs_data_get_double(settings, "cursor_size") : -1.0f;
@@ -581,8 +5467,21 @@ static void ds_update(void *data, obs_data_t *settings)
 	vec4_from_rgba(&context->tool_color, (uint32_t)obs_data_get_int(settings, "tool_color"));
 	context->tool_color.w = (float)obs_data_get_double(settings, "tool_alpha") / 100.0f;
 	context->tool_size = (float)obs_data_get_double(settings, "tool_size");
+	context->brush_tip = (uint32_t)obs_data_get_int(settings, "brush_tip");
+	context->brush_hardness = (float)obs_data_get_double(settings, "brush_hardness");
+	context->fill_tolerance = (float)obs_data_get_double(settings, "fill_tolerance");
+	obs_leave_graphics();
+
+	context->shared_offset.x = (float)obs_data_get_int(settings, "shared_x");
+	context->shared_offset.y = (float)obs_data_get_int(settings, "shared_y");
+	context->shared_scale = (float)obs_data_get_double(settings, "shared_scale") / 100.0f;
+	context->shared_rotation = RAD((float)obs_data_get_double(settings, "shared_rotation"));
+	shared_set(context, obs_data_get_string(settings, "shared_canvas"));
+	/* a reference leaves its own canvas alone, the next tick releases it */
+	if (context->shared)
+		return;
 
-	if (!context->render_a || !context->render_b) {
+	if (!context->canvas_released && (!context->render_a || !context->render_b)) {
 		obs_enter_graphics();
 		context->render_a = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
 		if (gs_texrender_begin(context->render_a, (uint32_t)context->size.x, (uint32_t)context->size.y)) {
@@ -603,68 +5502,113 @@ static void ds_update(void *data, obs_data_t *settings)
 		//gs_texrender_reset(context->render);
 	}
 
+	uint32_t layer_count = (uint32_t)obs_data_get_int(settings, "layer_count");
+	if (layer_count < 1)
+		layer_count = 1;
+	else if (layer_count > LAYER_MAX)
+		layer_count = LAYER_MAX;
+	uint32_t layer = (uint32_t)obs_data_get_int(settings, "layer");
+	layer = layer < 1 ? 0 : layer > layer_count ? layer_count - 1 : layer - 1;
+	obs_enter_graphics();
+	if (!context->layer_count)
+		context->layer_current = layer;
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		struct dstr name = {0};
+		dstr_printf(&name, "layer_visible_%u", i + 1);
+		bool visible = obs_data_get_bool(settings, name.array);
+		dstr_printf(&name, "layer_opacity_%u", i + 1);
+		float opacity = (float)obs_data_get_double(settings, name.array) / 100.0f;
+		dstr_free(&name);
+		if (visible != context->layers[i].visible || opacity != context->layers[i].opacity)
+			context->layers_dirty = true;
+		context->layers[i].visible = visible;
+		context->layers[i].opacity = opacity;
+	}
+	layer_select(context, layer);
+	if (layer_count != context->layer_count)
+		context->layers_dirty = true;
+	for (uint32_t i = layer_count; i < context->layer_count; i++) {
+		gs_texrender_destroy(context->layers[i].render);
+		context->layers[i].render = NULL;
+		context->layers[i].unsaved = true;
+	}
+	context->layer_count = layer_count;
+
+	bool infinite = obs_data_get_bool(settings, "infinite");
+	int32_t view_x = (int32_t)obs_data_get_int(settings, "view_x");
+	int32_t view_y = (int32_t)obs_data_get_int(settings, "view_y");
+	if (infinite && !context->tiles) {
+		/* the canvas as it is becomes the viewport at the stored position */
+		struct dstr name = {0};
+		dstr_printf(&name, "swap/%s.tiles", obs_source_get_uuid(context->source));
+		char *swap_path = obs_module_config_path(name.array);
+		dstr_free(&name);
+		char *slash = swap_path ? strrchr(swap_path, '/') : NULL;
+		if (slash) {
+			*slash = 0;
+			os_mkdirs(swap_path);
+			*slash = '/';
+		}
+		context->tiles = tile_store_create(swap_path);
+		bfree(swap_path);
+		tile_scan(context);
+		context->view_x = view_x;
+		context->view_y = view_y;
+	}
+	context->infinite = infinite;
+	view_pan(context, view_x, view_y);
+
+	uint32_t page_count = (uint32_t)obs_data_get_int(settings, "page_count");
+	if (page_count < 1)
+		page_count = 1;
+	else if (page_count > PAGE_MAX)
+		page_count = PAGE_MAX;
+	uint32_t page = (uint32_t)obs_data_get_int(settings, "page");
+	page = page < 1 ? 0 : page > page_count ? page_count - 1 : page - 1;
+	long long page_resident = obs_data_get_int(settings, "page_resident");
+	context->page_resident = page_resident < 1 ? 1 : (uint32_t)page_resident;
+	if (!context->page_count)
+		context->page_current = page;
+	context->page_count = page_count > context->page_count ? page_count : context->page_count;
+	page_select(context, page);
+	for (uint32_t i = page_count; i < context->page_count; i++)
+		page_discard(context, &context->pages[i]);
+	context->page_count = page_count;
+	page_evict(context);
+	obs_leave_graphics();
+
 	const char *cursor_image_path = obs_data_get_string(settings, "cursor_file");
 	if (strlen(cursor_image_path) > 0) {
 		if (!context->cursor_image_path || strcmp(cursor_image_path, context->cursor_image_path) != 0) {
 			if (context->cursor_image_path)
 				bfree(context->cursor_image_path);
 			context->cursor_image_path = bstrdup(cursor_image_path);
-			if (!context->cursor_image) {
-				context->cursor_image = bzalloc(sizeof(gs_image_file4_t));
-			} else {
-				obs_enter_graphics();
-				gs_image_file4_free(context->cursor_image);
-				obs_leave_graphics();
-			}
-			gs_image_file4_init(context->cursor_image, cursor_image_path, GS_IMAGE_ALPHA_PREMULTIPLY_SRGB);
-			// : GS_IMAGE_ALPHA_PREMULTIPLY);
-
-			obs_enter_graphics();
-			gs_image_file4_init_texture(context->cursor_image);
-			obs_leave_graphics();
-		}
-	} else if (context->cursor_image) {
-		obs_enter_graphics();
-		gs_image_file4_free(context->cursor_image);
-		obs_leave_graphics();
-		bfree(context->cursor_image);
-		context->cursor_image = NULL;
-		if (context->cursor_image_path) {
-			bfree(context->cursor_image_path);
-			context->cursor_image_path = NULL;
+			image_request(context, &context->cursor_image_pending, &context->cursor_image_swap, cursor_image_path);
 		}
+	} else if (context->cursor_image_path) {
+		bfree(context->cursor_image_path);
+		context->cursor_image_path = NULL;
+		image_request(context, &context->cursor_image_pending, &context->cursor_image_swap, NULL);
 	}
 
+	context->stamp_mode = (uint32_t)obs_data_get_int(settings, "stamp_mode");
+	context->stamp_spacing = (float)obs_data_get_double(settings, "stamp_spacing");
+	obs_data_array_t *stamp_files = obs_data_get_array(settings, "stamp_files");
+	stamps_request(context, stamp_files);
+	obs_data_array_release(stamp_files);
+
 	const char *tool_image_path = obs_data_get_string(settings, "tool_image_file");
 	if (strlen(tool_image_path) > 0) {
 		if (!context->tool_image_path || strcmp(tool_image_path, context->tool_image_path) != 0) {
 			if (context->tool_image_path)
 				bfree(context->tool_image_path);
 			context->tool_image_path = bstrdup(tool_image_path);
-			if (!context->tool_image) {
-				context->tool_image = bzalloc(sizeof(gs_image_file4_t));
-			} else {
-				obs_enter_graphics();
-				gs_image_file4_free(context->tool_image);
-				obs_leave_graphics();
-			}
-			gs_image_file4_init(context->tool_image, tool_image_path, GS_IMAGE_ALPHA_PREMULTIPLY_SRGB);
-			// : GS_IMAGE_ALPHA_PREMULTIPLY);
-
-			obs_enter_graphics();
-			gs_image_file4_init_texture(context->tool_image);
-			obs_leave_graphics();
-		}
-	} else if (context->tool_image) {
-		obs_enter_graphics();
-		gs_image_file4_free(context->tool_image);
-		obs_leave_graphics();
-		bfree(context->tool_image);
-		context->tool_image = NULL;
-		if (context->tool_image_path) {
-			bfree(context->tool_image_path);
-			context->tool_image_path = NULL;
+			image_request(context, &context->tool_image_pending, &context->tool_image_swap, tool_image_path);
 		}
+	} else if (context->tool_image_path) {
+		bfree(context->tool_image_path);
+		context->tool_image_path = NULL;
+		image_request(context, &context->tool_image_pending, &context->tool_image_swap, NULL);
 	}
 }
 
@@ -695,12 +5639,38 @@ const char *image_filter =
 	"WebP Files (*.webp);;"
 	"All Files (*.*)";
 
+static bool layer_count_changed(obs_properties_t *props, obs_property_t *property, obs_data_t *settings)
+{
+	UNUSED_PARAMETER(property);
+	long long count = obs_data_get_int(settings, "layer_count");
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		struct dstr name = {0};
+		dstr_printf(&name, "layer_visible_%u", i + 1);
+		obs_property_set_visible(obs_properties_get(props, name.array), i < count);
+		dstr_free(&name);
+	}
+	return true;
+}
+
+struct shared_list {
+	obs_source_t *self;
+	obs_property_t *list;
+};
+
+static bool shared_list_add(void *data, obs_source_t *source)
+{
+	struct shared_list *list = data;
+	if (source != list->self && strcmp(obs_source_get_unversioned_id(source), "draw_source") == 0)
+		obs_property_list_add_string(list->list, obs_source_get_name(source), obs_source_get_name(source));
+	return true;
+}
+
 static obs_properties_t *ds_get_properties(void *data)
 {
 	obs_properties_t *props = obs_properties_create();
 
-	obs_properties_add_int(props, "width", obs_module_text("Width"), 10, 10000, 1);
-	obs_properties_add_int(props, "height", obs_module_text("Height"), 10, 10000, 1);
+	obs_properties_add_int(props, "width", obs_module_text("Width"), 10, CANVAS_SIZE_MAX, 1);
+	obs_properties_add_int(props, "height", obs_module_text("Height"), 10, CANVAS_SIZE_MAX, 1);
 	obs_properties_t *tool = obs_properties_create();
 
 	obs_property_t *p =
@@ -717,14 +5687,35 @@ static obs_properties_t *ds_get_properties(void *data)
 	obs_property_list_add_int(p, obs_module_text("SelectEllipse"), TOOL_SELECT_ELLIPSE);
 	obs_property_list_add_int(p, obs_module_text("Stamp"), TOOL_STAMP);
 	obs_property_list_add_int(p, obs_module_text("Image"), TOOL_IMAGE);
+	obs_property_list_add_int(p, obs_module_text("Fill"), TOOL_FILL);
+	obs_property_list_add_int(p, obs_module_text("EraseStroke"), TOOL_ERASE_STROKE);
+	obs_property_list_add_int(p, obs_module_text("SelectStroke"), TOOL_SELECT_STROKE);
 
 	obs_properties_add_path(tool, "tool_image_file", obs_module_text("ToolImageFile"), OBS_PATH_FILE, image_filter, NULL);
 
+	obs_properties_add_editable_list(tool, "stamp_files", obs_module_text("StampFiles"), OBS_EDITABLE_LIST_TYPE_FILES,
+					 image_filter, NULL);
+	p = obs_properties_add_list(tool, "stamp_mode", obs_module_text("StampMode"), OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, obs_module_text("StampSequential"), STAMP_SEQUENTIAL);
+	obs_property_list_add_int(p, obs_module_text("StampRandom"), STAMP_RANDOM);
+	obs_property_list_add_int(p, obs_module_text("StampPressure"), STAMP_PRESSURE);
+	p = obs_properties_add_float_slider(tool, "stamp_spacing", obs_module_text("StampSpacing"), 1.0, 500.0, 1.0);
+	obs_property_float_set_suffix(p, "%");
+
 	obs_properties_add_color(tool, "tool_color", obs_module_text("ToolColor"));
 	p = obs_properties_add_float_slider(tool, "tool_alpha", obs_module_text("ToolAlpha"), -100.0, 100.0, 0.1);
 	obs_property_float_set_suffix(p, "%");
 	p = obs_properties_add_float_slider(tool, "tool_size", obs_module_text("ToolSize"), 0.0, 100.0, 0.1);
 	obs_property_float_set_suffix(p, "px");
+	p = obs_properties_add_list(tool, "brush_tip", obs_module_text("BrushTip"), OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, obs_module_text("BrushTipSoft"), BRUSH_TIP_SOFT);
+	obs_property_list_add_int(p, obs_module_text("BrushTipHard"), BRUSH_TIP_HARD);
+	obs_property_list_add_int(p, obs_module_text("BrushTipTextured"), BRUSH_TIP_TEXTURED);
+	obs_property_list_add_int(p, obs_module_text("BrushTipImage"), BRUSH_TIP_IMAGE);
+	p = obs_properties_add_float_slider(tool, "brush_hardness", obs_module_text("BrushHardness"), 0.0, 100.0, 1.0);
+	obs_property_float_set_suffix(p, "%");
+	p = obs_properties_add_float_slider(tool, "fill_tolerance", obs_module_text("FillTolerance"), 0.0, 100.0, 1.0);
+	obs_property_float_set_suffix(p, "%");
 
 	obs_properties_add_group(props, "tool_group", obs_module_text("Tool"), OBS_GROUP_NORMAL, tool);
 
@@ -750,10 +5741,65 @@ static obs_properties_t *ds_get_properties(void *data)
 
 	obs_properties_add_group(props, "show_cursor", obs_module_text("Cursor"), OBS_GROUP_CHECKABLE, cursor);
 
+	obs_properties_t *layers = obs_properties_create();
+	p = obs_properties_add_int_slider(layers, "layer_count", obs_module_text("LayerCount"), 1, LAYER_MAX, 1);
+	obs_property_set_modified_callback(p, layer_count_changed);
+	obs_properties_add_int_slider(layers, "layer", obs_module_text("LayerCurrent"), 1, LAYER_MAX, 1);
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		obs_properties_t *layer = obs_properties_create();
+		struct dstr name = {0};
+		dstr_printf(&name, "layer_opacity_%u", i + 1);
+		p = obs_properties_add_float_slider(layer, name.array, obs_module_text("LayerOpacity"), 0.0, 100.0, 1.0);
+		obs_property_float_set_suffix(p, "%");
+		struct dstr text = {0};
+		dstr_printf(&text, "%s %u", obs_module_text("Layer"), i + 1);
+		dstr_printf(&name, "layer_visible_%u", i + 1);
+		obs_properties_add_group(layers, name.array, text.array, OBS_GROUP_CHECKABLE, layer);
+		dstr_free(&text);
+		dstr_free(&name);
+	}
+	obs_properties_add_group(props, "layers", obs_module_text("Layers"), OBS_GROUP_NORMAL, layers);
+
+	obs_properties_t *pages = obs_properties_create();
+	obs_properties_add_int(pages, "page_count", obs_module_text("PageCount"), 1, PAGE_MAX, 1);
+	obs_properties_add_int(pages, "page", obs_module_text("PageCurrent"), 1, PAGE_MAX, 1);
+	p = obs_properties_add_int(pages, "page_resident", obs_module_text("PageResident"), 1, PAGE_MAX, 1);
+	obs_property_set_long_description(p, obs_module_text("PageResidentDescription"));
+	obs_properties_add_group(props, "pages", obs_module_text("Pages"), OBS_GROUP_NORMAL, pages);
+
+	obs_properties_t *infinite = obs_properties_create();
+	obs_properties_add_int(infinite, "view_x", obs_module_text("ViewX"), INT32_MIN / 2, INT32_MAX / 2, 1);
+	obs_properties_add_int(infinite, "view_y", obs_module_text("ViewY"), INT32_MIN / 2, INT32_MAX / 2, 1);
+	p = obs_properties_add_group(props, "infinite", obs_module_text("InfiniteCanvas"), OBS_GROUP_CHECKABLE, infinite);
+	obs_property_set_long_description(p, obs_module_text("InfiniteCanvasDescription"));
+
+	obs_properties_t *shared = obs_properties_create();
+	p = obs_properties_add_list(shared, "shared_canvas", obs_module_text("SharedCanvasSource"), OBS_COMBO_TYPE_LIST,
+				    OBS_COMBO_FORMAT_STRING);
+	obs_property_set_long_description(p, obs_module_text("SharedCanvasDescription"));
+	obs_property_list_add_string(p, obs_module_text("None"), "");
+	struct shared_list list = {data ? ((struct draw_source *)data)->source : NULL, p};
+	obs_enum_sources(shared_list_add, &list);
+	obs_properties_add_int(shared, "shared_x", obs_module_text("SharedX"), -10000, 10000, 1);
+	obs_properties_add_int(shared, "shared_y", obs_module_text("SharedY"), -10000, 10000, 1);
+	p = obs_properties_add_float_slider(shared, "shared_scale", obs_module_text("SharedScale"), 1.0, 1000.0, 1.0);
+	obs_property_float_set_suffix(p, "%");
+	p = obs_properties_add_float_slider(shared, "shared_rotation", obs_module_text("SharedRotation"), -180.0, 180.0, 0.1);
+	obs_property_float_set_suffix(p, "\u00B0");
+	obs_properties_add_group(props, "shared", obs_module_text("SharedCanvas"), OBS_GROUP_NORMAL, shared);
+
 	obs_properties_add_int(props, "max_undo", obs_module_text("UndoMax"), 1, 10000, 1);
+	p = obs_properties_add_int(props, "release_delay", obs_module_text("ReleaseDelay"), 0, 3600, 1);
+	obs_property_int_set_suffix(p, " s");
+	obs_property_set_long_description(p, obs_module_text("ReleaseDelayDescription"));
 
 	obs_properties_add_bool(props, "clear_on_scene_transition", obs_module_text("ClearOnSceneTransition"));
 
+	p = obs_properties_add_bool(props, "vector", obs_module_text("VectorStrokes"));
+	obs_property_set_long_description(p, obs_module_text("VectorStrokesDescription"));
+
+	obs_properties_add_bool(props, "journal", obs_module_text("Journal"));
+
 	obs_properties_add_button2(props, "clear", obs_module_text("Clear"), clear_property_button, data);
 
 	obs_properties_add_text(props, "plugin_info",
@@ -776,7 +5822,45 @@ static void ds_get_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "cursor_custom_size", true);
 	obs_data_set_default_double(settings, "cursor_size", 10.0);
 	obs_data_set_default_int(settings, "max_undo", 10);
+	obs_data_set_default_int(settings, "release_delay", 60);
+	obs_data_set_default_double(settings, "stamp_spacing", 50.0);
+	obs_data_set_default_double(settings, "fill_tolerance", 10.0);
 	obs_data_set_default_double(settings, "cursor_hide_time", 0.5);
+	obs_data_set_default_int(settings, "layer_count", 1);
+	obs_data_set_default_int(settings, "layer", 1);
+	obs_data_set_default_int(settings, "page_count", 1);
+	obs_data_set_default_int(settings, "page", 1);
+	obs_data_set_default_int(settings, "page_resident", 3);
+	obs_data_set_default_bool(settings, "infinite", false);
+	obs_data_set_default_bool(settings, "vector", false);
+	obs_data_set_default_double(settings, "shared_scale", 100.0);
+	for (uint32_t i = 0; i < LAYER_MAX; i++) {
+		struct dstr name = {0};
+		dstr_printf(&name, "layer_visible_%u", i + 1);
+		obs_data_set_default_bool(settings, name.array, true);
+		dstr_printf(&name, "layer_opacity_%u", i + 1);
+		obs_data_set_default_double(settings, name.array, 100.0);
+		dstr_free(&name);
+	}
+}
+
+/* a showing reference keeps its owner showing so the shared canvas is not released while it is on screen */
+static void shared_tick(struct draw_source *ds)
+{
+	if (!ds->shared && !ds->shared_shown)
+		return;
+	obs_source_t *owner = ds->shared && obs_source_showing(ds->source) ? shared_owner(ds) : NULL;
+	obs_source_t *shown = obs_weak_source_get_source(ds->shared_shown);
+	if (owner != shown) {
+		if (shown)
+			obs_source_dec_showing(shown);
+		if (owner)
+			obs_source_inc_showing(owner);
+		obs_weak_source_release(ds->shared_shown);
+		ds->shared_shown = owner ? obs_source_get_weak_source(owner) : NULL;
+	}
+	obs_source_release(shown);
+	obs_source_release(owner);
 }
 
 static void ds_video_tick(void *data, float seconds)
@@ -784,17 +5868,86 @@ static void ds_video_tick(void *data, float seconds)
 	struct draw_source *ds = data;
 	ds->since_last_move += seconds;
 
-	uint64_t frame_time = obs_get_video_frame_time();
+	image_swap(ds, &ds->tool_image, &ds->tool_image_pending, &ds->tool_image_swap);
+	image_swap(ds, &ds->cursor_image, &ds->cursor_image_pending, &ds->cursor_image_swap);
+	stamps_swap(ds);
+	if (ds->dabs.num) {
+		obs_enter_graphics();
+		dab_flush(ds);
+		obs_leave_graphics();
+	}
+	if (ds->fill_active) {
+		obs_enter_graphics();
+		if (fill_tick(ds, false))
+			fill_finish(ds);
+		obs_leave_graphics();
+	}
+	image_cache_tick(ds->cursor_image, obs_get_video_frame_time());
+
+	stroke_queue_drain(ds);
+	emit_events(ds);
+	patches_queue(ds);
+	snapshot_tick(ds);
+	shared_tick(ds);
+	if (!ds->canvas_released && !ds->canvas_loading && !ds->float_active && !ds->fill_active && ds->tool_mode != TOOL_DOWN &&
+	    ds->render_a &&
+	    (ds->shared || (ds->release_delay && !obs_source_showing(ds->source) &&
+			    obs_get_video_frame_time() - ds->rendered > ds->release_delay))) {
+		obs_enter_graphics();
+		canvas_release(ds);
+		obs_leave_graphics();
+	}
+	if (ds->pages_evicting) {
+		obs_enter_graphics();
+		page_tick(ds);
+		obs_leave_graphics();
+	}
+	if (ds->undo_packing.num) {
+		obs_enter_graphics();
+		undo_pack_tick(ds);
+		obs_leave_graphics();
+	}
+	if (ds->page_loading)
+		page_decode_tick(ds);
+	if (ds->view_pending)
+		view_tick(ds);
+	if (ds->tiles_prefetching || ds->tiles_evicting) {
+		obs_enter_graphics();
+		tile_tick(ds);
+		obs_leave_graphics();
+	}
+}
 
-	if (ds->last_tick && ds->cursor_image && ds->cursor_image->image3.image2.image.is_animated_gif) {
-		uint64_t elapsed = frame_time - ds->last_tick;
-		if (gs_image_file4_tick(ds->cursor_image, elapsed)) {
-			obs_enter_graphics();
-			gs_image_file4_update_texture(ds->cursor_image);
-			obs_leave_graphics();
-		}
+/* the wheel pans an infinite canvas */
+static void ds_mouse_wheel(void *data, const struct obs_mouse_event *event, int x_delta, int y_delta)
+{
+	struct draw_source *ds = data;
+	if (ds->shared) {
+		struct obs_mouse_event mapped;
+		obs_source_t *owner = shared_input(ds, event, &mapped);
+		obs_source_send_mouse_wheel(owner, &mapped, x_delta, y_delta);
+		obs_source_release(owner);
+		return;
 	}
-	ds->last_tick = frame_time;
+	if (!ds->infinite)
+		return;
+	obs_enter_graphics();
+	int32_t x = ds->view_pending ? ds->view_target_x : ds->view_x;
+	int32_t y = ds->view_pending ? ds->view_target_y : ds->view_y;
+	view_request(ds, x - x_delta, y - y_delta);
+	obs_leave_graphics();
+}
+
+/* restores a released canvas right away so the first frame shown does not wait for it */
+static void ds_show(void *data)
+{
+	struct draw_source *ds = data;
+	ds->rendered = obs_get_video_frame_time();
+	if (!ds->canvas_released || ds->shared)
+		return;
+	obs_enter_graphics();
+	canvas_acquire(ds);
+	obs_leave_graphics();
 }
 
 struct obs_source_info draw_source_info = {
@@ -811,9 +5964,12 @@ struct obs_source_info draw_source_info = {
 	.video_render = ds_video_render,
 	.mouse_move = ds_mouse_move,
 	.mouse_click = ds_mouse_click,
+	.mouse_wheel = ds_mouse_wheel,
 	.key_click = ds_key_click,
 	.update = ds_update,
 	.get_properties = ds_get_properties,
 	.get_defaults = ds_get_defaults,
 	.video_tick = ds_video_tick,
+	.show = ds_show,
+	.save = ds_save,
 };
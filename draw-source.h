@@ -1,5 +1,9 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,6 +20,18 @@ extern "C" {
 #define TOOL_SELECT_ELLIPSE 9
 #define TOOL_STAMP 10
 #define TOOL_IMAGE 11
+#define TOOL_FILL 12
+#define TOOL_ERASE_STROKE 13
+#define TOOL_SELECT_STROKE 14
+
+#define STAMP_SEQUENTIAL 0
+#define STAMP_RANDOM 1
+#define STAMP_PRESSURE 2
+
+#define BRUSH_TIP_SOFT 0
+#define BRUSH_TIP_HARD 1
+#define BRUSH_TIP_TEXTURED 2
+#define BRUSH_TIP_IMAGE 3
 
 #define TOOL_UP 0
 #define TOOL_DOWN 1
@@ -23,6 +39,18 @@ extern "C" {
 
 extern const char *image_filter;
 
+/* compiles draw.effect on the graphics thread ahead of the first draw source */
+void draw_shader_warm_up(void);
+
+struct obs_data;
+
+/* implemented by the dock, the websocket vendor is only available after post load */
+bool draw_vendor_available(void);
+void draw_vendor_emit_event(const char *event_name, struct obs_data *event_data);
+
+/* implemented by the dock with Qt, encodes RGBA pixels into a bmalloc'd PNG, safe to call from any thread */
+uint8_t *draw_encode_png(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t linesize, size_t *size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,303 @@
+#include "image-cache.h"
+#include <graphics/image-file.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/task.h>
+#include <util/threading.h>
+#include <sys/stat.h>
+
+/* animations taller than this as a single strip keep uploading each frame */
+#define IMAGE_CACHE_MAX_STRIP_HEIGHT 8192
+#define IMAGE_CACHE_MAX_LEVELS 16
+
+struct image_cache_entry {
+	char *path;
+	int64_t mtime;
+	long refs;
+	gs_image_file4_t image;
+	volatile bool decoded;
+	bool uploaded;
+	uint64_t last_tick;
+
+	/* animated gifs decoded up front, stacked vertically in one texture */
+	uint32_t frames;
+	uint64_t *frame_end;
+	uint64_t duration;
+	uint64_t start;
+	uint32_t frame;
+	gs_texture_t *strip;
+
+	/* mip chain of still images built on the decode thread, level 0 is the texture_data of the image */
+	uint32_t levels;
+	uint8_t *level_data[IMAGE_CACHE_MAX_LEVELS];
+};
+
+static pthread_mutex_t image_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct image_cache_entry *) image_cache;
+static os_task_queue_t *image_cache_tasks;
+
+static int64_t image_cache_mtime(const char *path)
+{
+	struct stat stats;
+	if (os_stat(path, &stats) != 0)
+		return -1;
+	return (int64_t)stats.st_mtime;
+}
+
+static uint64_t image_cache_frame_delay(const gs_image_file_t *image, uint32_t frame)
+{
+	/* same timing as libobs, a zero delay plays at 10 fps */
+	uint64_t delay = (uint64_t)image->gif.frames[frame].frame_delay * 10000000ULL;
+	return delay ? delay : 100000000ULL;
+}
+
+/* decodes every frame of an animated gif, libobs keeps decoded frames back to back in animation_frame_data */
+static void image_cache_decode_frames(struct image_cache_entry *entry)
+{
+	gs_image_file_t *image = &entry->image.image3.image2.image;
+	uint32_t count = image->gif.frame_count;
+	if (!image->loaded || !image->is_animated_gif || !image->animation_frame_cache || count < 2 ||
+	    (uint64_t)image->cy * count > IMAGE_CACHE_MAX_STRIP_HEIGHT)
+		return;
+
+	for (uint32_t i = 1; i < count; i++)
+		gs_image_file4_tick(&entry->image, image_cache_frame_delay(image, (uint32_t)image->cur_frame) + 1);
+	for (uint32_t i = 0; i < count; i++) {
+		if (!image->animation_frame_cache[i])
+			return;
+	}
+
+	entry->frame_end = bmalloc(count * sizeof(uint64_t));
+	for (uint32_t i = 0; i < count; i++) {
+		entry->duration += image_cache_frame_delay(image, i);
+		entry->frame_end[i] = entry->duration;
+	}
+	entry->frames = count;
+}
+
+static inline uint32_t image_cache_level_size(uint32_t size, uint32_t level)
+{
+	size >>= level;
+	return size ? size : 1;
+}
+
+static inline bool image_cache_four_bytes(enum gs_color_format format)
+{
+	return format == GS_RGBA || format == GS_BGRA || format == GS_BGRX;
+}
+
+void image_cache_half(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst)
+{
+	uint32_t dst_width = width > 1 ? width / 2 : 1;
+	uint32_t dst_height = height > 1 ? height / 2 : 1;
+	for (uint32_t y = 0; y < dst_height; y++) {
+		const uint8_t *row0 = src + (size_t)(y * 2) * width * 4;
+		const uint8_t *row1 = src + (size_t)(y * 2 + 1 < height ? y * 2 + 1 : y * 2) * width * 4;
+		for (uint32_t x = 0; x < dst_width; x++) {
+			size_t x0 = (size_t)x * 2 * 4;
+			size_t x1 = (x * 2 + 1 < width ? (size_t)x * 2 + 1 : (size_t)x * 2) * 4;
+			for (uint32_t c = 0; c < 4; c++)
+				*dst++ = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+		}
+	}
+}
+
+/* box filters premultiplied still images down to 1x1 so downscaled stamps sample a matching level */
+static void image_cache_build_levels(struct image_cache_entry *entry)
+{
+	gs_image_file_t *image = &entry->image.image3.image2.image;
+	if (!image->loaded || image->is_animated_gif || !image->texture_data || !image_cache_four_bytes(image->format))
+		return;
+
+	entry->level_data[0] = image->texture_data;
+	entry->levels = 1;
+	uint32_t width = image->cx;
+	uint32_t height = image->cy;
+	while ((width > 1 || height > 1) && entry->levels < IMAGE_CACHE_MAX_LEVELS) {
+		uint32_t level = entry->levels;
+		entry->level_data[level] = bmalloc((size_t)image_cache_level_size(image->cx, level) *
+						   image_cache_level_size(image->cy, level) * 4);
+		image_cache_half(entry->level_data[level - 1], width, height, entry->level_data[level]);
+		width = image_cache_level_size(image->cx, level);
+		height = image_cache_level_size(image->cy, level);
+		entry->levels++;
+	}
+}
+
+static void image_cache_decode_task(void *param)
+{
+	struct image_cache_entry *entry = param;
+	gs_image_file4_init(&entry->image, entry->path, GS_IMAGE_ALPHA_PREMULTIPLY_SRGB);
+	image_cache_decode_frames(entry);
+	image_cache_build_levels(entry);
+	os_atomic_set_bool(&entry->decoded, true);
+	image_cache_release(entry);
+}
+
+struct image_cache_entry *image_cache_acquire(const char *path)
+{
+	if (!path || !*path)
+		return NULL;
+
+	int64_t mtime = image_cache_mtime(path);
+	pthread_mutex_lock(&image_cache_mutex);
+	for (size_t i = 0; i < image_cache.num; i++) {
+		struct image_cache_entry *entry = image_cache.array[i];
+		if (entry->mtime == mtime && strcmp(entry->path, path) == 0) {
+			entry->refs++;
+			pthread_mutex_unlock(&image_cache_mutex);
+			return entry;
+		}
+	}
+
+	/* a changed file gets a new entry, sources still holding the old one keep it until they release it */
+	struct image_cache_entry *entry = bzalloc(sizeof(struct image_cache_entry));
+	entry->path = bstrdup(path);
+	entry->mtime = mtime;
+	entry->refs = 2;
+	da_push_back(image_cache, &entry);
+	if (!image_cache_tasks)
+		image_cache_tasks = os_task_queue_create();
+	pthread_mutex_unlock(&image_cache_mutex);
+
+	/* the decode task holds the second reference */
+	os_task_queue_queue_task(image_cache_tasks, image_cache_decode_task, entry);
+	return entry;
+}
+
+void image_cache_addref(struct image_cache_entry *entry)
+{
+	if (!entry)
+		return;
+	pthread_mutex_lock(&image_cache_mutex);
+	entry->refs++;
+	pthread_mutex_unlock(&image_cache_mutex);
+}
+
+void image_cache_release(struct image_cache_entry *entry)
+{
+	if (!entry)
+		return;
+
+	pthread_mutex_lock(&image_cache_mutex);
+	bool last = --entry->refs == 0;
+	if (last)
+		da_erase_item(image_cache, &entry);
+	if (!image_cache.num)
+		da_free(image_cache);
+	pthread_mutex_unlock(&image_cache_mutex);
+	if (!last)
+		return;
+
+	obs_enter_graphics();
+	gs_texture_destroy(entry->strip);
+	gs_image_file4_free(&entry->image);
+	obs_leave_graphics();
+	for (uint32_t i = 1; i < entry->levels; i++)
+		bfree(entry->level_data[i]);
+	bfree(entry->frame_end);
+	bfree(entry->path);
+	bfree(entry);
+}
+
+bool image_cache_ready(struct image_cache_entry *entry)
+{
+	return !entry || os_atomic_load_bool(&entry->decoded);
+}
+
+gs_texture_t *image_cache_texture(struct image_cache_entry *entry)
+{
+	if (!entry || !os_atomic_load_bool(&entry->decoded))
+		return NULL;
+	gs_image_file_t *image = &entry->image.image3.image2.image;
+	if (!entry->uploaded) {
+		if (entry->frames) {
+			const uint8_t *data = image->animation_frame_data;
+			entry->strip = gs_texture_create(image->cx, image->cy * entry->frames, image->format, 1, &data, 0);
+		} else if (entry->levels) {
+			image->texture = gs_texture_create(image->cx, image->cy, image->format, entry->levels,
+							   (const uint8_t **)entry->level_data, 0);
+			/* only levels that fit IMAGE_CACHE_RETAIN_SIZE stay in memory for building stamp atlases */
+			for (uint32_t i = 0; i < entry->levels; i++) {
+				if (image_cache_level_size(image->cx, i) <= IMAGE_CACHE_RETAIN_SIZE &&
+				    image_cache_level_size(image->cy, i) <= IMAGE_CACHE_RETAIN_SIZE)
+					break;
+				if (i) {
+					bfree(entry->level_data[i]);
+				} else {
+					bfree(image->texture_data);
+					image->texture_data = NULL;
+				}
+				entry->level_data[i] = NULL;
+			}
+		} else {
+			gs_image_file4_init_texture(&entry->image);
+		}
+		entry->uploaded = true;
+	}
+	return entry->strip ? entry->strip : image->texture;
+}
+
+const uint8_t *image_cache_pixels(struct image_cache_entry *entry, uint32_t *width, uint32_t *height, enum gs_color_format *format)
+{
+	if (!entry || !os_atomic_load_bool(&entry->decoded) || !entry->levels)
+		return NULL;
+
+	const gs_image_file_t *image = &entry->image.image3.image2.image;
+	uint32_t level = 0;
+	while (level + 1 < entry->levels && (image_cache_level_size(image->cx, level) > IMAGE_CACHE_RETAIN_SIZE ||
+					     image_cache_level_size(image->cy, level) > IMAGE_CACHE_RETAIN_SIZE))
+		level++;
+	*width = image_cache_level_size(image->cx, level);
+	*height = image_cache_level_size(image->cy, level);
+	*format = image->format;
+	return entry->level_data[level];
+}
+
+void image_cache_frame(struct image_cache_entry *entry, struct vec2 *frame)
+{
+	if (entry && entry->strip) {
+		/* inset by half a texel so linear filtering never reaches into the neighbouring frames */
+		float texel = 1.0f / ((float)entry->image.image3.image2.image.cy * (float)entry->frames);
+		vec2_set(frame, (float)entry->frame / (float)entry->frames + texel * 0.5f, 1.0f / (float)entry->frames - texel);
+	} else {
+		vec2_set(frame, 0.0f, 1.0f);
+	}
+}
+
+void image_cache_tick(struct image_cache_entry *entry, uint64_t frame_time)
+{
+	if (!entry || !entry->uploaded || !entry->image.image3.image2.image.is_animated_gif || entry->last_tick == frame_time)
+		return;
+
+	if (entry->frames) {
+		if (!entry->start)
+			entry->start = frame_time;
+		uint64_t elapsed = frame_time - entry->start;
+		int loops = entry->image.image3.image2.image.gif.loop_count;
+		if (loops > 0 && loops < 0xFFFF && elapsed >= entry->duration * (uint64_t)loops) {
+			entry->frame = entry->frames - 1;
+		} else {
+			elapsed %= entry->duration;
+			uint32_t frame = 0;
+			while (frame + 1 < entry->frames && elapsed >= entry->frame_end[frame])
+				frame++;
+			entry->frame = frame;
+		}
+		entry->last_tick = frame_time;
+		return;
+	}
+
+	if (entry->last_tick && gs_image_file4_tick(&entry->image, frame_time - entry->last_tick)) {
+		obs_enter_graphics();
+		gs_image_file4_update_texture(&entry->image);
+		obs_leave_graphics();
+	}
+	entry->last_tick = frame_time;
+}
+
+void image_cache_shutdown(void)
+{
+	os_task_queue_destroy(image_cache_tasks);
+	image_cache_tasks = NULL;
+}
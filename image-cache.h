@@ -0,0 +1,53 @@
+#pragma once
+
+#include <obs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Module wide cache of decoded tool and cursor images keyed by path and file modification time,
+ * so every draw source using the same image shares one decode and one texture.
+ * Images are decoded on a worker thread and uploaded by the first render that uses them,
+ * still images with a full mip chain.
+ */
+
+/* largest mip level kept in memory after upload */
+#define IMAGE_CACHE_RETAIN_SIZE 512
+
+struct image_cache_entry;
+
+/* returns a reference to the image at path without waiting, a new image starts decoding in the background */
+struct image_cache_entry *image_cache_acquire(const char *path);
+
+void image_cache_addref(struct image_cache_entry *entry);
+
+/* drops a reference, the image is freed when the last reference is released */
+void image_cache_release(struct image_cache_entry *entry);
+
+/* true once decoding finished, also when it failed */
+bool image_cache_ready(struct image_cache_entry *entry);
+
+/* returns the texture or NULL while decoding, uploads a freshly decoded image so the graphics lock must be held */
+gs_texture_t *image_cache_texture(struct image_cache_entry *entry);
+
+/* returns the largest retained mip level of a decoded still image, GS_RGBA, GS_BGRA or GS_BGRX, NULL for animations */
+const uint8_t *image_cache_pixels(struct image_cache_entry *entry, uint32_t *width, uint32_t *height, enum gs_color_format *format);
+
+/* box filters 4 byte pixels into dst sized max(width / 2, 1) by max(height / 2, 1) */
+void image_cache_half(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst);
+
+/* sets the offset and height of the current animation frame in texture coordinates, animated gifs are one vertical strip
+ * and the frame is inset by half a texel so filtering stays inside it */
+void image_cache_frame(struct image_cache_entry *entry, struct vec2 *frame);
+
+/* advances an animated gif to frame_time, only the first call per frame does any work, video thread only */
+void image_cache_tick(struct image_cache_entry *entry, uint64_t frame_time);
+
+/* waits for pending decodes, called on module unload */
+void image_cache_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,173 @@
+#include "qoi-codec.h"
+#include <string.h>
+#include <util/bmem.h>
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_HEADER_SIZE 14
+#define QOI_MAX_RUN 62
+
+static const uint8_t qoi_padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+static inline void write_uint32_be(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+static inline uint32_t read_uint32_be(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+
+uint8_t *qoi_encode(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t linesize, size_t *size)
+{
+	*size = 0;
+	if (!width || !height || linesize < width * 4 || (uint64_t)width * height > 400000000)
+		return NULL;
+
+	uint8_t *out = bmalloc(QOI_HEADER_SIZE + (size_t)width * height * 5 + sizeof(qoi_padding));
+	memcpy(out, "qoif", 4);
+	write_uint32_be(out + 4, width);
+	write_uint32_be(out + 8, height);
+	out[12] = 4;
+	out[13] = 0;
+	size_t pos = QOI_HEADER_SIZE;
+
+	uint8_t index[64][4];
+	memset(index, 0, sizeof(index));
+	uint8_t prev[4] = {0, 0, 0, 255};
+	uint32_t run = 0;
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *px = rgba + (size_t)y * linesize;
+		for (uint32_t x = 0; x < width; x++, px += 4) {
+			if (memcmp(px, prev, 4) == 0) {
+				if (++run == QOI_MAX_RUN) {
+					out[pos++] = (uint8_t)(QOI_OP_RUN | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+			if (run) {
+				out[pos++] = (uint8_t)(QOI_OP_RUN | (run - 1));
+				run = 0;
+			}
+
+			uint32_t hash = (px[0] * 3u + px[1] * 5u + px[2] * 7u + px[3] * 11u) % 64u;
+			if (memcmp(index[hash], px, 4) == 0) {
+				out[pos++] = (uint8_t)(QOI_OP_INDEX | hash);
+			} else {
+				memcpy(index[hash], px, 4);
+				if (px[3] == prev[3]) {
+					int8_t vr = (int8_t)(px[0] - prev[0]);
+					int8_t vg = (int8_t)(px[1] - prev[1]);
+					int8_t vb = (int8_t)(px[2] - prev[2]);
+					int8_t vg_r = (int8_t)(vr - vg);
+					int8_t vg_b = (int8_t)(vb - vg);
+					if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+						out[pos++] = (uint8_t)(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+					} else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+						out[pos++] = (uint8_t)(QOI_OP_LUMA | (vg + 32));
+						out[pos++] = (uint8_t)((vg_r + 8) << 4 | (vg_b + 8));
+					} else {
+						out[pos++] = QOI_OP_RGB;
+						memcpy(out + pos, px, 3);
+						pos += 3;
+					}
+				} else {
+					out[pos++] = QOI_OP_RGBA;
+					memcpy(out + pos, px, 4);
+					pos += 4;
+				}
+			}
+			memcpy(prev, px, 4);
+		}
+	}
+	if (run)
+		out[pos++] = (uint8_t)(QOI_OP_RUN | (run - 1));
+	memcpy(out + pos, qoi_padding, sizeof(qoi_padding));
+	pos += sizeof(qoi_padding);
+	*size = pos;
+	return out;
+}
+
+bool qoi_read_size(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height)
+{
+	if (size < QOI_HEADER_SIZE + sizeof(qoi_padding) || memcmp(data, "qoif", 4) != 0)
+		return false;
+	*width = read_uint32_be(data + 4);
+	*height = read_uint32_be(data + 8);
+	return *width && *height && (uint64_t)*width * *height <= 400000000 && (data[12] == 3 || data[12] == 4);
+}
+
+uint8_t *qoi_decode(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height)
+{
+	uint32_t w;
+	uint32_t h;
+	if (!qoi_read_size(data, size, &w, &h))
+		return NULL;
+
+	size_t count = (size_t)w * h;
+	size_t end = size - sizeof(qoi_padding);
+	/* every byte covers at most one run, so a payload too short for the header size is rejected before allocating */
+	if (count > (end - QOI_HEADER_SIZE) * QOI_MAX_RUN)
+		return NULL;
+	uint8_t *pixels = bmalloc(count * 4);
+	uint8_t index[64][4];
+	memset(index, 0, sizeof(index));
+	uint8_t px[4] = {0, 0, 0, 255};
+	size_t pos = QOI_HEADER_SIZE;
+	uint32_t run = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (run) {
+			run--;
+		} else if (pos < end) {
+			uint8_t b = data[pos++];
+			if (b == QOI_OP_RGB) {
+				if (pos + 3 > end)
+					break;
+				memcpy(px, data + pos, 3);
+				pos += 3;
+			} else if (b == QOI_OP_RGBA) {
+				if (pos + 4 > end)
+					break;
+				memcpy(px, data + pos, 4);
+				pos += 4;
+			} else if ((b & 0xc0) == QOI_OP_INDEX) {
+				memcpy(px, index[b], 4);
+			} else if ((b & 0xc0) == QOI_OP_DIFF) {
+				px[0] += ((b >> 4) & 3) - 2;
+				px[1] += ((b >> 2) & 3) - 2;
+				px[2] += (b & 3) - 2;
+			} else if ((b & 0xc0) == QOI_OP_LUMA) {
+				if (pos >= end)
+					break;
+				uint8_t b2 = data[pos++];
+				int vg = (b & 0x3f) - 32;
+				px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+				px[1] += vg;
+				px[2] += vg - 8 + (b2 & 0x0f);
+			} else {
+				run = b & 0x3f;
+			}
+			uint32_t hash = (px[0] * 3u + px[1] * 5u + px[2] * 7u + px[3] * 11u) % 64u;
+			memcpy(index[hash], px, 4);
+		} else {
+			break;
+		}
+		memcpy(pixels + i * 4, px, 4);
+		if (i + 1 == count) {
+			*width = w;
+			*height = h;
+			return pixels;
+		}
+	}
+	bfree(pixels);
+	return NULL;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Encoder and decoder for the Quite OK Image format (https://qoiformat.org), used for canvas
+ * snapshots because it is several times faster than PNG at a similar size for
+ * drawings with large flat areas.
+ */
+
+/* encodes 4 channel RGBA pixels into a bmalloc'd QOI image, returns NULL when the size is invalid */
+uint8_t *qoi_encode(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t linesize, size_t *size);
+
+/* reads the size from the header of a QOI image, false when the header is invalid */
+bool qoi_read_size(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height);
+
+/* decodes a QOI image into bmalloc'd 4 channel RGBA pixels with a linesize of width * 4, returns NULL when data is invalid */
+uint8_t *qoi_decode(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height);
+
+#ifdef __cplusplus
+}
+#endif
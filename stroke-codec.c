@@ -0,0 +1,253 @@
+#include "stroke-codec.h"
+#include <math.h>
+#include <string.h>
+#include <util/bmem.h>
+
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const int8_t base64_values[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63, 52, 53, 54, 55,
+	56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1, -1, 0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12,
+	13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1, -1, 26, 27, 28, 29, 30, 31, 32,
+	33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+size_t stroke_base64_decode(const char *in, size_t in_len, uint8_t *out, size_t out_size)
+{
+	while (in_len && in[in_len - 1] == '=')
+		in_len--;
+	if (in_len % 4 == 1)
+		return 0;
+	size_t size = in_len / 4 * 3 + (in_len % 4 ? in_len % 4 - 1 : 0);
+	if (size > out_size)
+		return 0;
+
+	const uint8_t *src = (const uint8_t *)in;
+	size_t pos = 0;
+	size_t i = 0;
+	for (; i + 4 <= in_len; i += 4) {
+		int a = base64_values[src[i]];
+		int b = base64_values[src[i + 1]];
+		int c = base64_values[src[i + 2]];
+		int d = base64_values[src[i + 3]];
+		if ((a | b | c | d) < 0)
+			return 0;
+		uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+		out[pos++] = (uint8_t)(v >> 16);
+		out[pos++] = (uint8_t)(v >> 8);
+		out[pos++] = (uint8_t)v;
+	}
+	size_t rest = in_len - i;
+	if (rest) {
+		int a = base64_values[src[i]];
+		int b = base64_values[src[i + 1]];
+		int c = rest == 3 ? base64_values[src[i + 2]] : 0;
+		if ((a | b | c) < 0)
+			return 0;
+		uint32_t v = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6);
+		out[pos++] = (uint8_t)(v >> 16);
+		if (rest == 3)
+			out[pos++] = (uint8_t)(v >> 8);
+	}
+	return pos;
+}
+
+char *stroke_base64_encode(const uint8_t *data, size_t size)
+{
+	char *out = bmalloc((size + 2) / 3 * 4 + 1);
+	char *o = out;
+	size_t i = 0;
+	for (; i + 3 <= size; i += 3) {
+		uint32_t v = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+		*o++ = base64_chars[(v >> 18) & 63];
+		*o++ = base64_chars[(v >> 12) & 63];
+		*o++ = base64_chars[(v >> 6) & 63];
+		*o++ = base64_chars[v & 63];
+	}
+	if (i < size) {
+		uint32_t v = (uint32_t)data[i] << 16;
+		if (i + 1 < size)
+			v |= (uint32_t)data[i + 1] << 8;
+		*o++ = base64_chars[(v >> 18) & 63];
+		*o++ = base64_chars[(v >> 12) & 63];
+		*o++ = i + 1 < size ? base64_chars[(v >> 6) & 63] : '=';
+		*o++ = '=';
+	}
+	*o = 0;
+	return out;
+}
+
+static inline int16_t read_int16(const uint8_t *p)
+{
+	return (int16_t)(uint16_t)(p[0] | (p[1] << 8));
+}
+
+size_t stroke_points_decode(const uint8_t *data, size_t size, struct stroke_point *points, size_t max_points)
+{
+	if (size < STROKE_CODEC_HEADER_SIZE || data[0] != STROKE_CODEC_MAGIC || data[1] != STROKE_CODEC_VERSION)
+		return 0;
+	size_t count = (size_t)data[2] | ((size_t)data[3] << 8);
+	if (!count || count > max_points || size != STROKE_CODEC_HEADER_SIZE + count * STROKE_CODEC_POINT_SIZE)
+		return 0;
+
+	const uint8_t *p = data + STROKE_CODEC_HEADER_SIZE;
+	int32_t x = 0;
+	int32_t y = 0;
+	for (size_t i = 0; i < count; i++, p += STROKE_CODEC_POINT_SIZE) {
+		x += read_int16(p);
+		y += read_int16(p + 2);
+		points[i].x = (float)x;
+		points[i].y = (float)y;
+		points[i].pressure = (float)p[4] / 255.0f;
+	}
+	return count;
+}
+
+size_t stroke_points_decode_b64(const char *b64, struct stroke_point **points)
+{
+	*points = NULL;
+	if (!b64)
+		return 0;
+	size_t len = strlen(b64);
+	size_t max_size = len / 4 * 3 + 3;
+	if (max_size < STROKE_CODEC_HEADER_SIZE + STROKE_CODEC_POINT_SIZE)
+		return 0;
+
+	uint8_t *data = bmalloc(max_size);
+	size_t size = stroke_base64_decode(b64, len, data, max_size);
+	size_t max_points = size > STROKE_CODEC_HEADER_SIZE ? (size - STROKE_CODEC_HEADER_SIZE) / STROKE_CODEC_POINT_SIZE : 0;
+	size_t count = 0;
+	if (max_points) {
+		*points = bmalloc(max_points * sizeof(struct stroke_point));
+		count = stroke_points_decode(data, size, *points, max_points);
+		if (!count) {
+			bfree(*points);
+			*points = NULL;
+		}
+	}
+	bfree(data);
+	return count;
+}
+
+static inline int16_t clamp_int16(float v)
+{
+	v = roundf(v);
+	if (v > 32767.0f)
+		return 32767;
+	if (v < -32768.0f)
+		return -32768;
+	return (int16_t)v;
+}
+
+static inline void write_int16(uint8_t *p, int16_t v)
+{
+	p[0] = (uint8_t)((uint16_t)v & 0xFF);
+	p[1] = (uint8_t)((uint16_t)v >> 8);
+}
+
+char *stroke_points_encode_b64(const struct stroke_point *points, size_t count)
+{
+	if (count > STROKE_CODEC_MAX_POINTS)
+		count = STROKE_CODEC_MAX_POINTS;
+	size_t size = STROKE_CODEC_HEADER_SIZE + count * STROKE_CODEC_POINT_SIZE;
+	uint8_t *data = bmalloc(size);
+	data[0] = STROKE_CODEC_MAGIC;
+	data[1] = STROKE_CODEC_VERSION;
+	data[2] = (uint8_t)(count & 0xFF);
+	data[3] = (uint8_t)(count >> 8);
+
+	uint8_t *p = data + STROKE_CODEC_HEADER_SIZE;
+	int32_t x = 0;
+	int32_t y = 0;
+	for (size_t i = 0; i < count; i++, p += STROKE_CODEC_POINT_SIZE) {
+		int16_t px = clamp_int16(points[i].x);
+		int16_t py = clamp_int16(points[i].y);
+		int32_t dx = px - x;
+		int32_t dy = py - y;
+		if (dx > 32767)
+			dx = 32767;
+		else if (dx < -32768)
+			dx = -32768;
+		if (dy > 32767)
+			dy = 32767;
+		else if (dy < -32768)
+			dy = -32768;
+		write_int16(p, (int16_t)dx);
+		write_int16(p + 2, (int16_t)dy);
+		x += dx;
+		y += dy;
+		float pressure = points[i].pressure;
+		p[4] = pressure <= 0.0f ? 0 : pressure >= 1.0f ? 255 : (uint8_t)(pressure * 255.0f + 0.5f);
+	}
+
+	char *out = stroke_base64_encode(data, size);
+	bfree(data);
+	return out;
+}
+
+static float segment_distance(const struct stroke_point *p, const struct stroke_point *a, const struct stroke_point *b)
+{
+	float dx = b->x - a->x;
+	float dy = b->y - a->y;
+	float len = dx * dx + dy * dy;
+	float t = len > 0.0f ? ((p->x - a->x) * dx + (p->y - a->y) * dy) / len : 0.0f;
+	if (t < 0.0f)
+		t = 0.0f;
+	else if (t > 1.0f)
+		t = 1.0f;
+	float ex = a->x + t * dx - p->x;
+	float ey = a->y + t * dy - p->y;
+	return sqrtf(ex * ex + ey * ey);
+}
+
+size_t stroke_points_simplify(struct stroke_point *points, size_t count, float tolerance)
+{
+	if (count < 3)
+		return count;
+
+	/* iterative Ramer-Douglas-Peucker, a point is kept when it deviates from the simplified path or changes the pressure */
+	uint8_t *keep = bzalloc(count);
+	size_t *stack = bmalloc(count * 2 * sizeof(size_t));
+	size_t top = 0;
+	keep[0] = 1;
+	keep[count - 1] = 1;
+	stack[top++] = 0;
+	stack[top++] = count - 1;
+	while (top) {
+		size_t last = stack[--top];
+		size_t first = stack[--top];
+		float max_distance = 0.0f;
+		size_t index = 0;
+		for (size_t i = first + 1; i < last; i++) {
+			float d = segment_distance(&points[i], &points[first], &points[last]);
+			if (fabsf(points[i].pressure - points[first].pressure) > 0.1f)
+				d = tolerance + 1.0f;
+			if (d > max_distance) {
+				max_distance = d;
+				index = i;
+			}
+		}
+		if (index && max_distance > tolerance) {
+			keep[index] = 1;
+			stack[top++] = first;
+			stack[top++] = index;
+			stack[top++] = index;
+			stack[top++] = last;
+		}
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (keep[i])
+			points[kept++] = points[i];
+	}
+	bfree(stack);
+	bfree(keep);
+	return kept;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Packed stroke points, carried base64 encoded in the "points_b64" field of
+ * the draw websocket request.
+ *
+ * Format version 1, all values little-endian:
+ *   uint8   magic 'D'
+ *   uint8   version, 1
+ *   uint16  point count
+ *   int16   x, int16 y, uint8 pressure      first point, absolute position
+ *   int16   dx, int16 dy, uint8 pressure    following points, relative to the previous point
+ *
+ * Pressure 0-255 maps to 0.0-1.0. Trailing bytes after the last point are an error.
+ */
+
+#define STROKE_CODEC_MAGIC 'D'
+#define STROKE_CODEC_VERSION 1
+#define STROKE_CODEC_HEADER_SIZE 4
+#define STROKE_CODEC_POINT_SIZE 5
+/* the most points one packed stroke holds, longer strokes are sent as several continuing strokes */
+#define STROKE_CODEC_MAX_POINTS 0xFFFF
+
+struct stroke_point {
+	float x;
+	float y;
+	float pressure;
+};
+
+/* decodes base64 into out, returns the decoded size or 0 when the input is invalid or out is too small */
+size_t stroke_base64_decode(const char *in, size_t in_len, uint8_t *out, size_t out_size);
+
+/* encodes data as base64 into a bmalloc'd string */
+char *stroke_base64_encode(const uint8_t *data, size_t size);
+
+/* decodes packed points into points, returns the number of points or 0 when data is invalid */
+size_t stroke_points_decode(const uint8_t *data, size_t size, struct stroke_point *points, size_t max_points);
+
+/* decodes base64 packed points into a bmalloc'd array, returns the number of points or 0 when invalid */
+size_t stroke_points_decode_b64(const char *b64, struct stroke_point **points);
+
+/* encodes points as base64 packed points into a bmalloc'd string, count must not exceed STROKE_CODEC_MAX_POINTS */
+char *stroke_points_encode_b64(const struct stroke_point *points, size_t count);
+
+/* drops points closer than tolerance pixels to the simplified path in place, returns the new count */
+size_t stroke_points_simplify(struct stroke_point *points, size_t count, float tolerance);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,181 @@
+#include "stroke-index.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+
+#define STROKE_INDEX_SEGMENT 0
+#define STROKE_INDEX_BOX 1
+
+struct stroke_index_entry {
+	uint32_t id;
+	uint32_t type;
+	float x0;
+	float y0;
+	float x1;
+	float y1;
+	float radius;
+};
+
+struct stroke_index_cell {
+	DARRAY(struct stroke_index_entry) entries;
+};
+
+struct stroke_index {
+	uint32_t columns;
+	uint32_t rows;
+	struct stroke_index_cell *cells;
+};
+
+struct stroke_index *stroke_index_create(uint32_t width, uint32_t height)
+{
+	struct stroke_index *index = bzalloc(sizeof(struct stroke_index));
+	index->columns = width / STROKE_INDEX_CELL_SIZE + 1;
+	index->rows = height / STROKE_INDEX_CELL_SIZE + 1;
+	index->cells = bzalloc((size_t)index->columns * index->rows * sizeof(struct stroke_index_cell));
+	return index;
+}
+
+void stroke_index_destroy(struct stroke_index *index)
+{
+	if (!index)
+		return;
+	for (size_t i = 0; i < (size_t)index->columns * index->rows; i++)
+		da_free(index->cells[i].entries);
+	bfree(index->cells);
+	bfree(index);
+}
+
+static inline uint32_t stroke_index_column(const struct stroke_index *index, float x)
+{
+	float c = floorf(x / (float)STROKE_INDEX_CELL_SIZE);
+	return c <= 0.0f ? 0 : c >= (float)(index->columns - 1) ? index->columns - 1 : (uint32_t)c;
+}
+
+static inline uint32_t stroke_index_row(const struct stroke_index *index, float y)
+{
+	float r = floorf(y / (float)STROKE_INDEX_CELL_SIZE);
+	return r <= 0.0f ? 0 : r >= (float)(index->rows - 1) ? index->rows - 1 : (uint32_t)r;
+}
+
+static float stroke_index_segment_distance(float x, float y, float x0, float y0, float x1, float y1)
+{
+	float dx = x1 - x0;
+	float dy = y1 - y0;
+	float length = dx * dx + dy * dy;
+	float t = length > 0.0f ? ((x - x0) * dx + (y - y0) * dy) / length : 0.0f;
+	t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+	float px = x0 + t * dx - x;
+	float py = y0 + t * dy - y;
+	return sqrtf(px * px + py * py);
+}
+
+static bool stroke_index_entry_hit(const struct stroke_index_entry *entry, float x, float y, float distance)
+{
+	if (entry->type == STROKE_INDEX_BOX)
+		return x >= entry->x0 - distance && x <= entry->x1 + distance && y >= entry->y0 - distance &&
+		       y <= entry->y1 + distance;
+	return stroke_index_segment_distance(x, y, entry->x0, entry->y0, entry->x1, entry->y1) <= entry->radius + distance;
+}
+
+static void stroke_index_add(struct stroke_index *index, const struct stroke_index_entry *entry)
+{
+	float margin = entry->radius;
+	float x0 = fminf(entry->x0, entry->x1) - margin;
+	float y0 = fminf(entry->y0, entry->y1) - margin;
+	float x1 = fmaxf(entry->x0, entry->x1) + margin;
+	float y1 = fmaxf(entry->y0, entry->y1) + margin;
+	/* a long diagonal segment only goes into the cells along it, not every cell of its bounds */
+	float reach = (float)STROKE_INDEX_CELL_SIZE * 0.70710678f;
+	for (uint32_t row = stroke_index_row(index, y0); row <= stroke_index_row(index, y1); row++) {
+		for (uint32_t column = stroke_index_column(index, x0); column <= stroke_index_column(index, x1); column++) {
+			float cx = ((float)column + 0.5f) * (float)STROKE_INDEX_CELL_SIZE;
+			float cy = ((float)row + 0.5f) * (float)STROKE_INDEX_CELL_SIZE;
+			if (entry->type == STROKE_INDEX_SEGMENT && column > 0 && row > 0 && column < index->columns - 1 &&
+			    row < index->rows - 1 && !stroke_index_entry_hit(entry, cx, cy, reach))
+				continue;
+			da_push_back(index->cells[(size_t)row * index->columns + column].entries, entry);
+		}
+	}
+}
+
+void stroke_index_add_segment(struct stroke_index *index, uint32_t id, float x0, float y0, float x1, float y1, float radius)
+{
+	struct stroke_index_entry entry = {id, STROKE_INDEX_SEGMENT, x0, y0, x1, y1, radius};
+	stroke_index_add(index, &entry);
+}
+
+void stroke_index_add_box(struct stroke_index *index, uint32_t id, float x0, float y0, float x1, float y1)
+{
+	struct stroke_index_entry entry = {id, STROKE_INDEX_BOX, fminf(x0, x1), fminf(y0, y1), fmaxf(x0, x1), fmaxf(y0, y1), 0.0f};
+	stroke_index_add(index, &entry);
+}
+
+void stroke_index_remove(struct stroke_index *index, uint32_t id, float x0, float y0, float x1, float y1)
+{
+	for (uint32_t row = stroke_index_row(index, y0); row <= stroke_index_row(index, y1); row++) {
+		for (uint32_t column = stroke_index_column(index, x0); column <= stroke_index_column(index, x1); column++) {
+			struct stroke_index_cell *cell = &index->cells[(size_t)row * index->columns + column];
+			/* order within a cell does not matter, so the last entry fills the hole */
+			for (size_t i = 0; i < cell->entries.num;) {
+				if (cell->entries.array[i].id == id)
+					cell->entries.array[i] = cell->entries.array[--cell->entries.num];
+				else
+					i++;
+			}
+		}
+	}
+}
+
+uint32_t stroke_index_hit(const struct stroke_index *index, float x, float y, float distance)
+{
+	uint32_t hit = STROKE_INDEX_NONE;
+	for (uint32_t row = stroke_index_row(index, y - distance); row <= stroke_index_row(index, y + distance); row++) {
+		for (uint32_t column = stroke_index_column(index, x - distance); column <= stroke_index_column(index, x + distance);
+		     column++) {
+			const struct stroke_index_cell *cell = &index->cells[(size_t)row * index->columns + column];
+			for (size_t i = 0; i < cell->entries.num; i++) {
+				const struct stroke_index_entry *entry = &cell->entries.array[i];
+				if ((hit == STROKE_INDEX_NONE || entry->id > hit) && stroke_index_entry_hit(entry, x, y, distance))
+					hit = entry->id;
+			}
+		}
+	}
+	return hit;
+}
+
+static int stroke_index_compare(const void *a, const void *b)
+{
+	uint32_t ia = *(const uint32_t *)a;
+	uint32_t ib = *(const uint32_t *)b;
+	return ia < ib ? -1 : ia > ib ? 1 : 0;
+}
+
+uint32_t *stroke_index_query(const struct stroke_index *index, float x0, float y0, float x1, float y1, size_t *count)
+{
+	DARRAY(uint32_t) ids;
+	da_init(ids);
+	for (uint32_t row = stroke_index_row(index, y0); row <= stroke_index_row(index, y1); row++) {
+		for (uint32_t column = stroke_index_column(index, x0); column <= stroke_index_column(index, x1); column++) {
+			const struct stroke_index_cell *cell = &index->cells[(size_t)row * index->columns + column];
+			for (size_t i = 0; i < cell->entries.num; i++) {
+				const struct stroke_index_entry *entry = &cell->entries.array[i];
+				float margin = entry->radius;
+				if (fmaxf(entry->x0, entry->x1) + margin < x0 || fminf(entry->x0, entry->x1) - margin > x1 ||
+				    fmaxf(entry->y0, entry->y1) + margin < y0 || fminf(entry->y0, entry->y1) - margin > y1)
+					continue;
+				da_push_back(ids, &entry->id);
+			}
+		}
+	}
+	if (ids.num)
+		qsort(ids.array, ids.num, sizeof(uint32_t), stroke_index_compare);
+	size_t unique = 0;
+	for (size_t i = 0; i < ids.num; i++) {
+		if (!unique || ids.array[unique - 1] != ids.array[i])
+			ids.array[unique++] = ids.array[i];
+	}
+	*count = unique;
+	return ids.array;
+}
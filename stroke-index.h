@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Uniform grid over the segments and boxes of vector strokes. Each cell lists the shapes that come near it, so a hit
+ * test only looks at the cells under the pointer however many strokes there are. Strokes are identified by the caller,
+ * a higher id is drawn later and wins a hit. Positions outside the grid fall into its border cells.
+ */
+
+#define STROKE_INDEX_CELL_SIZE 64
+#define STROKE_INDEX_NONE UINT32_MAX
+
+struct stroke_index;
+
+struct stroke_index *stroke_index_create(uint32_t width, uint32_t height);
+void stroke_index_destroy(struct stroke_index *index);
+
+/* adds a round capped segment of the stroke, from and to are equal for a dot */
+void stroke_index_add_segment(struct stroke_index *index, uint32_t id, float x0, float y0, float x1, float y1, float radius);
+
+/* adds a filled box of the stroke, rectangles and ellipses are hit anywhere inside their bounds */
+void stroke_index_add_box(struct stroke_index *index, uint32_t id, float x0, float y0, float x1, float y1);
+
+/* removes everything of the stroke from the cells covering x0, y0 - x1, y1, the bounds of all it added */
+void stroke_index_remove(struct stroke_index *index, uint32_t id, float x0, float y0, float x1, float y1);
+
+/* the last drawn stroke with a shape within distance of x, y, STROKE_INDEX_NONE when there is none */
+uint32_t stroke_index_hit(const struct stroke_index *index, float x, float y, float distance);
+
+/* the ids of the strokes with a shape overlapping x0, y0 - x1, y1 in drawing order, bfree the result */
+uint32_t *stroke_index_query(const struct stroke_index *index, float x0, float y0, float x1, float y1, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,381 @@
+#include "stroke-journal.h"
+#include "qoi-codec.h"
+#include "stroke-codec.h"
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#define journal_fsync(file) _commit(_fileno(file))
+#else
+#include <unistd.h>
+#define journal_fsync(file) fsync(fileno(file))
+#endif
+
+#define JOURNAL_ACTION_STROKE 1
+#define JOURNAL_ACTION_CHECKPOINT 2
+#define JOURNAL_ACTION_CLEAR 3
+#define JOURNAL_ACTION_UNDO 4
+#define JOURNAL_ACTION_REDO 5
+#define JOURNAL_ACTION_ERASE 6
+#define JOURNAL_ACTION_FILL 7
+
+#define JOURNAL_FLAG_DOT 1
+#define JOURNAL_FLAG_SHIFT 2
+/* the fixed part of a stroke is followed by the brush tip and hardness */
+#define JOURNAL_FLAG_BRUSH 4
+/* followed by the fill tolerance, after the brush fields when both are there */
+#define JOURNAL_FLAG_FILL 8
+
+#define JOURNAL_STROKE_SIZE 32
+#define JOURNAL_BRUSH_SIZE 8
+#define JOURNAL_FILL_SIZE 4
+#define JOURNAL_PATCH_SIZE 9
+/* an erase or fill record holds a QOI image of up to the whole canvas */
+#define JOURNAL_MAX_RECORD (1 << 28)
+#define JOURNAL_SYNC_INTERVAL_NS 1000000000ULL
+
+struct stroke_journal {
+	char *dir;
+	FILE *file;
+	uint64_t last_sync;
+	DARRAY(uint8_t) buffer;
+};
+
+static const char *journal_actions[] = {NULL, "stroke", "checkpoint", "clear", "undo", "redo", "erase_stroke", "fill"};
+
+static void journal_path(struct dstr *path, const char *dir, uint64_t generation, const char *ext)
+{
+	dstr_printf(path, "%s/%llu.%s", dir, (unsigned long long)generation, ext);
+}
+
+struct stroke_journal *stroke_journal_create(const char *dir)
+{
+	struct stroke_journal *journal = bzalloc(sizeof(struct stroke_journal));
+	journal->dir = bstrdup(dir);
+	os_mkdirs(dir);
+	return journal;
+}
+
+static void journal_close(struct stroke_journal *journal)
+{
+	if (!journal->file)
+		return;
+	fflush(journal->file);
+	journal_fsync(journal->file);
+	fclose(journal->file);
+	journal->file = NULL;
+}
+
+void stroke_journal_destroy(struct stroke_journal *journal)
+{
+	if (!journal)
+		return;
+	journal_close(journal);
+	da_free(journal->buffer);
+	bfree(journal->dir);
+	bfree(journal);
+}
+
+void stroke_journal_rotate(struct stroke_journal *journal, uint64_t generation)
+{
+	journal_close(journal);
+	struct dstr path = {0};
+	journal_path(&path, journal->dir, generation, "log");
+	journal->file = os_fopen(path.array, "ab");
+	if (!journal->file)
+		blog(LOG_WARNING, "[Draw] failed to open journal '%s'", path.array);
+	dstr_free(&path);
+}
+
+char *stroke_journal_checkpoint_path(const char *dir, uint64_t generation)
+{
+	struct dstr path = {0};
+	journal_path(&path, dir, generation, "qoi");
+	return path.array;
+}
+
+static void journal_push_float(struct stroke_journal *journal, float v)
+{
+	da_push_back_array(journal->buffer, (uint8_t *)&v, sizeof(v));
+}
+
+/* appends base64 data decoded, false when it is invalid */
+static bool journal_push_b64(struct stroke_journal *journal, const char *b64)
+{
+	size_t len = strlen(b64);
+	size_t offset = journal->buffer.num;
+	da_resize(journal->buffer, offset + len / 4 * 3 + 3);
+	size_t size = stroke_base64_decode(b64, len, journal->buffer.array + offset, len / 4 * 3 + 3);
+	journal->buffer.num = offset + size;
+	return size != 0;
+}
+
+static void journal_push_event(struct stroke_journal *journal, obs_data_t *event)
+{
+	const char *action = obs_data_get_string(event, "action");
+	uint8_t code = 0;
+	for (uint8_t i = 1; i < sizeof(journal_actions) / sizeof(journal_actions[0]); i++) {
+		if (strcmp(action, journal_actions[i]) == 0)
+			code = i;
+	}
+	if (!code)
+		return;
+
+	size_t start = journal->buffer.num;
+	uint32_t size = 1;
+	da_push_back_array(journal->buffer, (uint8_t *)&size, sizeof(size));
+	da_push_back(journal->buffer, &code);
+	if (code == JOURNAL_ACTION_STROKE) {
+		bool brush = obs_data_has_user_value(event, "brush_tip");
+		bool fill = obs_data_has_user_value(event, "fill_tolerance");
+		uint8_t header[3] = {(uint8_t)obs_data_get_int(event, "tool"), (uint8_t)obs_data_get_int(event, "tool_mode"),
+				     (uint8_t)((obs_data_get_bool(event, "dot") ? JOURNAL_FLAG_DOT : 0) |
+					       (obs_data_get_bool(event, "shift") ? JOURNAL_FLAG_SHIFT : 0) |
+					       (brush ? JOURNAL_FLAG_BRUSH : 0) | (fill ? JOURNAL_FLAG_FILL : 0))};
+		uint32_t color = (uint32_t)obs_data_get_int(event, "tool_color");
+		da_push_back_array(journal->buffer, header, sizeof(header));
+		da_push_back_array(journal->buffer, (uint8_t *)&color, sizeof(color));
+		journal_push_float(journal, (float)obs_data_get_double(event, "tool_alpha"));
+		journal_push_float(journal, (float)obs_data_get_double(event, "tool_size"));
+		journal_push_float(journal, (float)obs_data_get_double(event, "select_from_x"));
+		journal_push_float(journal, (float)obs_data_get_double(event, "select_from_y"));
+		journal_push_float(journal, (float)obs_data_get_double(event, "select_to_x"));
+		journal_push_float(journal, (float)obs_data_get_double(event, "select_to_y"));
+		if (brush) {
+			uint32_t tip = (uint32_t)obs_data_get_int(event, "brush_tip");
+			da_push_back_array(journal->buffer, (uint8_t *)&tip, sizeof(tip));
+			journal_push_float(journal, (float)obs_data_get_double(event, "brush_hardness"));
+		}
+		if (fill)
+			journal_push_float(journal, (float)obs_data_get_double(event, "fill_tolerance"));
+		if (!journal_push_b64(journal, obs_data_get_string(event, "points_b64"))) {
+			journal->buffer.num = start;
+			return;
+		}
+	} else if (code == JOURNAL_ACTION_ERASE || code == JOURNAL_ACTION_FILL) {
+		int32_t rect[2] = {(int32_t)obs_data_get_int(event, "x"), (int32_t)obs_data_get_int(event, "y")};
+		da_push_back_array(journal->buffer, (uint8_t *)rect, sizeof(rect));
+		if (!journal_push_b64(journal, obs_data_get_string(event, "image_b64"))) {
+			journal->buffer.num = start;
+			return;
+		}
+	}
+	size = (uint32_t)(journal->buffer.num - start - sizeof(size));
+	memcpy(journal->buffer.array + start, &size, sizeof(size));
+}
+
+void stroke_journal_write(struct stroke_journal *journal, obs_data_array_t *events)
+{
+	if (!journal->file)
+		return;
+
+	journal->buffer.num = 0;
+	size_t count = obs_data_array_count(events);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *event = obs_data_array_item(events, i);
+		journal_push_event(journal, event);
+		obs_data_release(event);
+	}
+	if (!journal->buffer.num)
+		return;
+
+	fwrite(journal->buffer.array, 1, journal->buffer.num, journal->file);
+	fflush(journal->file);
+	uint64_t now = os_gettime_ns();
+	if (now - journal->last_sync >= JOURNAL_SYNC_INTERVAL_NS) {
+		journal_fsync(journal->file);
+		journal->last_sync = now;
+	}
+}
+
+static float journal_read_float(const uint8_t *p)
+{
+	float v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static void journal_read_log(const char *path, obs_data_array_t *events)
+{
+	FILE *file = os_fopen(path, "rb");
+	if (!file)
+		return;
+	int64_t file_size = os_fgetsize(file);
+	uint8_t *data = file_size > 0 ? bmalloc((size_t)file_size) : NULL;
+	size_t size = data ? fread(data, 1, (size_t)file_size, file) : 0;
+	fclose(file);
+
+	size_t pos = 0;
+	while (pos + sizeof(uint32_t) < size) {
+		uint32_t record_size;
+		memcpy(&record_size, data + pos, sizeof(record_size));
+		pos += sizeof(record_size);
+		if (!record_size || record_size > JOURNAL_MAX_RECORD || record_size > size - pos)
+			break;
+		const uint8_t *record = data + pos;
+		pos += record_size;
+
+		uint8_t code = record[0];
+		if (code < JOURNAL_ACTION_STROKE || code > JOURNAL_ACTION_FILL)
+			break;
+		size_t header_size = JOURNAL_STROKE_SIZE;
+		uint8_t flags = code == JOURNAL_ACTION_STROKE && record_size > JOURNAL_STROKE_SIZE ? record[3] : 0;
+		if (flags & JOURNAL_FLAG_BRUSH)
+			header_size += JOURNAL_BRUSH_SIZE;
+		if (flags & JOURNAL_FLAG_FILL)
+			header_size += JOURNAL_FILL_SIZE;
+		if (code == JOURNAL_ACTION_STROKE && record_size <= header_size)
+			break;
+		bool patch = code == JOURNAL_ACTION_ERASE || code == JOURNAL_ACTION_FILL;
+		if (patch && record_size <= JOURNAL_PATCH_SIZE)
+			break;
+
+		obs_data_t *event = obs_data_create();
+		obs_data_set_string(event, "action", journal_actions[code]);
+		if (code == JOURNAL_ACTION_STROKE) {
+			uint32_t color;
+			memcpy(&color, record + 4, sizeof(color));
+			obs_data_set_int(event, "tool", record[1]);
+			obs_data_set_int(event, "tool_mode", record[2]);
+			obs_data_set_bool(event, "dot", (record[3] & JOURNAL_FLAG_DOT) != 0);
+			obs_data_set_bool(event, "shift", (record[3] & JOURNAL_FLAG_SHIFT) != 0);
+			obs_data_set_int(event, "tool_color", color);
+			obs_data_set_double(event, "tool_alpha", journal_read_float(record + 8));
+			obs_data_set_double(event, "tool_size", journal_read_float(record + 12));
+			obs_data_set_double(event, "select_from_x", journal_read_float(record + 16));
+			obs_data_set_double(event, "select_from_y", journal_read_float(record + 20));
+			obs_data_set_double(event, "select_to_x", journal_read_float(record + 24));
+			obs_data_set_double(event, "select_to_y", journal_read_float(record + 28));
+			if (record[3] & JOURNAL_FLAG_BRUSH) {
+				uint32_t tip;
+				memcpy(&tip, record + JOURNAL_STROKE_SIZE, sizeof(tip));
+				obs_data_set_int(event, "brush_tip", tip);
+				obs_data_set_double(event, "brush_hardness", journal_read_float(record + JOURNAL_STROKE_SIZE + 4));
+			}
+			if (record[3] & JOURNAL_FLAG_FILL) {
+				float tolerance = journal_read_float(record + header_size - JOURNAL_FILL_SIZE);
+				obs_data_set_double(event, "fill_tolerance", tolerance);
+			}
+			char *points_b64 = stroke_base64_encode(record + header_size, record_size - header_size);
+			obs_data_set_string(event, "points_b64", points_b64);
+			bfree(points_b64);
+		} else if (patch) {
+			int32_t rect[2];
+			memcpy(rect, record + 1, sizeof(rect));
+			obs_data_set_int(event, "x", rect[0]);
+			obs_data_set_int(event, "y", rect[1]);
+			char *image_b64 = stroke_base64_encode(record + JOURNAL_PATCH_SIZE, record_size - JOURNAL_PATCH_SIZE);
+			obs_data_set_string(event, "image_b64", image_b64);
+			bfree(image_b64);
+		}
+		obs_data_array_push_back(events, event);
+		obs_data_release(event);
+	}
+	bfree(data);
+}
+
+static bool journal_parse_name(const char *name, uint64_t *generation, bool *checkpoint)
+{
+	char *end;
+	unsigned long long value = strtoull(name, &end, 10);
+	if (end == name)
+		return false;
+	*generation = value;
+	if (strcmp(end, ".qoi") == 0)
+		*checkpoint = true;
+	else if (strcmp(end, ".log") == 0)
+		*checkpoint = false;
+	else
+		return false;
+	return true;
+}
+
+void stroke_journal_remove_before(const char *dir, uint64_t generation)
+{
+	os_dir_t *d = os_opendir(dir);
+	if (!d)
+		return;
+	struct dstr path = {0};
+	struct os_dirent *entry;
+	while ((entry = os_readdir(d)) != NULL) {
+		uint64_t entry_generation;
+		bool checkpoint;
+		if (entry->directory || !journal_parse_name(entry->d_name, &entry_generation, &checkpoint))
+			continue;
+		if (entry_generation >= generation)
+			continue;
+		dstr_printf(&path, "%s/%s", dir, entry->d_name);
+		os_unlink(path.array);
+	}
+	dstr_free(&path);
+	os_closedir(d);
+}
+
+static int journal_compare(const void *a, const void *b)
+{
+	uint64_t ga = *(const uint64_t *)a;
+	uint64_t gb = *(const uint64_t *)b;
+	return ga < gb ? -1 : ga > gb ? 1 : 0;
+}
+
+obs_data_array_t *stroke_journal_read(const char *dir, uint8_t **pixels, uint32_t *width, uint32_t *height,
+				      uint64_t *generation)
+{
+	*pixels = NULL;
+	*generation = 0;
+	os_dir_t *d = os_opendir(dir);
+	if (!d)
+		return NULL;
+
+	DARRAY(uint64_t) logs;
+	da_init(logs);
+	bool has_checkpoint = false;
+	uint64_t checkpoint_generation = 0;
+	struct os_dirent *entry;
+	while ((entry = os_readdir(d)) != NULL) {
+		uint64_t entry_generation;
+		bool checkpoint;
+		if (entry->directory || !journal_parse_name(entry->d_name, &entry_generation, &checkpoint))
+			continue;
+		if (entry_generation > *generation)
+			*generation = entry_generation;
+		if (!checkpoint) {
+			da_push_back(logs, &entry_generation);
+		} else if (!has_checkpoint || entry_generation > checkpoint_generation) {
+			has_checkpoint = true;
+			checkpoint_generation = entry_generation;
+		}
+	}
+	os_closedir(d);
+
+	struct dstr path = {0};
+	if (has_checkpoint) {
+		journal_path(&path, dir, checkpoint_generation, "qoi");
+		FILE *file = os_fopen(path.array, "rb");
+		if (file) {
+			int64_t size = os_fgetsize(file);
+			uint8_t *data = size > 0 ? bmalloc((size_t)size) : NULL;
+			if (data && fread(data, 1, (size_t)size, file) == (size_t)size)
+				*pixels = qoi_decode(data, (size_t)size, width, height);
+			bfree(data);
+			fclose(file);
+		}
+	}
+
+	obs_data_array_t *events = obs_data_array_create();
+	if (logs.num)
+		qsort(logs.array, logs.num, sizeof(uint64_t), journal_compare);
+	for (size_t i = 0; i < logs.num; i++) {
+		if (has_checkpoint && logs.array[i] < checkpoint_generation)
+			continue;
+		journal_path(&path, dir, logs.array[i], "log");
+		journal_read_log(path.array, events);
+	}
+	dstr_free(&path);
+	da_free(logs);
+	return events;
+}
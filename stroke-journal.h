@@ -0,0 +1,56 @@
+#pragma once
+
+#include <obs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Append-only crash recovery journal of a draw source, stored in its own directory as
+ * numbered generations: "<generation>.qoi" is the canvas at the start of a generation
+ * and "<generation>.log" holds the strokes applied after it.
+ *
+ * Each log record is a uint32 payload size followed by the payload:
+ *   uint8   action               JOURNAL_ACTION_*
+ * for strokes:
+ *   uint8   tool, uint8 tool mode, uint8 flags (1 dot, 2 shift, 4 brush, 8 fill)
+ *   uint32  tool color, float tool alpha, float tool size
+ *   float   select from x, y, select to x, y
+ *   uint32  brush tip, float brush hardness, only with the brush flag
+ *   float   fill tolerance, only with the fill flag
+ *   ...     packed points as described in stroke-codec.h
+ * for erased strokes and fills:
+ *   int32   x, y of the changed bounds
+ *   ...     QOI image of the pixels the erase or fill left in them
+ *
+ * Records use native byte order, a torn record at the end of a log is ignored.
+ */
+
+struct stroke_journal;
+
+struct stroke_journal *stroke_journal_create(const char *dir);
+void stroke_journal_destroy(struct stroke_journal *journal);
+
+/* appends recorded stroke events, the file is synced at most once per second */
+void stroke_journal_write(struct stroke_journal *journal, obs_data_array_t *events);
+
+/* closes the current log and continues in the log of the given generation */
+void stroke_journal_rotate(struct stroke_journal *journal, uint64_t generation);
+
+/* returns the bmalloc'd path of the checkpoint of a generation */
+char *stroke_journal_checkpoint_path(const char *dir, uint64_t generation);
+
+/* removes checkpoints and logs older than generation */
+void stroke_journal_remove_before(const char *dir, uint64_t generation);
+
+/*
+ * reads the newest checkpoint into bmalloc'd pixels (NULL when there is none) and returns the
+ * events of all logs since then, generation is set to the newest generation found
+ */
+obs_data_array_t *stroke_journal_read(const char *dir, uint8_t **pixels, uint32_t *width, uint32_t *height,
+				      uint64_t *generation);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,37 @@
+/* measures how fast packed base64 points decode, the path every draw request with points_b64 takes */
+#include "../stroke-codec.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#define BENCH_POINTS STROKE_CODEC_MAX_POINTS
+#define BENCH_ROUNDS 200
+
+int main(void)
+{
+	struct stroke_point *points = bmalloc(BENCH_POINTS * sizeof(struct stroke_point));
+	for (size_t i = 0; i < BENCH_POINTS; i++) {
+		points[i].x = 960.0f + 800.0f * cosf((float)i * 0.01f);
+		points[i].y = 540.0f + 400.0f * sinf((float)i * 0.013f);
+		points[i].pressure = 0.5f + 0.5f * sinf((float)i * 0.1f);
+	}
+	char *b64 = stroke_points_encode_b64(points, BENCH_POINTS);
+	bfree(points);
+
+	size_t decoded = 0;
+	uint64_t start = os_gettime_ns();
+	for (int round = 0; round < BENCH_ROUNDS; round++) {
+		struct stroke_point *result;
+		decoded += stroke_points_decode_b64(b64, &result);
+		bfree(result);
+	}
+	uint64_t elapsed = os_gettime_ns() - start;
+	double seconds = (double)elapsed / 1000000000.0;
+	printf("stroke-codec-bench: %zu points from %zu base64 bytes in %.3f s, %.1f M points/s, %.1f MB/s\n", decoded,
+	       strlen(b64) * BENCH_ROUNDS, seconds, (double)decoded / seconds / 1000000.0,
+	       (double)(strlen(b64) * BENCH_ROUNDS) / seconds / 1000000.0);
+	bfree(b64);
+	return decoded == (size_t)BENCH_POINTS * BENCH_ROUNDS ? 0 : 1;
+}
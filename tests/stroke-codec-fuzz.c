@@ -0,0 +1,132 @@
+/* feeds the packed point and base64 decoders random, truncated and corrupted input, run with a sanitizer to catch
+ * reads past the end, exits non zero when a decoder accepts what it should reject or a round trip changes a point */
+#include "../stroke-codec.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/bmem.h>
+
+#define FUZZ_ROUNDS 20000
+#define FUZZ_MAX_BYTES 4096
+
+static uint32_t fuzz_state = 0x2545f491;
+
+static uint32_t fuzz_next(void)
+{
+	fuzz_state ^= fuzz_state << 13;
+	fuzz_state ^= fuzz_state >> 17;
+	fuzz_state ^= fuzz_state << 5;
+	return fuzz_state;
+}
+
+static int failures;
+
+static void fail(const char *what, uint32_t round)
+{
+	fprintf(stderr, "stroke-codec-fuzz: %s in round %u\n", what, round);
+	failures++;
+}
+
+/* random bytes, sometimes with a valid header so the point loop is reached */
+static void fuzz_points(uint32_t round, uint8_t *data, struct stroke_point *points)
+{
+	size_t size = fuzz_next() % FUZZ_MAX_BYTES;
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)fuzz_next();
+	if (size >= STROKE_CODEC_HEADER_SIZE && fuzz_next() % 2) {
+		size_t count = (size - STROKE_CODEC_HEADER_SIZE) / STROKE_CODEC_POINT_SIZE + fuzz_next() % 3 - 1;
+		data[0] = STROKE_CODEC_MAGIC;
+		data[1] = STROKE_CODEC_VERSION;
+		data[2] = (uint8_t)(count & 0xFF);
+		data[3] = (uint8_t)(count >> 8);
+	}
+	size_t max_points = FUZZ_MAX_BYTES / STROKE_CODEC_POINT_SIZE;
+	size_t count = stroke_points_decode(data, size, points, max_points);
+	if (count && size != STROKE_CODEC_HEADER_SIZE + count * STROKE_CODEC_POINT_SIZE)
+		fail("points accepted with a size that does not match their count", round);
+}
+
+/* random text over the base64 alphabet and outside it, into an output that is sometimes too small */
+static void fuzz_base64(uint32_t round, char *text, uint8_t *out)
+{
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=";
+	size_t len = fuzz_next() % FUZZ_MAX_BYTES;
+	for (size_t i = 0; i < len; i++)
+		text[i] = fuzz_next() % 16 ? alphabet[fuzz_next() % (sizeof(alphabet) - 1)] : (char)(fuzz_next() % 255 + 1);
+	text[len] = 0;
+	size_t out_size = fuzz_next() % 2 ? len / 4 * 3 + 3 : fuzz_next() % (len / 4 * 3 + 3);
+	size_t size = stroke_base64_decode(text, len, out, out_size);
+	if (size > out_size)
+		fail("base64 decoded past the output size", round);
+
+	struct stroke_point *points;
+	size_t count = stroke_points_decode_b64(text, &points);
+	if (!count && points)
+		fail("rejected base64 points left an array behind", round);
+	bfree(points);
+}
+
+/* a valid stroke must survive the round trip and every truncation or flipped bit of it must not be read past its end */
+static void fuzz_round_trip(uint32_t round, struct stroke_point *points, struct stroke_point *decoded)
+{
+	size_t count = fuzz_next() % 256 + 1;
+	for (size_t i = 0; i < count; i++) {
+		points[i].x = (float)(fuzz_next() % 8192) - 1024.0f;
+		points[i].y = (float)(fuzz_next() % 8192) - 1024.0f;
+		points[i].pressure = (float)(fuzz_next() % 256) / 255.0f;
+	}
+	char *b64 = stroke_points_encode_b64(points, count);
+	struct stroke_point *result;
+	size_t result_count = stroke_points_decode_b64(b64, &result);
+	if (result_count != count) {
+		fail("round trip changed the point count", round);
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			if (result[i].x != points[i].x || result[i].y != points[i].y ||
+			    fabsf(result[i].pressure - points[i].pressure) > 0.5f / 255.0f) {
+				fail("round trip changed a point", round);
+				break;
+			}
+		}
+	}
+	bfree(result);
+
+	size_t len = strlen(b64);
+	uint8_t *data = bmalloc(len / 4 * 3 + 3);
+	size_t size = stroke_base64_decode(b64, len, data, len / 4 * 3 + 3);
+	/* the copy is exactly as long as the cut so a sanitizer sees any read past it */
+	for (size_t cut = 0; cut < size; cut++) {
+		uint8_t *truncated = bmalloc(cut ? cut : 1);
+		memcpy(truncated, data, cut);
+		if (stroke_points_decode(truncated, cut, decoded, count))
+			fail("truncated points were accepted", round);
+		bfree(truncated);
+	}
+	data[fuzz_next() % size] ^= (uint8_t)(1 << fuzz_next() % 8);
+	stroke_points_decode(data, size, decoded, count);
+	bfree(data);
+	bfree(b64);
+}
+
+int main(void)
+{
+	uint8_t *data = bmalloc(FUZZ_MAX_BYTES);
+	char *text = bmalloc(FUZZ_MAX_BYTES + 1);
+	struct stroke_point *points = bmalloc(FUZZ_MAX_BYTES * sizeof(struct stroke_point));
+	struct stroke_point *decoded = bmalloc(FUZZ_MAX_BYTES * sizeof(struct stroke_point));
+	for (uint32_t round = 0; round < FUZZ_ROUNDS; round++) {
+		fuzz_points(round, data, points);
+		fuzz_base64(round, text, data);
+		if (round % 16 == 0)
+			fuzz_round_trip(round, points, decoded);
+	}
+	bfree(decoded);
+	bfree(points);
+	bfree(text);
+	bfree(data);
+	if (failures)
+		return 1;
+	printf("stroke-codec-fuzz: %d rounds passed\n", FUZZ_ROUNDS);
+	return 0;
+}
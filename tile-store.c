@@ -0,0 +1,255 @@
+#include "tile-store.h"
+#include <string.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/platform.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/* slot capacities are powers of two from TILE_SLOT_MIN up to a whole segment, so a freed slot fits any tile of its class */
+#define TILE_SLOT_MIN 4096
+#define TILE_SLOT_CLASSES 15
+
+struct tile_segment {
+	uint8_t *data;
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+};
+
+struct tile_store {
+	DARRAY(struct draw_tile *) tiles;
+	/* open addressing index into tiles, 0 is an empty bucket and i + 1 refers to tiles.array[i] */
+	uint32_t *buckets;
+	size_t bucket_count;
+
+	char *swap_path;
+#ifdef _WIN32
+	HANDLE swap_file;
+#else
+	int swap_file;
+#endif
+	DARRAY(struct tile_segment) segments;
+	uint32_t swap_used;
+	/* slots left behind by tiles that outgrew them, reused before the file grows */
+	DARRAY(struct tile_slot) free_slots[TILE_SLOT_CLASSES];
+};
+
+static inline size_t tile_hash(uint32_t page, uint32_t layer, int32_t x, int32_t y)
+{
+	uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ (page * 64 + layer) * 83492791u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	return (size_t)(h ^ (h >> 15));
+}
+
+static void tile_store_rehash(struct tile_store *store)
+{
+	size_t count = store->bucket_count ? store->bucket_count * 2 : 256;
+	bfree(store->buckets);
+	store->buckets = bzalloc(count * sizeof(uint32_t));
+	store->bucket_count = count;
+	for (size_t i = 0; i < store->tiles.num; i++) {
+		struct draw_tile *tile = store->tiles.array[i];
+		size_t b = tile_hash(tile->page, tile->layer, tile->x, tile->y) & (count - 1);
+		while (store->buckets[b])
+			b = (b + 1) & (count - 1);
+		store->buckets[b] = (uint32_t)i + 1;
+	}
+}
+
+struct tile_store *tile_store_create(const char *swap_path)
+{
+	struct tile_store *store = bzalloc(sizeof(struct tile_store));
+	store->swap_path = bstrdup(swap_path);
+#ifdef _WIN32
+	store->swap_file = INVALID_HANDLE_VALUE;
+#else
+	store->swap_file = -1;
+#endif
+	tile_store_rehash(store);
+	return store;
+}
+
+void tile_store_destroy(struct tile_store *store)
+{
+	if (!store)
+		return;
+	for (size_t i = 0; i < store->tiles.num; i++) {
+		bfree(store->tiles.array[i]->packed);
+		bfree(store->tiles.array[i]->pixels);
+		bfree(store->tiles.array[i]);
+	}
+	da_free(store->tiles);
+	bfree(store->buckets);
+
+	for (size_t i = 0; i < store->segments.num; i++) {
+#ifdef _WIN32
+		UnmapViewOfFile(store->segments.array[i].data);
+		CloseHandle(store->segments.array[i].mapping);
+#else
+		munmap(store->segments.array[i].data, TILE_SWAP_SEGMENT_SIZE);
+#endif
+	}
+	da_free(store->segments);
+	for (size_t i = 0; i < TILE_SLOT_CLASSES; i++)
+		da_free(store->free_slots[i]);
+#ifdef _WIN32
+	if (store->swap_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(store->swap_file);
+		os_unlink(store->swap_path);
+	}
+#else
+	if (store->swap_file >= 0) {
+		close(store->swap_file);
+		os_unlink(store->swap_path);
+	}
+#endif
+	bfree(store->swap_path);
+	bfree(store);
+}
+
+struct draw_tile *tile_store_find(struct tile_store *store, uint32_t page, uint32_t layer, int32_t x, int32_t y)
+{
+	size_t mask = store->bucket_count - 1;
+	for (size_t b = tile_hash(page, layer, x, y) & mask; store->buckets[b]; b = (b + 1) & mask) {
+		struct draw_tile *tile = store->tiles.array[store->buckets[b] - 1];
+		if (tile->x == x && tile->y == y && tile->page == page && tile->layer == layer)
+			return tile;
+	}
+	return NULL;
+}
+
+struct draw_tile *tile_store_get(struct tile_store *store, uint32_t page, uint32_t layer, int32_t x, int32_t y)
+{
+	struct draw_tile *tile = tile_store_find(store, page, layer, x, y);
+	if (tile)
+		return tile;
+
+	tile = bzalloc(sizeof(struct draw_tile));
+	tile->page = page;
+	tile->layer = layer;
+	tile->x = x;
+	tile->y = y;
+	da_push_back(store->tiles, &tile);
+	if (store->tiles.num * 2 > store->bucket_count) {
+		tile_store_rehash(store);
+	} else {
+		size_t mask = store->bucket_count - 1;
+		size_t b = tile_hash(page, layer, x, y) & mask;
+		while (store->buckets[b])
+			b = (b + 1) & mask;
+		store->buckets[b] = (uint32_t)store->tiles.num;
+	}
+	return tile;
+}
+
+size_t tile_store_count(const struct tile_store *store)
+{
+	return store->tiles.num;
+}
+
+struct draw_tile *tile_store_at(struct tile_store *store, size_t index)
+{
+	return store->tiles.array[index];
+}
+
+/* maps one more segment at the end of the swap file, creating the file on first use */
+static bool tile_store_grow(struct tile_store *store)
+{
+	uint64_t offset = (uint64_t)store->segments.num * TILE_SWAP_SEGMENT_SIZE;
+	uint64_t size = offset + TILE_SWAP_SEGMENT_SIZE;
+	struct tile_segment segment = {0};
+#ifdef _WIN32
+	if (store->swap_file == INVALID_HANDLE_VALUE) {
+		wchar_t *path = NULL;
+		os_utf8_to_wcs_ptr(store->swap_path, 0, &path);
+		if (path)
+			store->swap_file = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+						       FILE_ATTRIBUTE_TEMPORARY, NULL);
+		bfree(path);
+		if (store->swap_file == INVALID_HANDLE_VALUE)
+			return false;
+	}
+	segment.mapping = CreateFileMappingW(store->swap_file, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+	if (!segment.mapping)
+		return false;
+	segment.data = MapViewOfFile(segment.mapping, FILE_MAP_ALL_ACCESS, (DWORD)(offset >> 32), (DWORD)offset,
+				     TILE_SWAP_SEGMENT_SIZE);
+	if (!segment.data) {
+		CloseHandle(segment.mapping);
+		return false;
+	}
+#else
+	if (store->swap_file < 0) {
+		store->swap_file = open(store->swap_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (store->swap_file < 0)
+			return false;
+	}
+	if (ftruncate(store->swap_file, (off_t)size) != 0)
+		return false;
+	void *data = mmap(NULL, TILE_SWAP_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, store->swap_file, (off_t)offset);
+	if (data == MAP_FAILED)
+		return false;
+	segment.data = data;
+#endif
+	da_push_back(store->segments, &segment);
+	store->swap_used = 0;
+	return true;
+}
+
+static inline size_t tile_slot_class(uint32_t size)
+{
+	size_t c = 0;
+	while (c + 1 < TILE_SLOT_CLASSES && ((uint32_t)TILE_SLOT_MIN << c) < size)
+		c++;
+	return c;
+}
+
+bool tile_store_swap_out(struct tile_store *store, struct draw_tile *tile)
+{
+	if (!tile->packed || tile->packed_size > TILE_SWAP_SEGMENT_SIZE)
+		return false;
+	uint32_t size = (uint32_t)tile->packed_size;
+	if (!tile->slot.capacity || tile->slot.capacity < size) {
+		size_t c = tile_slot_class(size);
+		uint32_t capacity = (uint32_t)TILE_SLOT_MIN << c;
+		struct tile_slot slot = {0};
+		if (store->free_slots[c].num) {
+			slot = store->free_slots[c].array[--store->free_slots[c].num];
+		} else {
+			if (!store->segments.num || store->swap_used + capacity > TILE_SWAP_SEGMENT_SIZE) {
+				if (!tile_store_grow(store))
+					return false;
+			}
+			slot.segment = (uint32_t)store->segments.num - 1;
+			slot.offset = store->swap_used;
+			slot.capacity = capacity;
+			store->swap_used += capacity;
+		}
+		if (tile->slot.capacity)
+			da_push_back(store->free_slots[tile_slot_class(tile->slot.capacity)], &tile->slot);
+		tile->slot = slot;
+	}
+	tile->slot.size = size;
+	memcpy(store->segments.array[tile->slot.segment].data + tile->slot.offset, tile->packed, size);
+	bfree(tile->packed);
+	tile->packed = NULL;
+	tile->packed_size = 0;
+	tile->swapped = true;
+	return true;
+}
+
+const uint8_t *tile_store_swapped(struct tile_store *store, const struct draw_tile *tile)
+{
+	if (!tile->swapped || tile->slot.segment >= store->segments.num)
+		return NULL;
+	return store->segments.array[tile->slot.segment].data + tile->slot.offset;
+}
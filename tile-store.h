@@ -0,0 +1,77 @@
+#pragma once
+
+#include <obs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Tiles of an infinite canvas keyed by page, layer and tile position, with the swap file far tiles are paged to.
+ * A tile lives on the GPU as a texrender, packed as a QOI image in memory, packed in a slot of the memory mapped
+ * swap file, or only in its saved tile file. Everything here runs with the graphics lock held.
+ */
+
+#define TILE_SIZE 512
+/* the swap file grows and is mapped in segments of this size, a packed tile is always far smaller */
+#define TILE_SWAP_SEGMENT_SIZE (64 * 1024 * 1024)
+
+struct draw_snapshot;
+
+struct tile_slot {
+	uint32_t segment;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t capacity;
+};
+
+struct draw_tile {
+	uint32_t page;
+	uint32_t layer;
+	int32_t x;
+	int32_t y;
+	gs_texrender_t *render;
+	uint8_t *packed;
+	size_t packed_size;
+	struct tile_slot slot;
+	bool swapped;
+	/* a tile file exists from an earlier save, read when the tile is first needed */
+	bool saved;
+	bool unsaved;
+	struct draw_snapshot *evicting;
+	/* decoded by a prefetch on the worker, handed over under the owner's mutex and uploaded by the next tick */
+	uint8_t *pixels;
+	uint32_t pixels_width;
+	uint32_t pixels_height;
+	bool prefetching;
+	bool prefetch_done;
+	uint32_t prefetch_id;
+	uint64_t used;
+};
+
+struct tile_store;
+
+/* the swap file at swap_path is only created once the first tile is paged out and deleted with the store */
+struct tile_store *tile_store_create(const char *swap_path);
+
+/* frees the tiles and the swap file, textures and snapshots of the tiles must have been released by the caller */
+void tile_store_destroy(struct tile_store *store);
+
+struct draw_tile *tile_store_find(struct tile_store *store, uint32_t page, uint32_t layer, int32_t x, int32_t y);
+
+/* returns the tile at the position, adding an empty one when there is none */
+struct draw_tile *tile_store_get(struct tile_store *store, uint32_t page, uint32_t layer, int32_t x, int32_t y);
+
+size_t tile_store_count(const struct tile_store *store);
+struct draw_tile *tile_store_at(struct tile_store *store, size_t index);
+
+/* moves the packed image of a tile into the swap file, reusing its old slot when it fits, an outgrown slot is freed for
+ * other tiles of its size class, false when the file can not grow */
+bool tile_store_swap_out(struct tile_store *store, struct draw_tile *tile);
+
+/* the packed image of a swapped tile, valid until the tile is swapped out again */
+const uint8_t *tile_store_swapped(struct tile_store *store, const struct draw_tile *tile);
+
+#ifdef __cplusplus
+}
+#endif